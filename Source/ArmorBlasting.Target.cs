@@ -9,6 +9,6 @@ public class ArmorBlastingTarget : TargetRules
 	{
 		Type = TargetType.Game;
 		DefaultBuildSettings = BuildSettingsVersion.V2;
-		ExtraModuleNames.Add("ArmorBlasting");
+		ExtraModuleNames.AddRange(new string[] { "ArmorBlasting", "ArmorBlastingShaders" });
 	}
 }
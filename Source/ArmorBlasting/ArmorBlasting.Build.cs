@@ -8,6 +8,12 @@ public class ArmorBlasting : ModuleRules
 	{
 		PCHUsage = PCHUsageMode.UseExplicitOrSharedPCHs;
 
-		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "HeadMountedDisplay", "UMG", "Niagara" });
+		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "HeadMountedDisplay", "UMG", "Niagara", "RenderCore", "RHI", "Renderer", "NetCore", "ArmorBlastingShaders" });
+
+		// Needed by the UV validation commandlet, which only runs in the editor
+		if (Target.bBuildEditor)
+		{
+			PrivateDependencyModuleNames.AddRange(new string[] { "AssetRegistry", "MeshDescription", "StaticMeshDescription" });
+		}
 	}
 }
@@ -13,8 +13,14 @@
 #include "BlastableActor.h"
 #include "DrawDebugHelpers.h"
 #include "BlastableComponent.h"
+#include "BlastableInstancedComponent.h"
+#include "BlastableTrace.h"
+#include "BlastableProjectileSubsystem.h"
 #include "ArmorBlasting.h"
-#include "NiagaraFunctionLibrary.h"
+#include "BlastableSubsystem.h"
+#include "BlastablePreload.h"
+#include "BlastableScalability.h"
+#include "NiagaraSystem.h"
 #include "Math/UnrealMathUtility.h"
 #include "Blueprint/UserWidget.h"
 #include "XRMotionControllerBase.h" // for FXRMotionControllerBase::RightHandSourceId
@@ -111,6 +117,8 @@ FString AArmorBlastingCharacter::GetCurrentGunName() const
 		break;
 	case AArmorBlastingCharacter::ShootModes::Auto:
 		return "Auto";
+	case AArmorBlastingCharacter::ShootModes::Minigun:
+		return "Minigun";
 	case AArmorBlastingCharacter::ShootModes::N_MODES:
 	default:
 		break;
@@ -139,6 +147,23 @@ void AArmorBlastingCharacter::BeginPlay()
 		Mesh1P->SetHiddenInGame(false, true);
 	}
 
+	// Stream impact effects in and get them running once, so the first impact doesn't set them up
+	if (auto const Preload = GetWorld()->GetSubsystem<UBlastablePreloadSubsystem>())
+	{
+		Preload->Preload({ ImpactSparks.ToSoftObjectPath() }, FStreamableDelegate::CreateWeakLambda(this, [this]()
+		{
+			if (auto const BlastableSubsystem = GetWorld()->GetSubsystem<UBlastableSubsystem>())
+				BlastableSubsystem->WarmUpImpactEffect(ImpactSparks.Get());
+		}));
+	}
+
+	// Clients that fire projectiles hear from the server what they hit, to roll back their predictions
+	if (HasAuthority())
+	{
+		if (auto const ProjectileSubsystem = GetWorld()->GetSubsystem<UBlastableProjectileSubsystem>())
+			ProjectileSubsystem->OnProjectileResolved.AddUObject(this, &AArmorBlastingCharacter::OnProjectileResolved);
+	}
+
 	// Set up GUI to display currently active gun
 	if (IsValid(GunWidgetClass))
 	{
@@ -202,6 +227,8 @@ int AArmorBlastingCharacter::GetFireRate() const
 		return ShotgunFireRate;
 	case AArmorBlastingCharacter::ShootModes::Auto:
 		return AutoFireRate;
+	case AArmorBlastingCharacter::ShootModes::Minigun:
+		return MinigunFireRate;
 	case AArmorBlastingCharacter::ShootModes::N_MODES:
 	default:
 		break;
@@ -232,6 +259,9 @@ void AArmorBlastingCharacter::OnFire()
 		case ShootModes::Auto:
 			ShootAuto();
 			break;
+		case ShootModes::Minigun:
+			ShootMinigun();
+			break;
 		default:
 			UE_LOG(LogTemp, Warning, TEXT("Unsupported type of shot"));
 			return;
@@ -265,7 +295,7 @@ void AArmorBlastingCharacter::OnFireHold(float Val)
 		return;
 
 	// Only auto fire can use button-holding input
-	if (CurrentShootingMode != ShootModes::Auto)
+	if (CurrentShootingMode != ShootModes::Auto && CurrentShootingMode != ShootModes::Minigun)
 		return;
 	OnFire();
 }
@@ -284,37 +314,10 @@ void AArmorBlastingCharacter::ShootSemiAuto()
 	auto CameraComponent = GetFirstPersonCameraComponent();
 	auto CameraForward = CameraComponent->GetForwardVector();
 	CameraForward.Normalize();
-	FCollisionQueryParams QueryParams = FCollisionQueryParams::DefaultQueryParam;
-	QueryParams.AddIgnoredActor(this);
-	QueryParams.bTraceComplex = true;
 
-	// -- DEBUG ONLY -----------------------
-	// Use this if you want to see the trace for shots
-	// if (GetWorld() != nullptr)
-	// {
-	// 	const FName TraceTag = TEXT("ShotTrace");
-	// 	QueryParams.TraceTag = TraceTag;
-	// 	GetWorld()->DebugDrawTraceTag = TraceTag;
-	// }
-	// -------------------------------------
-
-	// Try to create a linetrace shot
-	FHitResult HitResult;
-	bool bHitSomething = GetWorld()->LineTraceSingleByChannel(HitResult, SpawnLocation, SpawnLocation + 100000 * CameraForward, ECC_Enemy, QueryParams);
-
-	// We have to check if what we hit provides a BlastableComponent
-	if (bHitSomething)
-	{
-		auto Actor = HitResult.Actor;
-		auto BlastableComponent = Actor->FindComponentByClass<UBlastableComponent>();
-
-		// if doesn't provide skeletal mesh, nothing to do
-		if (BlastableComponent != nullptr)
-		{
-			BlastableComponent->Blast(HitResult.Location, 5);
-			UNiagaraFunctionLibrary::SpawnSystemAtLocation(this, ImpactSparks, HitResult.Location, HitResult.ImpactNormal.Rotation(), 0.001 * FVector::OneVector);
-		}
-	}
+	const TArray<FVector_NetQuantize> Ends = { SpawnLocation + 100000 * CameraForward };
+	const TArray<float> ImpactRadii = { 5 };
+	FireTraces(SpawnLocation, Ends, ImpactRadii);
 }
 
 void AArmorBlastingCharacter::ShootAuto()
@@ -351,10 +354,13 @@ void AArmorBlastingCharacter::ShootShotgun()
 	const float MaxSpreadRadius = 50;
 	const float MaxRange = 1000;
 	const FVector CentralEndpoint = SpawnLocation + CameraForward * MaxRange;
-	const int NShots = 15;
-	const float MaxShotImpactRadius = 6;
-	const float MinShotImpactRadius = 2;
+	const int NShots = BlastableScalability::GetShotgunPellets();
+	const float MaxShotImpactRadius = BlastableScalability::GetShotgunMaxImpactRadius();
+	const float MinShotImpactRadius = BlastableScalability::GetShotgunMinImpactRadius();
 
+	// All pellets are traced together, so clients send them to the server in a single call
+	TArray<FVector_NetQuantize> Endpoints;
+	TArray<float> ImpactRadii;
 	for (int i = 0; i < NShots; i++)
 	{
 		// Compute radius and rotation for this endpoint
@@ -370,47 +376,207 @@ void AArmorBlastingCharacter::ShootShotgun()
 		// Impact Radius is how big the holes are in the impact point
 		const float ImpactRadius = FMath::Lerp(MinShotImpactRadius, MaxShotImpactRadius, Radius / MaxSpreadRadius);
 
-		// Ray Cast!
-		FCollisionQueryParams QueryParams = FCollisionQueryParams::DefaultQueryParam;
-		QueryParams.AddIgnoredActor(this);
-		QueryParams.bTraceComplex = true;
-
-		// -- DEBUG ONLY -----------------------
-		// if (GetWorld() != nullptr)
-		// {
-		// 	const FName TraceTag = TEXT("ShotTrace");
-		// 	QueryParams.TraceTag = TraceTag;
-		// 	GetWorld()->DebugDrawTraceTag = TraceTag;
-		// }
-		// -------------------------------------
-
-		// Try to create a linetrace shot
-		FHitResult HitResult;
-		bool bHitSomething = GetWorld()->LineTraceSingleByChannel(
-											HitResult, 
-											SpawnLocation, 
-											Endpoint, 
-											ECC_Enemy, 
-											QueryParams
-							);
-		// We have to check if what we hit provides a BlastableComponent
-		if (bHitSomething)
-		{
-			auto Actor = HitResult.Actor;
-			auto BlastableComponent = Actor->FindComponentByClass<UBlastableComponent>();
+		Endpoints.Add(Endpoint);
+		ImpactRadii.Add(ImpactRadius);
+	}
+
+	FireTraces(SpawnLocation, Endpoints, ImpactRadii);
+}
+
+void AArmorBlastingCharacter::FireTraces(const FVector& Start, const TArray<FVector_NetQuantize>& Ends, const TArray<float>& ImpactRadii)
+{
+	// Damage is server authoritative, clients predict it until the server replicates the blasts
+	const bool bAuthority = HasAuthority();
+	const FName Weapon = GetShootModeName(CurrentShootingMode);
+	const uint16 FirstShotId = bAuthority ? 0 : ReserveShotIds(Ends.Num());
+	for (int i = 0; i < Ends.Num(); i++)
+	{
+		FBlastableShotHit Hit;
+		FireTrace(Start, Ends[i], ImpactRadii[i], bAuthority, Weapon, uint16(FirstShotId + i), Hit);
+	}
+
+	if (!bAuthority)
+		ServerFireTraces(Start, Ends, ImpactRadii, static_cast<uint8>(CurrentShootingMode), FirstShotId);
+}
+
+uint16 AArmorBlastingCharacter::ReserveShotIds(int32 Num)
+{
+	const uint16 FirstShotId = NextShotId;
+	NextShotId = uint16(NextShotId + Num);
+	return FirstShotId;
+}
+
+FName AArmorBlastingCharacter::GetShootModeName(ShootModes Mode)
+{
+	static const FName Names[] = { TEXT("Semiauto"), TEXT("Shotgun"), TEXT("Auto"), TEXT("Minigun") };
+	static_assert(UE_ARRAY_COUNT(Names) == static_cast<int>(ShootModes::N_MODES), "Every shoot mode needs a name");
+
+	const int32 Index = static_cast<int32>(Mode);
+	return Index >= 0 && Index < UE_ARRAY_COUNT(Names) ? Names[Index] : NAME_None;
+}
+
+bool AArmorBlastingCharacter::FireTrace(const FVector& Start, const FVector& End, float ImpactRadius, bool bBlast, FName Weapon, uint16 ShotId, FBlastableShotHit& OutHit)
+{
+	FCollisionQueryParams QueryParams = FCollisionQueryParams::DefaultQueryParam;
+	QueryParams.AddIgnoredActor(this);
+	QueryParams.bTraceComplex = true;
+	QueryParams.bReturnFaceIndex = true; // Required to map hits to armor UVs
+
+	// -- DEBUG ONLY -----------------------
+	// Use this if you want to see the trace for shots
+	// if (GetWorld() != nullptr)
+	// {
+	// 	const FName TraceTag = TEXT("ShotTrace");
+	// 	QueryParams.TraceTag = TraceTag;
+	// 	GetWorld()->DebugDrawTraceTag = TraceTag;
+	// }
+	// -------------------------------------
+
+	// Try to create a linetrace shot
+	// Shots go through holes already blasted in the armor
+	FHitResult HitResult;
+	bool bHitSomething = BlastableTrace::LineTraceThroughHoles(GetWorld(), HitResult, Start, End, QueryParams);
+	bool bHitArmor = false;
+
+	// We have to check if what we hit provides a BlastableComponent
+	if (bHitSomething)
+	{
+		auto Actor = HitResult.Actor;
+		auto BlastableComponent = Actor.IsValid() ? Actor->FindComponentByClass<UBlastableComponent>() : nullptr;
+		auto const BlastableSubsystem = GetWorld()->GetSubsystem<UBlastableSubsystem>();
 
-			// if doesn't provide skeletal mesh, nothing to do
-			if (BlastableComponent != nullptr)
+		// if doesn't provide skeletal mesh, nothing to do
+		if (BlastableComponent != nullptr)
+		{
+			// Only stamp when we hit armor, shots that went through a hole and hit the body have nothing left to blast.
+			// Clients stamp right away and let the server confirm the blast later.
+			if (BlastableTrace::GetHitBlastable(HitResult) == BlastableComponent)
 			{
-				BlastableComponent->Blast(HitResult.Location, ImpactRadius);
-				UNiagaraFunctionLibrary::SpawnSystemAtLocation(this, ImpactSparks, HitResult.Location, HitResult.ImpactNormal.Rotation(), 0.001 * FVector::OneVector);
+				if (bBlast)
+					BlastableComponent->Blast(HitResult, ImpactRadius, Weapon);
+				else
+					BlastableComponent->PredictBlast(HitResult, ImpactRadius, ShotId);
+
+				OutHit.ShotId = ShotId;
+				OutHit.Blastable = BlastableComponent;
+				OutHit.Location = HitResult.Location;
+				bHitArmor = true;
 			}
+			if (BlastableSubsystem != nullptr)
+				BlastableSubsystem->SpawnImpactEffect(ImpactSparks.Get(), HitResult.Location, HitResult.ImpactNormal.Rotation());
+		}
+		else if (auto const Instanced = Cast<UBlastableInstancedComponent>(HitResult.GetComponent()))
+		{
+			// Props blasted one instance at a time. They are not replicated, every machine stamps its own.
+			if (Instanced->Blast(HitResult, ImpactRadius) && BlastableSubsystem != nullptr)
+				BlastableSubsystem->SpawnImpactEffect(ImpactSparks.Get(), HitResult.Location, HitResult.ImpactNormal.Rotation());
+		}
+	}
+
+	return bHitArmor;
+}
+
+bool AArmorBlastingCharacter::ServerFireTraces_Validate(FVector_NetQuantize Start, const TArray<FVector_NetQuantize>& Ends, const TArray<float>& ImpactRadii, uint8 ShootMode, uint16 FirstShotId)
+{
+	if (Ends.Num() != ImpactRadii.Num() || Ends.Num() > MaxTracesPerShot || ShootMode >= static_cast<uint8>(ShootModes::N_MODES))
+		return false;
 
+	if (!IsValidClientShotOrigin(Start))
+		return false;
 
-		}
+	for (auto const Radius : ImpactRadii)
+	{
+		if (!(Radius >= 0.f && Radius <= MaxClientImpactRadius))
+			return false;
+	}
+
+	return true;
+}
+
+void AArmorBlastingCharacter::ServerFireTraces_Implementation(FVector_NetQuantize Start, const TArray<FVector_NetQuantize>& Ends, const TArray<float>& ImpactRadii, uint8 ShootMode, uint16 FirstShotId)
+{
+	const FName Weapon = GetShootModeName(static_cast<ShootModes>(ShootMode));
+	TArray<FBlastableShotHit> Hits;
+	for (int i = 0; i < Ends.Num(); i++)
+	{
+		FBlastableShotHit Hit;
+		if (FireTrace(Start, Ends[i], ImpactRadii[i], true, Weapon, uint16(FirstShotId + i), Hit))
+			Hits.Add(Hit);
 	}
 
+	// Rays that hit nothing are resolved too, the client rolls back whatever it predicted for them
+	ClientResolveShots(FirstShotId, uint8(Ends.Num()), Hits);
+}
+
+void AArmorBlastingCharacter::ClientResolveShots_Implementation(uint16 FirstShotId, uint8 NumShots, const TArray<FBlastableShotHit>& Hits)
+{
+	if (auto const BlastableSubsystem = GetWorld()->GetSubsystem<UBlastableSubsystem>())
+		BlastableSubsystem->ResolvePredictions(FirstShotId, NumShots, Hits);
+}
 
+void AArmorBlastingCharacter::OnProjectileResolved(AActor* Instigator, uint16 ShotId, UBlastableComponent* Blastable, const FVector& Location)
+{
+	// Only remote clients predict, projectiles of this machine are already where they belong
+	if (Instigator != this || IsLocallyControlled())
+		return;
+
+	TArray<FBlastableShotHit> Hits;
+	if (Blastable != nullptr)
+	{
+		FBlastableShotHit& Hit = Hits.AddDefaulted_GetRef();
+		Hit.ShotId = ShotId;
+		Hit.Blastable = Blastable;
+		Hit.Location = Location;
+	}
+	ClientResolveShots(ShotId, 1, Hits);
+}
+
+void AArmorBlastingCharacter::ShootMinigun()
+{
+	UWorld* const World = GetWorld();
+	if (World == NULL) return;
+
+	// Projectiles are plain data in the projectile subsystem, nothing gets spawned here
+	auto ProjectileSubsystem = World->GetSubsystem<UBlastableProjectileSubsystem>();
+	if (ProjectileSubsystem == nullptr) return;
+
+	auto CameraComponent = GetFirstPersonCameraComponent();
+	const FVector SpawnLocation = CameraComponent->GetComponentLocation();
+	const FVector Direction = FMath::VRandCone(CameraComponent->GetForwardVector(), FMath::DegreesToRadians(MinigunSpreadAngle));
+
+	// Clients simulate their own projectile to predict its impact, the server one is the one that blasts
+	const float ImpactRadius = 3;
+	const uint16 ShotId = HasAuthority() ? 0 : ReserveShotIds(1);
+	ProjectileSubsystem->FireProjectile(SpawnLocation, Direction * MinigunProjectileSpeed, ImpactRadius, this, ImpactSparks.Get(), GetShootModeName(ShootModes::Minigun), ShotId);
+	if (!HasAuthority())
+		ServerFireProjectile(SpawnLocation, Direction, ShotId);
+}
+
+bool AArmorBlastingCharacter::ServerFireProjectile_Validate(FVector_NetQuantize Origin, FVector_NetQuantizeNormal Direction, uint16 ShotId)
+{
+	return !Direction.ContainsNaN() && IsValidClientShotOrigin(Origin);
+}
+
+bool AArmorBlastingCharacter::IsValidClientShotOrigin(const FVector& Origin) const
+{
+	// Shots start at the camera, see the Shoot functions
+	auto const CameraComponent = GetFirstPersonCameraComponent();
+	return !Origin.ContainsNaN() && CameraComponent != nullptr
+		&& FVector::DistSquared(Origin, CameraComponent->GetComponentLocation()) <= FMath::Square(MaxClientShotOriginError);
+}
+
+void AArmorBlastingCharacter::ServerFireProjectile_Implementation(FVector_NetQuantize Origin, FVector_NetQuantizeNormal Direction, uint16 ShotId)
+{
+	auto const World = GetWorld();
+	auto const ProjectileSubsystem = World != nullptr ? World->GetSubsystem<UBlastableProjectileSubsystem>() : nullptr;
+	if (ProjectileSubsystem == nullptr)
+	{
+		ClientResolveShots(ShotId, 1, TArray<FBlastableShotHit>());
+		return;
+	}
+
+	const float ImpactRadius = 3;
+	ProjectileSubsystem->FireProjectile(Origin, Direction.GetSafeNormal() * MinigunProjectileSpeed, ImpactRadius, this, ImpactSparks.Get(), GetShootModeName(ShootModes::Minigun), ShotId);
 }
 
 bool AArmorBlastingCharacter::CanShoot() const
@@ -451,6 +617,9 @@ void AArmorBlastingCharacter::SwapGun(float Val)
 	case AArmorBlastingCharacter::ShootModes::Auto:
 		Gun = "Auto";
 		break;
+	case AArmorBlastingCharacter::ShootModes::Minigun:
+		Gun = "Minigun";
+		break;
 	case AArmorBlastingCharacter::ShootModes::N_MODES:
 	default:
 		break;
@@ -4,6 +4,8 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Character.h"
+#include "Engine/NetSerialization.h"
+#include "BlastableNet.h"
 #include "ArmorBlastingCharacter.generated.h"
 
 class UInputComponent;
@@ -51,6 +53,7 @@ public:
 		Semiauto,
 		Shotgun,
 		Auto,
+		Minigun,
 		N_MODES
 	};
 
@@ -67,6 +70,16 @@ public:
 	UFUNCTION(BlueprintPure)
 	FString GetCurrentGunName() const;
 
+	/** Maximum amount of rays a client can send in a single shot */
+	static constexpr int32 MaxTracesPerShot = 32;
+
+	/** Largest hole a client can ask for */
+	static constexpr float MaxClientImpactRadius = 20.f;
+
+	/** Sparks emitted at impact location, null until they are preloaded */
+	UFUNCTION(BlueprintPure, Category = VFX)
+	UNiagaraSystem* GetImpactSparks() const { return ImpactSparks.Get(); }
+
 protected:
 	virtual void BeginPlay();
 
@@ -96,9 +109,9 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Gameplay)
 	class USoundBase* ShotgunPumpSound;
 
-	/** Sparks emitted at impact location */
+	/** Sparks emitted at impact location. Preloaded and warmed up when play begins, impacts before that show no sparks. */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = VFX)
-	class UNiagaraSystem* ImpactSparks;
+	TSoftObjectPtr<UNiagaraSystem> ImpactSparks;
 
 	/** AnimMontage to play each time we fire */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Gameplay)
@@ -120,6 +133,18 @@ public:
 	UPROPERTY(EditAnywhere, Category = Combat)
 	int ShotgunFireRate = 2;
 
+	/** Minigun Fire Rate: How many projectiles per second to shoot on minigun mode. */
+	UPROPERTY(EditAnywhere, Category = Combat)
+	int MinigunFireRate = 30;
+
+	/** Speed in cm/s of minigun projectiles */
+	UPROPERTY(EditAnywhere, Category = Combat)
+	float MinigunProjectileSpeed = 6000.f;
+
+	/** Maximum deviation in degrees of minigun projectiles from the aiming direction */
+	UPROPERTY(EditAnywhere, Category = Combat)
+	float MinigunSpreadAngle = 2.f;
+
 
 protected:
 	
@@ -163,6 +188,72 @@ protected:
 	/// </summary>
 	void ShootShotgun();
 
+	/// <summary>
+	/// Shoot a slow minigun projectile, simulated by the projectile subsystem
+	/// </summary>
+	void ShootMinigun();
+
+	/// <summary>
+	/// Trace a batch of rays sharing the same origin. Armor is only blasted on the server, clients
+	/// send the rays to the server and predict the damage until the blasts are replicated.
+	/// </summary>
+	/// <param name="Start"> Origin of every ray </param>
+	/// <param name="Ends"> End point of every ray </param>
+	/// <param name="ImpactRadii"> Size of the hole made by every ray </param>
+	void FireTraces(const FVector& Start, const TArray<FVector_NetQuantize>& Ends, const TArray<float>& ImpactRadii);
+
+	/// <summary>
+	/// Trace a single ray, blasting whatever it hits if `bBlast` is set or predicting the blast otherwise
+	/// </summary>
+	/// <param name="Weapon"> Name of the shoot mode that fired the ray, recorded by blast telemetry </param>
+	/// <param name="ShotId"> Id of the ray, predictions keep it until the server resolves the ray </param>
+	/// <param name="OutHit"> Armor the ray hit, if any </param>
+	/// <returns> True if the ray hit armor </returns>
+	bool FireTrace(const FVector& Start, const FVector& End, float ImpactRadius, bool bBlast, FName Weapon, uint16 ShotId, FBlastableShotHit& OutHit);
+
+	/// <summary>
+	/// Trace rays fired by a client on the server, and tell the client which armor they hit. The shoot mode
+	/// is only sent so telemetry knows the weapon. Reliable, so every predicted shot gets resolved.
+	/// </summary>
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerFireTraces(FVector_NetQuantize Start, const TArray<FVector_NetQuantize>& Ends, const TArray<float>& ImpactRadii, uint8 ShootMode, uint16 FirstShotId);
+
+	/// <summary>
+	/// Roll back the predictions of shots the server resolved without hitting armor where this client did
+	/// </summary>
+	/// <param name="FirstShotId"> Id of the first shot resolved </param>
+	/// <param name="NumShots"> Amount of consecutive shot ids resolved </param>
+	/// <param name="Hits"> Armor the resolved shots hit on the server </param>
+	UFUNCTION(Client, Reliable)
+	void ClientResolveShots(uint16 FirstShotId, uint8 NumShots, const TArray<FBlastableShotHit>& Hits);
+
+	/** Name of a shoot mode, as recorded by blast telemetry */
+	static FName GetShootModeName(ShootModes Mode);
+
+	/** Fire a minigun projectile fired by a client on the server. Reliable, so every predicted shot gets resolved. */
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerFireProjectile(FVector_NetQuantize Origin, FVector_NetQuantizeNormal Direction, uint16 ShotId);
+
+	/** Tell the client that fired a projectile what it hit on the server */
+	void OnProjectileResolved(AActor* Instigator, uint16 ShotId, UBlastableComponent* Blastable, const FVector& Location);
+
+	/// <summary>
+	/// Take consecutive ids for the shots this client is about to predict
+	/// </summary>
+	/// <returns> First id taken </returns>
+	uint16 ReserveShotIds(int32 Num);
+
+	/** Id the next shot predicted by this client gets, wraps around */
+	uint16 NextShotId = 0;
+
+	/** How far from where the server sees the camera a client shot can start, to allow for movement lag */
+	static constexpr float MaxClientShotOriginError = 250.f;
+
+	/// <summary>
+	/// Checks if a shot sent by the client starts close enough to where this character shoots from
+	/// </summary>
+	bool IsValidClientShotOrigin(const FVector& Origin) const;
+
 	/// <summary>
 	/// Checks if you can shoot something. 
 	/// </summary>
@@ -5,6 +5,7 @@
 #include "Engine/TextureRenderTarget2D.h"
 #include "Materials/Material.h"
 #include "Materials/MaterialInstanceDynamic.h"
+#include "TimerManager.h"
 
 // Sets default values
 ABlastableActor::ABlastableActor()
@@ -23,36 +24,43 @@ ABlastableActor::ABlastableActor()
 	DamageRenderTarget = CreateDefaultSubobject<UTextureRenderTarget2D>(TEXT("DamageRenderTarget"));
 	SetUnwrapMaterial(CreateDefaultSubobject<UMaterial>(TEXT("UnwrapMaterial")));
 
-
-	SetUpSceneRender2D();
+	// Props keep capturing the way they always did, their materials expect it
+	BlastableCore::SetUpSceneCapture(SceneCaptureComponent2D, false);
 }
 
 // Called when the game starts or when spawned
 void ABlastableActor::BeginPlay()
 {
 	Super::BeginPlay();
-	
+
+	Core.MeshSource.Mesh = StaticMeshComponent;
+
+	// Fading damage is optional for props
+	if (FadingMaterial != nullptr && DamageRenderTarget != nullptr)
+	{
+		TimeDamageRenderTarget = BlastableCore::CreateDamageRenderTarget(this, TEXT("TimeDamageRenderTarget"), DamageRenderTarget->SizeX, true, false);
+		FadingMaterialInstance = BlastableCore::CreateFadingMaterial(FadingMaterial, this, TimeDamageRenderTarget);
+		GetWorldTimerManager().SetTimer(DamageFadingTimerHandle, this, &ABlastableActor::UpdateFadingDamageRenderTarget, 0.10, true, 0);
+	}
 }
 
-void ABlastableActor::SetUpSceneRender2D()
+void ABlastableActor::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
-	SceneCaptureComponent2D->bCaptureEveryFrame = false;
-	SceneCaptureComponent2D->bCaptureOnMovement = false;
-	SceneCaptureComponent2D->ShowOnlyActors.Add(SceneCaptureComponent2D->GetOwner());
-	SceneCaptureComponent2D->PrimitiveRenderMode = ESceneCapturePrimitiveRenderMode::PRM_UseShowOnlyList;
-	SceneCaptureComponent2D->SetRelativeLocation({ 0,0,512 });
-	SceneCaptureComponent2D->SetRelativeRotation(FRotator{ -90,-90,0 });
-	SceneCaptureComponent2D->ProjectionType = ECameraProjectionMode::Orthographic;
-	SceneCaptureComponent2D->OrthoWidth = 1024;
-	SceneCaptureComponent2D->ShowFlags.Atmosphere = 0;
-	SceneCaptureComponent2D->ShowFlags.AmbientCubemap = 0;
+	GetWorldTimerManager().ClearTimer(DamageFadingTimerHandle);
+
+	Super::EndPlay(EndPlayReason);
 }
 
 void ABlastableActor::SetUnwrapMaterial(UMaterial* Material)
 {
 	UnwrapMaterial = Material;
-	if(IsValid(UnwrapMaterial) && IsValid(this))
-		UnwrapMaterialInstance = UMaterialInstanceDynamic::Create(UnwrapMaterial, this, TEXT("UnwrapMaterialInstace"));
+	if (IsValid(UnwrapMaterial))
+		UnwrapMaterialInstance = BlastableCore::CreateUnwrapMaterial(UnwrapMaterial, this);
+}
+
+void ABlastableActor::UpdateFadingDamageRenderTarget()
+{
+	BlastableCore::FadeRenderTarget(this, TimeDamageRenderTarget, FadingMaterialInstance);
 }
 
 // Called every frame
@@ -63,28 +71,8 @@ void ABlastableActor::Tick(float DeltaTime)
 
 void ABlastableActor::UnwrapToRenderTarget(FVector HitLocation, float Radius)
 {
-	if (!IsValid(UnwrapMaterialInstance))
-		SetUnwrapMaterial(UnwrapMaterial);
-
-	if (!IsValid(UnwrapMaterialInstance) || !UnwrapMaterialInstance->IsValidLowLevel())
-	{
-		UE_LOG(LogTemp, Error, TEXT("Could not instance material"));
-		return;
-	}
-
-	// Store old material to restore it afterwards
-	auto OldMaterial = StaticMeshComponent->GetMaterial(0);
-	StaticMeshComponent->SetMaterial(0, UnwrapMaterialInstance);
-
-	UnwrapMaterialInstance->SetScalarParameterValue(TEXT("DamageRadius"), Radius);
-	UnwrapMaterialInstance->SetVectorParameterValue(TEXT("HitLocation"), HitLocation);
-
-	// Capture Scene with just the unwrapped material and hit locations
-	SceneCaptureComponent2D->TextureTarget = DamageRenderTarget;
-	SceneCaptureComponent2D->CaptureScene();
-
-	if (IsValid(OldMaterial))
-		StaticMeshComponent->SetMaterial(0, OldMaterial);
+	const FVector4 Stamp(HitLocation, Radius);
+	BlastBatch(MakeArrayView(&Stamp, 1));
 }
 
 void ABlastableActor::Blast(FVector Location, float ImpactRadius)
@@ -92,3 +80,11 @@ void ABlastableActor::Blast(FVector Location, float ImpactRadius)
 	UnwrapToRenderTarget(Location, ImpactRadius);
 }
 
+void ABlastableActor::BlastBatch(TArrayView<const FVector4> Stamps)
+{
+	if (!IsValid(UnwrapMaterialInstance))
+		SetUnwrapMaterial(UnwrapMaterial);
+
+	UTextureRenderTarget2D* const Targets[] = { DamageRenderTarget, TimeDamageRenderTarget };
+	Core.UnwrapStamps(SceneCaptureComponent2D, UnwrapMaterialInstance, Targets, Stamps, GetActorLocation());
+}
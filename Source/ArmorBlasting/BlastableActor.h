@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "BlastableCore.h"
 #include "BlastableActor.generated.h"
 
 class USceneCaptureComponent2D;
@@ -24,6 +25,9 @@ protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
+	// Called when the game ends or the actor is destroyed
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 	UPROPERTY(EditAnywhere, Category = "Components")
 	UStaticMeshComponent* StaticMeshComponent;
 
@@ -40,12 +44,32 @@ protected:
 	UPROPERTY()
 	UMaterialInstanceDynamic* UnwrapMaterialInstance;
 
+	/** Material used to fade damage over time. Damage only fades if this is set. */
+	UPROPERTY(EditAnywhere, Category = "Resources")
+	UMaterial* FadingMaterial;
+
+	/** Render target where the damage over time will be drawn, created in runtime if there is a fading material */
+	UPROPERTY(Transient)
+	UTextureRenderTarget2D* TimeDamageRenderTarget;
+
+	/** Material instance used for fading damage */
+	UPROPERTY()
+	UMaterialInstanceDynamic* FadingMaterialInstance;
+
+	/** Used to repeat fading damage material */
+	FTimerHandle DamageFadingTimerHandle;
+
+	/** Shared unwrap and capture flow, drawing the static mesh of this actor */
+	TBlastableCore<FBlastableStaticMeshSource> Core;
+
 protected:
-	
-	void SetUpSceneRender2D();
 
 	void SetUnwrapMaterial(UMaterial* Material);
 
+	/** Update fading damage every few ms to implement the slow fading effect */
+	UFUNCTION()
+	void UpdateFadingDamageRenderTarget();
+
 public:	
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
@@ -59,4 +83,10 @@ public:
 	/// <param name="Location">Location in world space where this object was hit</param>
 	void Blast(FVector Location, float ImpactRadius);
 
+	/// <summary>
+	/// Apply many blasts at once. The mesh material is swapped only once for the whole batch.
+	/// </summary>
+	/// <param name="Stamps">Hit location in xyz and impact radius in w of every blast</param>
+	void BlastBatch(TArrayView<const FVector4> Stamps);
+
 };
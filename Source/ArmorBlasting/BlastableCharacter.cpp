@@ -2,6 +2,7 @@
 
 #include "BlastableCharacter.h"
 #include "BlastableComponent.h"
+#include "GameFramework/CharacterMovementComponent.h"
 
 // Sets default values
 ABlastableCharacter::ABlastableCharacter()
@@ -41,3 +42,38 @@ void ABlastableCharacter::SetupPlayerInputComponent(UInputComponent* PlayerInput
 
 }
 
+
+void ABlastableCharacter::OnReleasedToPool()
+{
+	SetActorHiddenInGame(true);
+	SetActorEnableCollision(false);
+	SetActorTickEnabled(false);
+
+	auto Movement = GetCharacterMovement();
+	if (Movement != nullptr)
+	{
+		Movement->StopMovementImmediately();
+		Movement->Deactivate();
+	}
+
+	if (BlastableComponent != nullptr)
+		BlastableComponent->SetBlastableActive(false);
+}
+
+void ABlastableCharacter::OnAcquiredFromPool()
+{
+	// Clear damage first so that the character never shows up with the holes of its previous life
+	if (BlastableComponent != nullptr)
+	{
+		BlastableComponent->ResetDamage();
+		BlastableComponent->SetBlastableActive(true);
+	}
+
+	auto Movement = GetCharacterMovement();
+	if (Movement != nullptr)
+		Movement->Activate();
+
+	SetActorTickEnabled(true);
+	SetActorEnableCollision(true);
+	SetActorHiddenInGame(false);
+}
@@ -31,6 +31,16 @@ public:
 	UFUNCTION(BlueprintCallable)
 	UBlastableComponent* GetBlastableComponent() const { return BlastableComponent; }
 
+	/// <summary>
+	/// Called by the blastable pool when this character is parked. Hides it and stops all of its work.
+	/// </summary>
+	virtual void OnReleasedToPool();
+
+	/// <summary>
+	/// Called by the blastable pool when this character is reused. Clears its damage and brings it back to life.
+	/// </summary>
+	virtual void OnAcquiredFromPool();
+
 protected:
 
 	UPROPERTY(EditAnywhere, Category = "Armor Blasting")
@@ -10,6 +10,44 @@
 #include "ArmorBlasting.h"
 #include "Engine/CanvasRenderTarget2D.h"
 #include "GameFramework/Character.h"
+#include "Kismet/GameplayStatics.h"
+#include "BlastableSubsystem.h"
+#include "BlastableSetupCache.h"
+#include "BlastableCore.h"
+#include "Engine/Texture2D.h"
+#include "GameFramework/GameStateBase.h"
+#include "Net/UnrealNetwork.h"
+#include "Misc/App.h"
+#include "Engine/GameInstance.h"
+#include "BlastableScalability.h"
+#include "BlastableTelemetry.h"
+#include "BlastablePreload.h"
+
+namespace
+{
+	/** Persistence subsystem if `Blastable` persists its damage, null otherwise. Only the server persists damage. */
+	UBlastablePersistenceSubsystem* GetPersistenceSubsystem(const UBlastableComponent* Blastable)
+	{
+		if (!Blastable->ShouldPersistDamage() || Blastable->GetOwnerRole() != ROLE_Authority)
+			return nullptr;
+
+		auto const World = Blastable->GetWorld();
+		auto const GameInstance = World != nullptr ? World->GetGameInstance() : nullptr;
+		return GameInstance != nullptr ? GameInstance->GetSubsystem<UBlastablePersistenceSubsystem>() : nullptr;
+	}
+
+	/** Copy of a damage target at another size, stretched to cover all of it */
+	UTextureRenderTarget2D* ResizeDamageTarget(UBlastableComponent* Blastable, UTextureRenderTarget2D* Target, int32 Size)
+	{
+		if (Target == nullptr)
+			return nullptr;
+
+		auto const Name = MakeUniqueObjectName(Blastable, UTextureRenderTarget2D::StaticClass(), Target->GetFName());
+		auto const Resized = BlastableCore::CreateDamageRenderTarget(Blastable, Name, Size, Target->bNeedsTwoCopies, Target->bAutoGenerateMips);
+		BlastableCore::CopyRenderTarget(Blastable, Target, Resized);
+		return Resized;
+	}
+}
 
 // Sets default values for this component's properties
 UBlastableComponent::UBlastableComponent()
@@ -18,281 +56,1184 @@ UBlastableComponent::UBlastableComponent()
 	// off to improve performance if you don't need them.
 	PrimaryComponentTick.bCanEverTick = true;
 
+	// Needed to keep the spatial index up to date when the owner moves
+	bWantsOnUpdateTransform = true;
+
+	// Break armor pieces off at 60% by default
+	IntegrityThresholds.Add(0.6f);
+
 	// Set up components
 	SceneCapture = CreateDefaultSubobject<USceneCaptureComponent2D>(TEXT("SceneCapture"));
 	SceneCapture->AttachToComponent(this, FAttachmentTransformRules::SnapToTargetNotIncludingScale);
-	SetUpSceneRender2D();
+	BlastableCore::SetUpSceneCapture(SceneCapture, true);
+
+	Core.MeshSource.ArmorMeshes = &ArmorRenderMeshes;
+
+	// Blasts happen on the server and reach clients as quantized events
+	SetIsReplicatedByDefault(true);
 }
 
+void UBlastableComponent::PostInitProperties()
+{
+	Super::PostInitProperties();
+
+	// Set after properties are copied from the archetype, which would point it to the archetype
+	NetEvents.Owner = this;
+}
+
+
+void UBlastableComponent::OnRegister()
+{
+	Super::OnRegister();
+
+	// Start streaming materials in as soon as the blastable exists, they are needed by BeginPlay
+	auto const World = GetWorld();
+	auto const Preload = World != nullptr && World->IsGameWorld() ? World->GetSubsystem<UBlastablePreloadSubsystem>() : nullptr;
+	if (Preload != nullptr && FApp::CanEverRender())
+		Preload->Preload({ UnwrapMaterial.ToSoftObjectPath(), StampMaterial.ToSoftObjectPath(), FadingMaterial.ToSoftObjectPath() });
+}
 
 // Called when the game starts
 void UBlastableComponent::BeginPlay()
 {
 	Super::BeginPlay();
 
-	// Set up render targets:
-	DamageRenderTarget = NewObject<UTextureRenderTarget2D>();
-	DamageRenderTarget->Rename(TEXT("DamageRenderTarget"));
-	DamageRenderTarget->ResizeTarget(1024, 1024);
-	DamageRenderTarget->ClearColor = FColor::Black;
+	// Machines that can't render, like dedicated servers, keep damage in system memory
+	bUseCpuDamage = DamageBackend == EBlastableDamageBackend::Cpu || (DamageBackend == EBlastableDamageBackend::Auto && !FApp::CanEverRender());
+
+	// The stamp shaders of the world renderer draw damage when it exists, captures and canvases otherwise
+	auto const Subsystem = GetWorld() != nullptr ? GetWorld()->GetSubsystem<UBlastableSubsystem>() : nullptr;
+	const bool bHasRenderer = Subsystem != nullptr && Subsystem->GetDamageRenderer() != nullptr;
+	if (!bUseCpuDamage)
+	{
+		// Set up render targets. The time damage target fades by drawing onto itself. Only the
+		// renderer keeps mips cheap to update.
+		const int32 TargetSize = BlastableScalability::GetDamageResolution(DamageRenderTargetSize);
+		DamageRenderTarget = BlastableCore::CreateDamageRenderTarget(this, TEXT("DamageRenderTarget"), TargetSize, false, bHasRenderer);
+		TimeDamageRenderTarget = BlastableCore::CreateDamageRenderTarget(this, TEXT("TimeDamageRenderTarget"), TargetSize, true, bHasRenderer);
 
-	TimeDamageRenderTarget = NewObject<UTextureRenderTarget2D>();
-	TimeDamageRenderTarget->Rename(TEXT("TimeDamageRenderTarget"));
-	TimeDamageRenderTarget->ResizeTarget(1024, 1024);
-	TimeDamageRenderTarget->ClearColor = FColor::Black;
-	TimeDamageRenderTarget->bNeedsTwoCopies = true; 
-	// ^ Note that bNeedsTwoCopies is necessary to prevent the DrawMaterial call
-	// from clearing the render target used to fade over time before actually fading it. 
-	// (making it black before sampling the texture and writing back to it)
+		// Set up the CPU side copy of the damage map. It is refreshed through async readbacks of a
+		// downsampled copy, so gameplay can query damage without stalling the GPU.
+		DamageMirror.Initialize(DamageMirrorResolution);
+		DamageMirrorRenderTarget = NewObject<UTextureRenderTarget2D>(this);
+		DamageMirrorRenderTarget->RenderTargetFormat = ETextureRenderTargetFormat::RTF_RGBA8;
+		DamageMirrorRenderTarget->ClearColor = FColor::Black;
+		DamageMirrorRenderTarget->ResizeTarget(DamageMirror.GetResolution(), DamageMirror.GetResolution());
 
+		// Set up dynamic materials
+		UnwrapMaterialInstance = BlastableCore::CreateUnwrapMaterial(UBlastablePreloadSubsystem::Resolve(UnwrapMaterial), this);
+		if (UnwrapMaterialInstance != nullptr)
+			UnwrapMaterialInstance->SetScalarParameterValue(FName("ErosionPerHit"), ErosionPerHit);
+		UnwrapFadingMaterialInstance = BlastableCore::CreateFadingMaterial(UBlastablePreloadSubsystem::Resolve(FadingMaterial), this, TimeDamageRenderTarget);
+	}
 
-	// Set up dynamic materials
-	SetUnwrapMaterial(UnwrapMaterial);
-	SetFadingMaterial(FadingMaterial);
+	// Find the body once, so that captures never search for it
+	Core.MeshSource.Body = GetMeshComponent();
 
 	// Sanity checks
 	CheckComponentConsistency();
 
-	// Set up Blastable meshes 
+	// Set up Blastable meshes. Which components are pieces, their collision and their layouts
+	// are the same for every instance of a class, so they are only searched once per class.
+	// Components begin play with their owner, binding only fails without one
 	auto const Owner = GetOwner();
-	if (Owner != nullptr)
-		BlastableMeshes = GetBlastableMeshSet();
-	else
+	check(Owner != nullptr);
+	auto const Setup = FBlastableClassSetupCache::Get().Bind(Owner, IntegrityGridResolution, BlastableMeshes);
+	check(Setup != nullptr);
+
+	// Note that blastable meshes are intended to use complex collisions, and for that reason
+	// we only block traces in ECC_Enemy, to prevent the physics engine from computing physics 
+	// using complex geometry. Every response is set at once, so physics state is updated one time.
+	for (auto const Mesh : BlastableMeshes)
+		Mesh->SetCollisionResponseToChannels(Setup->CollisionResponses);
+
+	// Pieces draw the armor themselves
+	ArmorRenderMeshes = TArray<UMeshComponent*>(BlastableMeshes);
+
+	// The CPU backend takes damage tiles from a pool shared by the whole world. Armor samples them
+	// from textures laid out like the damage targets, only needed when there is someone to see them.
+	auto World = GetWorld();
+	auto const TilePool = bUseCpuDamage && World != nullptr ? &World->GetSubsystem<UBlastableSubsystem>()->GetDamageTilePool() : nullptr;
+	if (TilePool != nullptr && FApp::CanEverRender())
 	{
-		UE_LOG(LogTemp, Warning, TEXT("Could not set up blastable mesh"));
+		const int32 Resolution = FMath::DivideAndRoundUp(CpuDamageResolution, FBlastableDamageTilePool::TileSize) * FBlastableDamageTilePool::TileSize;
+		CpuDamageTexture = BlastableCore::CreateCpuTexture(Resolution, PF_G8, false);
+		CpuFadingDamageTexture = BlastableCore::CreateCpuTexture(Resolution, PF_G8, false);
 	}
 
 	// Set up material arguments for all possible sub materials
-	for (auto const Mesh : BlastableMeshes)
+	UTexture* const DamageTexture = bUseCpuDamage ? static_cast<UTexture*>(CpuDamageTexture) : DamageRenderTarget;
+	UTexture* const FadingTexture = bUseCpuDamage ? static_cast<UTexture*>(CpuFadingDamageTexture) : TimeDamageRenderTarget;
+	for (auto const Mesh : ArmorRenderMeshes)
 	{
-		if (Mesh == nullptr)
-			continue;
-
-		// Note that blastable meshes are intended to use complex collisions, and for that reason
-		// we only block traces in ECC_Enemy, to prevent the physics engine from computing physics 
-		// using complex geometry.
-		Mesh->SetCollisionResponseToAllChannels(ECollisionResponse::ECR_Ignore);
-		Mesh->SetCollisionResponseToChannel(ECC_Enemy, ECollisionResponse::ECR_Block);
+		if (DamageTexture == nullptr)
+			break;
 
 		// Create dynamic material instances and set up parameter values.
-		auto const Materials = Mesh->GetMaterials();
-		for (size_t i = 0; i < Materials.Num(); i++)
+		for (int32 Section = 0; Section < Mesh->GetNumMaterials(); Section++)
 		{
-			auto& Material = Materials[i];
+			auto const Material = Mesh->GetMaterial(Section);
 
 			// Check if this is a dynamic material instance:
-			if (Cast<UMaterialInstanceDynamic>(Material) != nullptr)
+			if (Material == nullptr || Cast<UMaterialInstanceDynamic>(Material) != nullptr)
 				continue;
 
 			auto DynamicMaterial = UMaterialInstanceDynamic::Create(Material, this);
+			if (DynamicMaterial == nullptr)
+				continue;
 
 			// Set the texture where this material instance will sample for damage
-			DynamicMaterial->SetTextureParameterValue(FName("RT_UnwrapDamage"), DamageRenderTarget);
-			DynamicMaterial->SetTextureParameterValue(FName("RT_FadingDamage"), TimeDamageRenderTarget);
+			DynamicMaterial->SetTextureParameterValue(FName("RT_UnwrapDamage"), DamageTexture);
+			DynamicMaterial->SetTextureParameterValue(FName("RT_FadingDamage"), FadingTexture);
+			Mesh->SetMaterial(Section, DynamicMaterial);
+		}
+	}
+
+	// Set up integrity tracking. Every piece gets its footprint in the shared UV layout, 
+	// so stamps on one piece don't count as damage on the others.
+	IntegrityThresholds.Sort();
+	IntegrityGrid.Init(IntegrityGridResolution);
+	PieceIntegrity.SetNum(BlastableMeshes.Num());
+	for (int i = 0; i < BlastableMeshes.Num(); i++)
+		PieceIntegrity[i].Layout = Setup->GetInstanceLayout(i, Owner);
+
+	if (bUseCpuDamage)
+	{
+		TArray<FBox2D, TInlineAllocator<32>> PieceUVBounds;
+		for (auto const& Integrity : PieceIntegrity)
+			PieceUVBounds.Add(Integrity.Layout.IsValid() ? Integrity.Layout.UVBounds : FBox2D(ForceInit));
+		CpuDamage.Init(CpuDamageResolution, PieceUVBounds, TilePool);
+	}
+
+	// Stamp against the reference pose when possible, the map is baked once per class. The stamp
+	// shaders of the world renderer need nothing else, the stamp material is the fallback without them.
+	auto const LoadedStampMaterial = !bUseCpuDamage && !bHasRenderer ? UBlastablePreloadSubsystem::Resolve(StampMaterial) : nullptr;
+	if (!bUseCpuDamage && (bHasRenderer || LoadedStampMaterial != nullptr))
+		PositionMap = FBlastableClassSetupCache::Get().GetPositionMap(*Setup, BlastableMeshes, PositionMapResolution);
+
+	// Captures and stamp materials draw full damage, only the stamp shaders and the CPU backend erode.
+	// Hits breach right away there too, so that the integrity grid agrees with what the armor shows.
+	if (!bUseCpuDamage && (!bHasRenderer || PositionMap == nullptr) && ErosionPerHit < 1.f)
+	{
+		UE_LOG(LogTemp, Log, TEXT("%s can't erode armor on this machine, every hit breaches"), *Owner->GetName());
+		ErosionPerHit = 1.f;
+		if (UnwrapMaterialInstance != nullptr)
+			UnwrapMaterialInstance->SetScalarParameterValue(FName("ErosionPerHit"), ErosionPerHit);
+	}
+
+	// Without a position map stamps are captured, and the engine would regenerate every mip after each one
+	if (!bUseCpuDamage && bHasRenderer && PositionMap == nullptr)
+	{
+		for (auto const Target : { DamageRenderTarget, TimeDamageRenderTarget })
+		{
+			Target->bAutoGenerateMips = false;
+			Target->UpdateResourceImmediate(true);
+		}
+	}
 
-			if (DynamicMaterial != nullptr)
-				Mesh->SetMaterial(i, DynamicMaterial);
+	if (LoadedStampMaterial != nullptr)
+	{
+		for (int i = 0; PositionMap != nullptr && i < MaxStampsPerPass; i++)
+		{
+			auto const Instance = UMaterialInstanceDynamic::Create(LoadedStampMaterial, this);
+			if (Instance == nullptr)
+			{
+				UE_LOG(LogTemp, Warning, TEXT("Could not set up material instance for stamp material"));
+				break;
+			}
+
+			Instance->SetTextureParameterValue(FName("RT_PositionMap"), PositionMap);
+			Instance->SetScalarParameterValue(FName("ErosionPerHit"), ErosionPerHit);
+			StampMaterialPool.Add(Instance);
 		}
 	}
 
-	// Start timer to update fading. Note that we only update material fading 10 times a second 
+	// Start timer to update fading. Note that we only update material fading a few times a second 
 	// to prevent blowing the gpu with too many calls. 
-	auto World = GetWorld();
 	if (World)
-		World->GetTimerManager().SetTimer(DamageFadingTimerHandle, this, &UBlastableComponent::UpdateFadingDamageRenderTarget, 0.10, true, 0);
+	{
+		World->GetTimerManager().SetTimer(DamageFadingTimerHandle, this, &UBlastableComponent::UpdateFadingDamageRenderTarget, BlastableScalability::GetFadeInterval(), true, 0);
+
+		// Cache the subsystem so that blasts can be submitted from other threads without looking it up
+		BlastableSubsystem = World->GetSubsystem<UBlastableSubsystem>();
+	}
+
+	// Make this blastable visible to radial blasts
+	if (BlastableSubsystem != nullptr)
+		BlastableSubsystem->RegisterBlastable(this, ComputeBoundsRadius());
+
+	// Catch up with damage replicated before the armor was ready
+	if (bDamageSnapshotPending)
+		ApplyDamageSnapshot();
+	for (auto const& Event : PendingNetEvents)
+		ApplyNetEvent(Event);
+	PendingNetEvents.Empty();
+
+	// Get back damage kept while this blastable was streamed out, or loaded from a save
+	if (auto const Persistence = GetPersistenceSubsystem(this))
+		Persistence->RegisterBlastable(this);
+
+	// The first blastable of a class pays for the first draws while loading, instead of the first shot
+	auto const Preload = World != nullptr ? World->GetSubsystem<UBlastablePreloadSubsystem>() : nullptr;
+	if (Preload != nullptr && Preload->ClaimWarmUp(Owner->GetClass()))
+		WarmUpRendering(*Preload);
+}
+
+
+void UBlastableComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	// Damage of blastables that were destroyed for good is not kept
+	if (auto const Persistence = GetPersistenceSubsystem(this))
+		Persistence->UnregisterBlastable(this, EndPlayReason != EEndPlayReason::Destroyed);
+
+	ForgetQueuedDamage();
+	DamageMirror.Release();
+	CpuDamage.Release();
+
+	if (BlastableSubsystem != nullptr)
+		BlastableSubsystem->UnregisterBlastable(this);
+
+	Super::EndPlay(EndPlayReason);
 }
 
+void UBlastableComponent::OnUpdateTransform(EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport)
+{
+	Super::OnUpdateTransform(UpdateTransformFlags, Teleport);
+
+	// Keep the spatial index up to date as the owner moves around
+	if (BlastableSubsystem != nullptr && HasBegunPlay())
+		BlastableSubsystem->UpdateBlastable(this);
+}
+
+float UBlastableComponent::ComputeBoundsRadius() const
+{
+	float Radius = 0.f;
+	const FVector Center = GetComponentLocation();
+	for (auto const Mesh : BlastableMeshes)
+	{
+		if (Mesh != nullptr)
+			Radius = FMath::Max(Radius, FVector::Dist(Mesh->Bounds.Origin, Center) + Mesh->Bounds.SphereRadius);
+	}
+	return Radius;
+}
 
 // Called every frame
 void UBlastableComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
 {
 	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
 
-	// ...
+	// At most one rollback per frame, no matter how many predictions were rejected
+	if (bPredictionRollbackPending)
+		RollBackPredictions();
+
+	// Stamps not splatted by the subsystem yet, and whatever changed since the last upload
+	if (bUseCpuDamage)
+	{
+		SplatCpuStamps();
+		UploadCpuDamage();
+	}
+
+	// Pick up finished readbacks, and queue a new one if the damage changed. 
+	DamageMirror.Tick();
+	TimeSinceDamageMirrorRefresh += DeltaTime;
+	if (bDamageMirrorDirty && TimeSinceDamageMirrorRefresh >= DamageMirrorRefreshInterval)
+	{
+		if (DamageMirror.RequestRefresh(DamageRenderTarget, DamageMirrorRenderTarget))
+		{
+			bDamageMirrorDirty = false;
+			TimeSinceDamageMirrorRefresh = 0.f;
+		}
+	}
 }
 
 void UBlastableComponent::UnwrapToRenderTarget(FVector HitLocation, float Radius)
 {
-	// Sanity checks: Check for validity of required resources 
-	// (blastable meshes, unwrap material)
-	if (BlastableMeshes.Num() == 0)
+	const FVector4 Stamp(HitLocation, Radius);
+	UnwrapStampsToRenderTarget(MakeArrayView(&Stamp, 1));
+}
+
+void UBlastableComponent::UnwrapStampsToRenderTarget(TArrayView<const FVector4> Stamps, bool bFadingLayer)
+{
+	// Capture in the damage render target, and repeat for the secondary render target, 
+	// the image in this target will fade over time. Confirmed damage only exists on clients
+	// predicting blasts, and everything stamped here is damage the server agrees on.
+	UTextureRenderTarget2D* const Targets[] = { DamageRenderTarget, bFadingLayer ? TimeDamageRenderTarget : nullptr, ConfirmedDamageRenderTarget };
+	StampTargets(Stamps, Targets);
+}
+
+void UBlastableComponent::StampTargets(TArrayView<const FVector4> Stamps, TArrayView<UTextureRenderTarget2D* const> Targets)
+{
+	// The CPU backend stamps while tracking integrity, where the UV of the hit is already known
+	if (bUseCpuDamage)
+		return;
+
+	if (PositionMap != nullptr && (GetDamageRenderer() != nullptr || StampMaterialPool.Num() > 0))
 	{
-		UE_LOG(LogTemp, Error, TEXT("Error trying to unwrap to render target: Blastable Mesh not properly configured"));
+		StampInReferencePose(Stamps, Targets);
 		return;
 	}
 
-	if (!IsValid(UnwrapMaterialInstance) || !UnwrapMaterialInstance->IsValidLowLevel())
+	Core.UnwrapStamps(SceneCapture, UnwrapMaterialInstance, Targets, Stamps, GetOwner()->GetActorLocation());
+}
+
+void UBlastableComponent::StampInReferencePose(TArrayView<const FVector4> Stamps, TArrayView<UTextureRenderTarget2D* const> Targets)
+{
+	// Move every stamp into the space of every piece it reaches
+	TArray<FBlastableGpuStamp, TInlineAllocator<32>> LocalStamps;
+	for (auto const& Stamp : Stamps)
+	{
+		const FVector Location(Stamp);
+		for (int i = 0; i < BlastableMeshes.Num(); i++)
+		{
+			auto const Piece = BlastableMeshes[i];
+			if (!PieceIntegrity[i].Layout.IsValid() || Piece->Bounds.GetBox().ComputeSquaredDistanceToPoint(Location) > Stamp.W * Stamp.W)
+				continue;
+
+			const FTransform& PieceTransform = Piece->GetComponentTransform();
+			const float Scale = FMath::Max(PieceTransform.GetScale3D().GetAbsMax(), KINDA_SMALL_NUMBER);
+			LocalStamps.Add({ PieceIntegrity[i].Layout.UVBounds, PieceTransform.InverseTransformPosition(Location), Stamp.W / Scale, i });
+		}
+	}
+
+	// Let the world renderer draw them with the stamps of every other blastable this frame
+	if (auto const Renderer = GetDamageRenderer())
 	{
-		UE_LOG(LogTemp, Error, TEXT("Error trying to unwrap to render target: UnwrapMaterialInstance not properly set"));
+		for (auto const Target : Targets)
+			Renderer->AddStamps(Target, PositionMap, LocalStamps, Target == TimeDamageRenderTarget ? 1.f : ErosionPerHit);
 		return;
 	}
 
-	// Prevent mesh to show up in unwrapped texture during scene capture
-	auto const Mesh = GetMeshComponent();
-	if (Mesh != nullptr)
-		Mesh->SetVisibility(false);
+	// Draw stamps in passes of at most one stamp per pooled material instance
+	for (int32 First = 0; First < LocalStamps.Num(); First += StampMaterialPool.Num())
+	{
+		const int32 Count = FMath::Min(StampMaterialPool.Num(), LocalStamps.Num() - First);
+		for (int32 i = 0; i < Count; i++)
+		{
+			auto const& LocalStamp = LocalStamps[First + i];
+			StampMaterialPool[i]->SetVectorParameterValue(FName("HitLocalPosition"), LocalStamp.LocalPosition);
+			StampMaterialPool[i]->SetScalarParameterValue(FName("DamageRadius"), LocalStamp.Radius);
+			StampMaterialPool[i]->SetScalarParameterValue(FName("PieceId"), LocalStamp.Piece + 1);
+		}
+
+		for (auto const Target : Targets)
+		{
+			if (Target == nullptr)
+				continue;
+
+			FVector2D Size;
+			UCanvas* Canvas;
+			FDrawToRenderTargetContext Context;
+			UKismetRenderingLibrary::BeginDrawCanvasToRenderTarget(this, Target, Canvas, Size, Context);
+			for (int32 i = 0; i < Count; i++)
+			{
+				// Only the UV bounds of the piece can contain its texels
+				const FBox2D& UVBounds = LocalStamps[First + i].UVBounds;
+				Canvas->K2_DrawMaterial(StampMaterialPool[i], UVBounds.Min * Size, UVBounds.GetSize() * Size, UVBounds.Min, UVBounds.GetSize());
+			}
+			UKismetRenderingLibrary::EndDrawCanvasToRenderTarget(this, Context);
+		}
+	}
+}
+
+void UBlastableComponent::Blast(FVector Location, float ImpactRadius)
+{
+	FBlastRequest Request;
+	Request.Target = this;
+	Request.Location = Location;
+	Request.Radius = ImpactRadius;
+	BlastBatch(MakeArrayView(&Request, 1));
+}
+
+void UBlastableComponent::Blast(const FHitResult& Hit, float ImpactRadius, FName Weapon)
+{
+	UnwrapToRenderTarget(Hit.Location, ImpactRadius);
+	bDamageMirrorDirty = true;
 
-	// Store old material to restore it afterwards
-	TArray<TArray<UMaterialInterface*>> OldMaterialsPerMesh;
+	TrackIntegrity(Hit, ImpactRadius, Weapon);
+	RecordNetEvent(Hit.Location, ImpactRadius, Hit.GetComponent());
+}
+
+void UBlastableComponent::BlastBatch(TArrayView<const FBlastRequest> Requests)
+{
+	TArray<FVector4, TInlineAllocator<16>> Stamps;
+	for (auto const& Request : Requests)
+		Stamps.Add(FVector4(Request.Location, Request.Radius));
 
-	// Make sure that the scene capture is in the right position. Note that it might not be 
-	// properly placed when the actor is moving. We use global transformations to prevent 
-	// local transforms from messing the placing of the scene capture's camera. Also store
-	// previous rotation to restore it when we finish.
-	FRotator OldRotation = SceneCapture->GetComponentRotation();
-	FVector OldPosition = SceneCapture->GetComponentLocation();
-	SceneCapture->SetWorldRotation(FRotator(-90, -90, 0));
-	SceneCapture->SetWorldLocation(GetOwner()->GetActorLocation() + FVector{0,0,512});
+	UnwrapStampsToRenderTarget(Stamps);
+	bDamageMirrorDirty = true;
 
-	// Unwrap all blastable meshes:
-	for (auto const MeshComponent : BlastableMeshes)
+	for (auto const& Request : Requests)
 	{
-		// Sanity check
-		if (MeshComponent == nullptr)
+		if (Request.bHasHit)
+		{
+			TrackIntegrity(Request.Hit, Request.Radius, Request.Weapon);
+			RecordNetEvent(Request.Location, Request.Radius, Request.Hit.GetComponent());
 			continue;
+		}
 
-		// Original materials: Store it to restore it later
-		auto const& Materials = MeshComponent->GetMaterials();
-		TArray<UMaterialInterface*> OldMaterials(Materials);
-		OldMaterialsPerMesh.Add(OldMaterials);
+		FHitResult Hit;
+		const bool bFoundSurface = FindSurfaceHit(Request.Location, Hit);
+		if (bFoundSurface)
+			TrackIntegrity(Hit, Request.Radius, Request.Weapon);
 
-		// Update material in all armor pieces to unwrap material. Note that
-		// UVs for each piece should be aware of other pieces UVs so that 
-		// they don't overlap
-		for (size_t i = 0; i < Materials.Num(); i++)
-		{
-			MeshComponent->SetMaterial(i, UnwrapMaterialInstance);
+		RecordNetEvent(Request.Location, Request.Radius, bFoundSurface ? Hit.GetComponent() : nullptr);
+	}
+}
 
-			// Set the right material for every submaterial
-			UnwrapMaterialInstance->SetScalarParameterValue(TEXT("DamageRadius"), Radius);
-			UnwrapMaterialInstance->SetVectorParameterValue(TEXT("HitLocation"), HitLocation);
-		}
+void UBlastableComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(UBlastableComponent, NetEvents);
+	DOREPLIFETIME(UBlastableComponent, DamageEpoch);
+
+	// Clients already receiving this blastable keep up through events, the snapshot is only for newcomers
+	DOREPLIFETIME_CONDITION(UBlastableComponent, DamageSnapshot, COND_InitialOnly);
+}
+
+void UBlastableComponent::PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker)
+{
+	Super::PreReplication(ChangedPropertyTracker);
+
+	// Blasts over the budget go out with the following updates
+	NetEventsSinceUpdate = 0;
+	SendDeferredNetEvents();
+
+	// Encode lazily, at most once per network update no matter how many blasts happened
+	if (bDamageSnapshotDirty)
+	{
+		BlastableNet::EncodeCells(IntegrityGrid.GetCells(), DamageSnapshot);
+		bDamageSnapshotDirty = false;
 	}
+}
+
+bool UBlastableComponent::ShouldRecordNetEvents() const
+{
+	auto const Owner = GetOwner();
+	return Owner != nullptr && Owner->GetIsReplicated() && GetOwnerRole() == ROLE_Authority && GetNetMode() != NM_Standalone;
+}
 
-	// Capture Scene with just the unwrapped material and hit locations
-	
-	// Capture scene in the damage render target
-	SceneCapture->TextureTarget = DamageRenderTarget;
-	SceneCapture->CaptureScene();
-	
-	// Now repeat for the secondary render target, the image in this target will fade over time
-	SceneCapture->TextureTarget = TimeDamageRenderTarget;
-	SceneCapture->CaptureScene();
+void UBlastableComponent::RecordNetEvent(const FVector& Location, float ImpactRadius, const UPrimitiveComponent* Piece)
+{
+	if (!ShouldRecordNetEvents())
+		return;
 
-	// Restore old materials
-	for (int i = 0; i < BlastableMeshes.Num(); i++)
-		for (int j = 0; j < OldMaterialsPerMesh[i].Num(); j++)
-			BlastableMeshes[i]->SetMaterial(j, OldMaterialsPerMesh[i][j]);
+	bDamageSnapshotDirty = true;
 
-	// Restore main mesh visibility
-	if (Mesh != nullptr)
-		Mesh->SetVisibility(true);
+	// Positions relative to the piece land on the same spot of the armor no matter the pose of the target
+	const int32 PieceIndex = BlastableMeshes.IndexOfByKey(Piece);
+	const bool bHasPiece = BlastableMeshes.IsValidIndex(PieceIndex) && PieceIndex < FBlastableNetEvent::NoPiece;
+	const FTransform& Space = bHasPiece ? BlastableMeshes[PieceIndex]->GetComponentTransform() : GetOwner()->GetActorTransform();
 
-	// Restore scene capture visibility to leave everything as we found it. 
-	SceneCapture->SetWorldRotation(OldRotation);
-	SceneCapture->SetWorldLocation(OldPosition);
+	FBlastableNetEvent Event;
+	Event.Set(bHasPiece ? uint8(PieceIndex) : FBlastableNetEvent::NoPiece, Space.InverseTransformPosition(Location), ImpactRadius, GetServerTime());
+	Event.Epoch = DamageEpoch;
+
+	// Blasts over the budget wait for later updates, behind the ones already waiting
+	if (DeferredNetEvents.Num() > 0 || NetEventsSinceUpdate >= GetMaxNetEventsPerUpdate() || BlastableSubsystem == nullptr || !BlastableSubsystem->ConsumeNetEventBudget())
+		DeferNetEvent(Event);
+	else
+		AddNetEvent(Event);
 }
 
-void UBlastableComponent::Blast(FVector Location, float ImpactRadius)
+void UBlastableComponent::AddNetEvent(const FBlastableNetEvent& Event)
 {
-	UnwrapToRenderTarget(Location, ImpactRadius);
+	// Only the latest events are kept, so the cost of this blastable doesn't grow with its damage
+	if (NetEvents.Items.Num() >= MaxRecentNetEvents)
+	{
+		NetEvents.Items.RemoveAt(0);
+		NetEvents.MarkArrayDirty();
+	}
+	NetEvents.MarkItemDirty(NetEvents.Items.Add_GetRef(Event));
+	NetEventsSinceUpdate++;
 }
 
-void UBlastableComponent::CheckComponentConsistency() const
+void UBlastableComponent::DeferNetEvent(const FBlastableNetEvent& Event)
 {
-	auto Owner = GetOwner();
+	// Long bursts are merged into overlapping blasts instead of growing the backlog. Clients may see
+	// a bit more damage than the server, but never miss any.
+	if (DeferredNetEvents.Num() >= MaxRecentNetEvents)
+	{
+		for (int32 i = DeferredNetEvents.Num() - 1; i >= 0; i--)
+		{
+			if (DeferredNetEvents[i].Absorb(Event))
+				return;
+		}
+	}
+
+	DeferredNetEvents.Add(Event);
+}
+
+void UBlastableComponent::SendDeferredNetEvents()
+{
+	int32 Sent = 0;
+	while (Sent < DeferredNetEvents.Num() && NetEventsSinceUpdate < GetMaxNetEventsPerUpdate() && BlastableSubsystem != nullptr && BlastableSubsystem->ConsumeNetEventBudget())
+		AddNetEvent(DeferredNetEvents[Sent++]);
+
+	DeferredNetEvents.RemoveAt(0, Sent, false);
+}
+
+void UBlastableComponent::ApplyNetEvent(const FBlastableNetEvent& Event)
+{
+	// Events from before a reset this client already applied are gone on the server too
+	if (int8(Event.Epoch - AppliedDamageEpoch) < 0)
+		return;
+
+	// The epoch is replicated after the events of the same update, reset before stamping them
+	CatchUpDamageEpoch(Event.Epoch);
+
+	// Events can arrive with the first update of the owner, before the armor is set up
+	if (!HasBegunPlay())
+	{
+		PendingNetEvents.Add(Event);
+		return;
+	}
+
+	auto const Owner = GetOwner();
 	if (Owner == nullptr)
+		return;
+
+	const FTransform& Space = BlastableMeshes.IsValidIndex(Event.Piece) ? BlastableMeshes[Event.Piece]->GetComponentTransform() : Owner->GetActorTransform();
+	const FVector Location = Space.TransformPosition(Event.GetLocalPosition());
+	const FVector4 Stamp(Location, Event.GetRadius());
+
+	if (ConfirmPrediction(Event))
 	{
-		UE_LOG(LogTemp, Error, TEXT("Owner of BlastableComponent improperly configured"));
+		// This client already shows the blast, only confirmed damage is missing it
+		UTextureRenderTarget2D* const Targets[] = { ConfirmedDamageRenderTarget };
+		StampTargets(MakeArrayView(&Stamp, 1), Targets);
+	}
+	else
+	{
+		// Old events, like the ones a late joiner receives, would have already faded away
+		UnwrapStampsToRenderTarget(MakeArrayView(&Stamp, 1), Event.GetAge(GetServerTime()) < TimeToVanishDamage);
+		bDamageMirrorDirty = true;
+	}
+
+	FHitResult Hit;
+	if (FindSurfaceHit(Location, Hit))
+		TrackIntegrity(Hit, Event.GetRadius());
+}
+
+void UBlastableComponent::PredictBlast(const FHitResult& Hit, float ImpactRadius, uint16 ShotId)
+{
+	auto const World = GetWorld();
+	const int32 PieceIndex = BlastableMeshes.IndexOfByKey(Hit.GetComponent());
+	if (World == nullptr || !BlastableMeshes.IsValidIndex(PieceIndex) || bUseCpuDamage)
 		return;
+
+	// Keep damage the server agrees on apart, so mispredictions are undone with a copy
+	// instead of stamping every confirmed blast again
+	if (ConfirmedDamageRenderTarget == nullptr)
+	{
+		ConfirmedDamageRenderTarget = BlastableCore::CreateDamageRenderTarget(this, TEXT("ConfirmedDamageRenderTarget"), DamageRenderTarget->SizeX, false, DamageRenderTarget->bAutoGenerateMips);
+		SubmitQueuedDamage();
+		BlastableCore::CopyRenderTarget(this, DamageRenderTarget, ConfirmedDamageRenderTarget);
+		RefreshDamageMips(ConfirmedDamageRenderTarget);
 	}
 
-	auto CharacterOwner = Cast<ACharacter>(Owner);
-	if (CharacterOwner == nullptr)
+	// Too many shots waiting for the server, give up on the oldest one
+	if (PendingPredictions.Num() >= MaxPendingPredictions)
 	{
-		UE_LOG(LogTemp, Error, TEXT("Owner of BlastableComponent is not an instance of ACharacter"));
+		PendingPredictions.RemoveAt(0);
+		bPredictionRollbackPending = true;
 	}
+
+	FBlastablePrediction& Prediction = PendingPredictions.AddDefaulted_GetRef();
+	Prediction.Piece = PieceIndex;
+	Prediction.LocalPosition = BlastableMeshes[PieceIndex]->GetComponentTransform().InverseTransformPosition(Hit.Location);
+	Prediction.Radius = ImpactRadius;
+	Prediction.ShotId = ShotId;
+
+	// Mispredicted marks in the fading layer are never rolled back, they just fade away
+	const FVector4 Stamp(Hit.Location, ImpactRadius);
+	UTextureRenderTarget2D* const Targets[] = { DamageRenderTarget, TimeDamageRenderTarget };
+	StampTargets(MakeArrayView(&Stamp, 1), Targets);
+	bDamageMirrorDirty = true;
 }
 
-void UBlastableComponent::SetUpSceneRender2D()
+bool UBlastableComponent::ConfirmPrediction(const FBlastableNetEvent& Event)
 {
-	SceneCapture->CompositeMode = SCCM_Additive;
-	SceneCapture->bCaptureEveryFrame = false;
-	SceneCapture->bCaptureOnMovement = false;
-	SceneCapture->ShowOnlyActors.Add(SceneCapture->GetOwner());
-	SceneCapture->PrimitiveRenderMode = ESceneCapturePrimitiveRenderMode::PRM_UseShowOnlyList;
-	SceneCapture->SetRelativeLocation({ 0,0,512 });
-	SceneCapture->SetRelativeRotation(FRotator{ -90,-90,0 });
-	SceneCapture->ProjectionType = ECameraProjectionMode::Orthographic;
-	SceneCapture->OrthoWidth = 1024;
-	SceneCapture->ShowFlags.Atmosphere = 0;
-	SceneCapture->ShowFlags.AmbientCubemap = 0;
-	SceneCapture->ShowFlags.Lighting = 0;
-	SceneCapture->ShowFlags.PostProcessing = 0;
+	int32 Best = INDEX_NONE;
+	float BestDistanceSquared = FMath::Square(PredictionTolerance);
+	for (int32 i = 0; i < PendingPredictions.Num(); i++)
+	{
+		auto const& Prediction = PendingPredictions[i];
+		if (Prediction.Piece != Event.Piece)
+			continue;
+
+		// Compare in world units, pieces might be scaled
+		const FVector Scale = BlastableMeshes[Prediction.Piece]->GetComponentScale();
+		const float DistanceSquared = ((Prediction.LocalPosition - Event.GetLocalPosition()) * Scale).SizeSquared();
+		if (DistanceSquared <= BestDistanceSquared)
+		{
+			Best = i;
+			BestDistanceSquared = DistanceSquared;
+		}
+	}
+
+	if (Best == INDEX_NONE)
+		return false;
+
+	PendingPredictions.RemoveAt(Best);
+	return true;
 }
 
-void UBlastableComponent::SetUnwrapMaterial(UMaterial* Material)
+void UBlastableComponent::ResolvePredictions(uint16 FirstShotId, int32 NumShots, TArrayView<const FBlastableShotHit> Hits)
 {
-	if (IsValid(Material) && IsValid(this))
+	if (PendingPredictions.Num() == 0)
+		return;
+
+	const int32 NumRejected = PendingPredictions.RemoveAll([this, FirstShotId, NumShots, Hits](const FBlastablePrediction& Prediction)
 	{
-		UnwrapMaterialInstance = UMaterialInstanceDynamic::Create(Material, this, TEXT("UnwrapMaterialInstace"));
-		if (UnwrapMaterialInstance == nullptr || !IsValid(UnwrapMaterialInstance))
+		// Shot ids wrap around, count from the first resolved one
+		if (uint16(Prediction.ShotId - FirstShotId) >= NumShots)
+			return false;
+
+		// Shots that hit where they were predicted are confirmed later, by their replicated blast
+		const FVector Location = BlastableMeshes[Prediction.Piece]->GetComponentTransform().TransformPosition(Prediction.LocalPosition);
+		return !Hits.ContainsByPredicate([this, &Prediction, &Location](const FBlastableShotHit& Hit)
 		{
-			UE_LOG(LogTemp, Error, TEXT("Could not set up material instance for unwrap material"));
+			return Hit.ShotId == Prediction.ShotId && Hit.Blastable == this && FVector::DistSquared(Hit.Location, Location) <= FMath::Square(PredictionTolerance);
+		});
+	});
+
+	if (NumRejected > 0)
+		bPredictionRollbackPending = true;
+}
+
+void UBlastableComponent::RollBackPredictions()
+{
+	bPredictionRollbackPending = false;
+	if (ConfirmedDamageRenderTarget == nullptr)
+		return;
+
+	// Stamps queued before the copy must not land on top of it
+	SubmitQueuedDamage();
+	BlastableCore::CopyRenderTarget(this, ConfirmedDamageRenderTarget, DamageRenderTarget);
+	RefreshDamageMips(DamageRenderTarget);
+
+	TArray<FVector4, TInlineAllocator<32>> Stamps;
+	for (auto const& Prediction : PendingPredictions)
+	{
+		const FVector Location = BlastableMeshes[Prediction.Piece]->GetComponentTransform().TransformPosition(Prediction.LocalPosition);
+		Stamps.Add(FVector4(Location, Prediction.Radius));
+	}
+
+	UTextureRenderTarget2D* const Targets[] = { DamageRenderTarget };
+	StampTargets(Stamps, Targets);
+	bDamageMirrorDirty = true;
+}
+
+float UBlastableComponent::GetServerTime() const
+{
+	auto const World = GetWorld();
+	if (World == nullptr)
+		return 0.f;
+
+	auto const GameState = World->GetGameState();
+	return GameState != nullptr ? GameState->GetServerWorldTimeSeconds() : World->GetTimeSeconds();
+}
+
+void UBlastableComponent::OnRep_DamageSnapshot()
+{
+	if (HasBegunPlay())
+		ApplyDamageSnapshot();
+	else
+		bDamageSnapshotPending = true;
+}
+
+void UBlastableComponent::ApplyDamageSnapshot()
+{
+	bDamageSnapshotPending = false;
+
+	const int32 Resolution = IntegrityGrid.GetResolution();
+	TArray<uint8> Cells;
+	if (DamageSnapshot.Num() == 0 || !BlastableNet::DecodeCells(DamageSnapshot, Resolution * Resolution, Cells))
+		return;
+
+	// Integrity estimate, firing thresholds the server already crossed
+	MergeIntegrityCells(Cells);
+
+	// Without render targets the integrity grid is all the damage map there is. The snapshot is
+	// coarse, but it's only drawn once per client.
+	if (!bUseCpuDamage)
+		DrawDamageTexels(Cells, Resolution);
+}
+
+void UBlastableComponent::MergeIntegrityCells(const TArray<uint8>& Cells)
+{
+	IntegrityGrid.MergeCells(Cells);
+	for (int i = 0; i < PieceIntegrity.Num(); i++)
+	{
+		FBlastablePieceIntegrity& Integrity = PieceIntegrity[i];
+		if (!Integrity.Layout.IsValid())
+			continue;
+
+		const float DestroyedCells = IntegrityGrid.GetBreachedCells(Integrity.Layout.Mask);
+		Integrity.DestroyedCells = FMath::Max(Integrity.DestroyedCells, DestroyedCells);
+		BroadcastCrossedThresholds(i);
+	}
+}
+
+void UBlastableComponent::DrawDamageTexels(const TArray<uint8>& Texels, int32 Resolution)
+{
+	if (SnapshotTexture == nullptr || SnapshotTexture->GetSizeX() != Resolution)
+	{
+		SnapshotTexture = UTexture2D::CreateTransient(Resolution, Resolution, PF_G8);
+		if (SnapshotTexture == nullptr)
 			return;
+
+		SnapshotTexture->SRGB = false;
+		SnapshotTexture->AddressX = TA_Clamp;
+		SnapshotTexture->AddressY = TA_Clamp;
+	}
+
+	auto& Mip = SnapshotTexture->PlatformData->Mips[0];
+	FMemory::Memcpy(Mip.BulkData.Lock(LOCK_READ_WRITE), Texels.GetData(), Texels.Num());
+	Mip.BulkData.Unlock();
+	SnapshotTexture->UpdateResource();
+
+	for (auto const Target : { DamageRenderTarget, ConfirmedDamageRenderTarget })
+	{
+		if (Target == nullptr)
+			continue;
+
+		FVector2D Size;
+		UCanvas* Canvas;
+		FDrawToRenderTargetContext Context;
+		UKismetRenderingLibrary::BeginDrawCanvasToRenderTarget(this, Target, Canvas, Size, Context);
+		Canvas->K2_DrawTexture(SnapshotTexture, FVector2D::ZeroVector, Size, FVector2D::ZeroVector, FVector2D::UnitVector, FLinearColor::White, BLEND_Additive);
+		UKismetRenderingLibrary::EndDrawCanvasToRenderTarget(this, Context);
+		RefreshDamageMips(Target);
+	}
+	bDamageMirrorDirty = true;
+}
+
+bool UBlastableComponent::CaptureDamageRecord(FBlastableDamageRecord& OutRecord) const
+{
+	const int32 GridResolution = IntegrityGrid.GetResolution();
+	if (GridResolution == 0 || !IntegrityGrid.GetCells().ContainsByPredicate([](uint8 Cell) { return Cell != 0; }))
+		return false;
+
+	OutRecord.Version = FBlastableDamageRecord::CurrentVersion;
+	OutRecord.GridResolution = GridResolution;
+	BlastableNet::EncodeCells(IntegrityGrid.GetCells(), OutRecord.Cells);
+
+	// The copy of the damage map lags a few frames behind the GPU, stamps it missed are still
+	// part of the integrity grid
+	TArray<uint8> Texels;
+	OutRecord.MapResolution = 0;
+	if (bUseCpuDamage)
+	{
+		CpuDamage.Export(Texels);
+		OutRecord.MapResolution = CpuDamage.GetResolution();
+	}
+	else if (DamageMirror.HasData())
+	{
+		Texels = DamageMirror.GetTexels();
+		OutRecord.MapResolution = DamageMirror.GetResolution();
+	}
+	BlastableNet::EncodeCells(Texels, OutRecord.Map);
+	return true;
+}
+
+bool UBlastableComponent::RestoreDamageRecord(const FBlastableDamageRecord& Record)
+{
+	if (!Record.IsValid())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Ignoring damage record version %d of %s"), Record.Version, *GetPersistentId());
+		return false;
+	}
+
+	// Records from a grid of a different resolution only restore the damage map
+	const int32 GridResolution = IntegrityGrid.GetResolution();
+	TArray<uint8> Cells;
+	if (Record.GridResolution == GridResolution && BlastableNet::DecodeCells(Record.Cells, GridResolution * GridResolution, Cells))
+		MergeIntegrityCells(Cells);
+
+	TArray<uint8> Texels;
+	if (Record.MapResolution > 0 && BlastableNet::DecodeCells(Record.Map, Record.MapResolution * Record.MapResolution, Texels))
+	{
+		if (!bUseCpuDamage)
+		{
+			DrawDamageTexels(Texels, Record.MapResolution);
+		}
+		else
+		{
+			CpuDamage.Import(Texels, Record.MapResolution);
+			if (BlastableSubsystem != nullptr)
+				BlastableSubsystem->MarkCpuDamageDirty(this);
 		}
 	}
 
-	UE_LOG(LogTemp, Warning, TEXT("Could not set up UnwrapMaterial since the specified material is not valid"));
+	// Clients that start receiving this blastable get the restored damage through the snapshot
+	if (ShouldRecordNetEvents())
+		bDamageSnapshotDirty = true;
+	return true;
+}
+
+FString UBlastableComponent::GetPersistentId() const
+{
+	return PersistentId.IsEmpty() ? GetPathName() : PersistentId;
+}
+
+void UBlastableComponent::OnRep_DamageEpoch()
+{
+	CatchUpDamageEpoch(DamageEpoch);
+}
+
+void UBlastableComponent::CatchUpDamageEpoch(uint8 Epoch)
+{
+	if (Epoch == AppliedDamageEpoch)
+		return;
+	AppliedDamageEpoch = Epoch;
+
+	// Damage received before BeginPlay is only pending, and belongs to the epoch the server is in
+	if (HasBegunPlay())
+		ResetDamage();
 }
 
-void UBlastableComponent::SetFadingMaterial(UMaterial* Material)
+void UBlastableComponent::SubmitBlast(const FVector& Location, float ImpactRadius)
 {
-	if (IsValid(Material) && IsValid(this))
+	if (BlastableSubsystem != nullptr)
+		BlastableSubsystem->SubmitBlast(this, Location, ImpactRadius);
+}
+
+void UBlastableComponent::SubmitBlast(const FHitResult& Hit, float ImpactRadius, FName Weapon)
+{
+	if (BlastableSubsystem != nullptr)
+		BlastableSubsystem->SubmitBlast(this, Hit, ImpactRadius, Weapon);
+}
+
+void UBlastableComponent::ResetDamage()
+{
+	ForgetQueuedDamage();
+
+	// A clear is a single GPU pass, and keeps the targets bound to the armor materials. It only
+	// clears the first mip, the others would keep the old damage showing from afar.
+	for (auto const Target : { DamageRenderTarget, TimeDamageRenderTarget, ConfirmedDamageRenderTarget })
 	{
-		UnwrapFadingMaterialInstance = UMaterialInstanceDynamic::Create(Material, this, TEXT("FadingMaterialInstace"));
-		UnwrapFadingMaterialInstance->SetTextureParameterValue(FName("RT_FadingTexture"), TimeDamageRenderTarget);
-		if (UnwrapFadingMaterialInstance == nullptr)
+		if (Target == nullptr)
+			continue;
+
+		UKismetRenderingLibrary::ClearRenderTarget2D(this, Target, FLinearColor::Black);
+		RefreshDamageMips(Target);
+	}
+
+	PendingPredictions.Reset();
+	bPredictionRollbackPending = false;
+
+	DamageMirror.Reset();
+	bDamageMirrorDirty = false;
+	CpuDamage.Reset();
+
+	IntegrityGrid.Reset();
+	for (auto& Integrity : PieceIntegrity)
+	{
+		Integrity.DestroyedCells = 0.f;
+		Integrity.NextThreshold = 0;
+	}
+
+	// Let clients know, events from before the reset must not be applied anymore
+	if (ShouldRecordNetEvents())
+	{
+		DamageEpoch++;
+		DeferredNetEvents.Reset();
+		NetEvents.Items.Reset();
+		NetEvents.MarkArrayDirty();
+		DamageSnapshot.Reset();
+		bDamageSnapshotDirty = false;
+	}
+}
+
+void UBlastableComponent::SetBlastableActive(bool bActive)
+{
+	SetComponentTickEnabled(bActive);
+
+	auto World = GetWorld();
+	if (World != nullptr)
+	{
+		if (bActive)
+			World->GetTimerManager().UnPauseTimer(DamageFadingTimerHandle);
+		else
+			World->GetTimerManager().PauseTimer(DamageFadingTimerHandle);
+	}
+
+	// Parked blastables should not be hit by radial blasts
+	if (BlastableSubsystem != nullptr)
+	{
+		if (bActive)
+			BlastableSubsystem->RegisterBlastable(this, ComputeBoundsRadius());
+		else
+			BlastableSubsystem->UnregisterBlastable(this);
+	}
+}
+
+float UBlastableComponent::GetPieceDestroyedFraction(UStaticMeshComponent* Piece) const
+{
+	const int32 PieceIndex = BlastableMeshes.IndexOfByKey(Piece);
+	return PieceIntegrity.IsValidIndex(PieceIndex) ? PieceIntegrity[PieceIndex].GetDestroyedFraction() : 0.f;
+}
+
+bool UBlastableComponent::IsHoleAt(const FHitResult& Hit) const
+{
+	FVector2D UV;
+	if (!UGameplayStatics::FindCollisionUV(Hit, 0, UV))
+		return false;
+
+	// The occupancy grid knows about hits as soon as they happen, while the mirror lags a few 
+	// frames but also knows about damage that did not go through `Blast`. Only the breach layer
+	// opens holes, eroded paint, primer and metal still stop traces.
+	const float Damage = FMath::Max(IntegrityGrid.Sample(UV), SampleDamageUV(UV));
+	return BlastableErosion::GetBreach(Damage) >= HoleDamageThreshold;
+}
+
+void UBlastableComponent::UploadCpuDamage()
+{
+	// Without textures there is nothing to upload, dirty regions are just dropped
+	CpuDamage.UploadDirtyRegions(CpuDamageTexture, CpuFadingDamageTexture);
+}
+
+float UBlastableComponent::SampleDamageUV(const FVector2D& UV) const
+{
+	return bUseCpuDamage ? CpuDamage.Sample(UV) : DamageMirror.Sample(UV);
+}
+
+bool UBlastableComponent::HasDamageData() const
+{
+	return bUseCpuDamage ? CpuDamage.GetResolution() > 0 : DamageMirror.HasData();
+}
+
+bool UBlastableComponent::FindSurfaceHit(const FVector& Location, FHitResult& OutHit, float ProbeDistance) const
+{
+	auto const Owner = GetOwner();
+	if (Owner == nullptr)
+		return false;
+
+	// Probe along the direction from the owner to the location, armor is always wrapped around its owner
+	FVector Direction = Location - Owner->GetActorLocation();
+	if (!Direction.Normalize())
+		return false;
+
+	const FVector Start = Location + Direction * ProbeDistance;
+	const FVector End = Location - Direction * ProbeDistance;
+
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(BlastableSurfaceHit), true);
+	QueryParams.bReturnFaceIndex = true;
+
+	// Only pieces whose bounds the probe reaches are traced, usually one or two
+	bool bFound = false;
+	for (auto const Mesh : BlastableMeshes)
+	{
+		if (Mesh == nullptr || Mesh->Bounds.GetBox().ComputeSquaredDistanceToPoint(Location) > ProbeDistance * ProbeDistance)
+			continue;
+
+		FHitResult Hit;
+		if (Mesh->LineTraceComponent(Hit, Start, End, QueryParams) && (!bFound || Hit.Distance < OutHit.Distance))
 		{
-			UE_LOG(LogTemp, Warning, TEXT("Could not set up material instance for fading material"));
-			return;
+			OutHit = Hit;
+			bFound = true;
 		}
 	}
+
+	return bFound;
 }
 
-TArray<UStaticMeshComponent *> UBlastableComponent::GetBlastableMeshSet() const
+void UBlastableComponent::TrackIntegrity(const FHitResult& Hit, float ImpactRadius, FName Weapon)
 {
-	AActor* Owner = GetOwner();
-	if (Owner != nullptr)
+	const int32 PieceIndex = BlastableMeshes.IndexOfByKey(Cast<UStaticMeshComponent>(Hit.GetComponent()));
+	if (!PieceIntegrity.IsValidIndex(PieceIndex) || !PieceIntegrity[PieceIndex].Layout.IsValid())
+		return;
+
+	FVector2D UV;
+	if (!UGameplayStatics::FindCollisionUV(Hit, 0, UV))
+		return;
+
+	// Stamp only inside this piece footprint, the cost is proportional to the stamp area 
+	// and independent of the damage map resolution.
+	FBlastablePieceIntegrity& Integrity = PieceIntegrity[PieceIndex];
+	Integrity.DestroyedCells += IntegrityGrid.Stamp(UV, ImpactRadius * Integrity.Layout.UVPerCm, &Integrity.Layout.Mask, ErosionPerHit);
+
+	// Only the server knows the weapon of every hit, replicated blasts arrive without one
+	auto& Telemetry = FBlastableTelemetry::Get();
+	if (Telemetry.IsRecording() && GetOwnerRole() == ROLE_Authority)
+		Telemetry.RecordHit(GetOwner()->GetClass()->GetFName(), PieceIndex, UV, ImpactRadius * Integrity.Layout.UVPerCm, Weapon);
+
+	// Splatted later, together with the stamps of every other blastable
+	if (bUseCpuDamage)
 	{
-		
-		auto ActorComponents = GetOwner()->GetComponentsByTag(UStaticMeshComponent::StaticClass(), FName("BlastableMesh"));
-		TArray<UStaticMeshComponent*> Meshes;
-		Meshes.Init(nullptr, ActorComponents.Num());
-		for (int i = 0; i < ActorComponents.Num(); i++)
-			Meshes[i] = (Cast<UStaticMeshComponent>(ActorComponents[i]));
+		CpuDamage.QueueStamp(PieceIndex, UV, ImpactRadius * Integrity.Layout.UVPerCm, ErosionPerHit);
+		if (BlastableSubsystem != nullptr)
+			BlastableSubsystem->MarkCpuDamageDirty(this);
+	}
+
+	BroadcastCrossedThresholds(PieceIndex);
+}
+
+void UBlastableComponent::BroadcastCrossedThresholds(int32 PieceIndex)
+{
+	FBlastablePieceIntegrity& Integrity = PieceIntegrity[PieceIndex];
+	const float DestroyedFraction = Integrity.GetDestroyedFraction();
+	while (IntegrityThresholds.IsValidIndex(Integrity.NextThreshold) && DestroyedFraction >= IntegrityThresholds[Integrity.NextThreshold])
+	{
+		const float Threshold = IntegrityThresholds[Integrity.NextThreshold++];
+		OnArmorIntegrityThresholdCrossed.Broadcast(BlastableMeshes[PieceIndex], DestroyedFraction, Threshold);
+	}
+}
+
+float UBlastableComponent::SampleDamageAtLocation(FVector Location) const
+{
+	float Damage = 0.f;
+	GetDamageQuery().SampleWorldLocation(Location, Damage);
+	return Damage;
+}
 
-		return Meshes;
+void UBlastableComponent::CheckComponentConsistency() const
+{
+	auto Owner = GetOwner();
+	if (Owner == nullptr)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Owner of BlastableComponent improperly configured"));
+		return;
 	}
 
-	UE_LOG(LogTemp, Warning, TEXT("Could not retrieve Mesh Components. Owner is NULL."));
-	return TArray<UStaticMeshComponent*>();
+	// Owners without a skeletal body, like props made only of armor, are fine. The body is only 
+	// hidden during captures when there is one.
+	if (Core.MeshSource.Body == nullptr)
+	{
+		UE_LOG(LogTemp, Log, TEXT("Owner of BlastableComponent has no skeletal mesh, only its armor will be captured"));
+	}
 }
 
 void UBlastableComponent::UpdateFadingDamageRenderTarget()
 {
-	// Store what we draw 
-	FVector2D Size;
-	UCanvas* Canvas;
-	FDrawToRenderTargetContext Context;
+	// Fade linearly, so marks are gone after `TimeToVanishDamage`
+	auto const World = GetWorld();
+	const float FadeAmount = World != nullptr && TimeToVanishDamage > 0.f ? World->GetTimerManager().GetTimerRate(DamageFadingTimerHandle) / TimeToVanishDamage : 0.f;
 
-	// Begin a Draw Canvas To Render Target to render the material that fades the render target. 
-	// This material should just sample from the TimeDamageRenderTarget and write back the same color but dimmer. 
-	UKismetRenderingLibrary::BeginDrawCanvasToRenderTarget(this, TimeDamageRenderTarget, Canvas, Size, Context);
+	if (bUseCpuDamage)
 	{
-		Canvas->K2_DrawMaterial(UnwrapFadingMaterialInstance, FVector2D::ZeroVector, Size, FVector2D::ZeroVector);
+		CpuDamage.Fade(FadeAmount);
+		return;
+	}
+
+	if (auto const Renderer = GetDamageRenderer())
+	{
+		Renderer->AddFade(TimeDamageRenderTarget, FadeAmount);
+		return;
+	}
+
+	BlastableCore::FadeRenderTarget(this, TimeDamageRenderTarget, UnwrapFadingMaterialInstance);
+}
+
+void UBlastableComponent::ApplyScalability()
+{
+	auto const World = GetWorld();
+	if (World == nullptr || !HasBegunPlay())
+		return;
+
+	// Fading takes as long as before, in steps of a different size. Parked blastables stay paused.
+	auto& TimerManager = World->GetTimerManager();
+	const float FadeInterval = BlastableScalability::GetFadeInterval();
+	if (TimerManager.TimerExists(DamageFadingTimerHandle) && TimerManager.GetTimerRate(DamageFadingTimerHandle) != FadeInterval)
+	{
+		const bool bPaused = TimerManager.IsTimerPaused(DamageFadingTimerHandle);
+		TimerManager.SetTimer(DamageFadingTimerHandle, this, &UBlastableComponent::UpdateFadingDamageRenderTarget, FadeInterval, true);
+		if (bPaused)
+			TimerManager.PauseTimer(DamageFadingTimerHandle);
+	}
+
+	// The CPU backend has its own resolution, set per class
+	const int32 Size = BlastableScalability::GetDamageResolution(DamageRenderTargetSize);
+	if (bUseCpuDamage || DamageRenderTarget == nullptr || DamageRenderTarget->SizeX == Size)
+		return;
+
+	// Damage queued for the old targets must be in them before they are copied
+	SubmitQueuedDamage();
+	DamageRenderTarget = ResizeDamageTarget(this, DamageRenderTarget, Size);
+	TimeDamageRenderTarget = ResizeDamageTarget(this, TimeDamageRenderTarget, Size);
+	ConfirmedDamageRenderTarget = ResizeDamageTarget(this, ConfirmedDamageRenderTarget, Size);
+	for (auto const Target : { DamageRenderTarget, TimeDamageRenderTarget, ConfirmedDamageRenderTarget })
+		RefreshDamageMips(Target);
+
+	// Point everything sampling the old targets to the new ones
+	for (auto const Mesh : ArmorRenderMeshes)
+	{
+		for (int32 Section = 0; Mesh != nullptr && Section < Mesh->GetNumMaterials(); Section++)
+		{
+			if (auto const DynamicMaterial = Cast<UMaterialInstanceDynamic>(Mesh->GetMaterial(Section)))
+			{
+				DynamicMaterial->SetTextureParameterValue(FName("RT_UnwrapDamage"), DamageRenderTarget);
+				DynamicMaterial->SetTextureParameterValue(FName("RT_FadingDamage"), TimeDamageRenderTarget);
+			}
+		}
+	}
+	if (UnwrapFadingMaterialInstance != nullptr)
+		UnwrapFadingMaterialInstance->SetTextureParameterValue(FName("RT_FadingTexture"), TimeDamageRenderTarget);
+
+	bDamageMirrorDirty = true;
+}
+
+FBlastableDamageRenderer* UBlastableComponent::GetDamageRenderer() const
+{
+	return BlastableSubsystem != nullptr ? BlastableSubsystem->GetDamageRenderer() : nullptr;
+}
+
+void UBlastableComponent::WarmUpRendering(UBlastablePreloadSubsystem& Preload)
+{
+	// The CPU backend draws nothing, its first upload is what would hitch. Uploading the whole
+	// undamaged map goes through the same texture updates as the damage of a real hit.
+	if (bUseCpuDamage)
+	{
+		CpuDamage.Invalidate();
+		UploadCpuDamage();
+		return;
+	}
+
+	auto const Piece = BlastableMeshes.Num() > 0 ? BlastableMeshes[0] : nullptr;
+	if (Piece == nullptr)
+		return;
+
+	// A stamp without radius on the armor goes through every shader of a real one and adds nothing.
+	// Scratch targets have the formats of the damage targets, pipeline states depend on them.
+	UTextureRenderTarget2D* const Targets[] = { Preload.GetScratchTarget(false), Preload.GetScratchTarget(true) };
+	const FVector4 Stamp(Piece->Bounds.Origin, 0.f);
+	StampTargets(MakeArrayView(&Stamp, 1), Targets);
+
+	// Empty fades are skipped, a tiny one on a scratch target is just as good
+	if (auto const Renderer = GetDamageRenderer())
+	{
+		Renderer->AddFade(Targets[1], KINDA_SMALL_NUMBER);
+		Renderer->Submit();
+	}
+	else
+	{
+		BlastableCore::FadeRenderTarget(this, Targets[1], UnwrapFadingMaterialInstance);
 	}
-	UKismetRenderingLibrary::EndDrawCanvasToRenderTarget(this, Context);
+}
+
+void UBlastableComponent::SubmitQueuedDamage()
+{
+	if (auto const Renderer = GetDamageRenderer())
+		Renderer->Submit();
+}
+
+void UBlastableComponent::ForgetQueuedDamage()
+{
+	if (auto const Renderer = GetDamageRenderer())
+	{
+		Renderer->RemoveTarget(DamageRenderTarget);
+		Renderer->RemoveTarget(TimeDamageRenderTarget);
+		Renderer->RemoveTarget(ConfirmedDamageRenderTarget);
+	}
+}
+
+void UBlastableComponent::RefreshDamageMips(UTextureRenderTarget2D* Target)
+{
+	// Copies and canvas draws only write the first mip
+	if (auto const Renderer = GetDamageRenderer())
+		Renderer->AddFullMipRefresh(Target);
 }
 
 USkeletalMeshComponent* UBlastableComponent::GetMeshComponent() const
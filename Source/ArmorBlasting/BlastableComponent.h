@@ -7,11 +7,72 @@
 #include "TimerManager.h"
 #include "Components/SceneCaptureComponent.h"
 #include "Engine/CanvasRenderTarget2D.h"
+#include "BlastableDamageQuery.h"
+#include "BlastableDamageGrid.h"
+#include "BlastableUVLayout.h"
+#include "BlastableTypes.h"
+#include "BlastableCore.h"
+#include "BlastableNet.h"
+#include "BlastableCpuDamage.h"
+#include "BlastablePersistence.h"
+#include "BlastableDamageRenderer.h"
 #include "BlastableComponent.generated.h"
 
 class USceneCaptureComponent2D;
 class UCanvasRenderTarget2D;
 class UCanvas;
+class UBlastableSubsystem;
+class UMeshComponent;
+class UTexture2D;
+class UMaterialInterface;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FOnArmorIntegrityThresholdCrossed, UStaticMeshComponent*, Piece, float, DestroyedFraction, float, Threshold);
+
+/** Running estimate of how much of a blastable piece has been destroyed */
+struct FBlastablePieceIntegrity
+{
+	/** UV footprint and surface of the piece */
+	FBlastablePieceLayout Layout;
+
+	/** Breached area of the piece, measured in damage grid cells. Eroded paint and primer don't count. */
+	float DestroyedCells = 0.f;
+
+	/** Index of the next threshold in `IntegrityThresholds` this piece has not crossed yet */
+	int32 NextThreshold = 0;
+
+	/** Fraction of the piece surface destroyed so far, in [0, 1] */
+	float GetDestroyedFraction() const { return Layout.MaskCellCount > 0 ? FMath::Min(DestroyedCells / Layout.MaskCellCount, 1.f) : 0.f; }
+};
+
+/** Where a blastable keeps its damage */
+UENUM(BlueprintType)
+enum class EBlastableDamageBackend : uint8
+{
+	/** Render targets when this machine can render, system memory otherwise */
+	Auto,
+
+	/** Render targets drawn with scene captures and canvas draws */
+	Gpu,
+
+	/** Masks in system memory. Machines that render upload the regions stamps touch into textures. */
+	Cpu,
+};
+
+/** Blast predicted by this client, waiting for the server to confirm it */
+struct FBlastablePrediction
+{
+	/** Index of the piece that was hit in the blastable meshes */
+	int32 Piece = INDEX_NONE;
+
+	/** Hit location in the space of the piece */
+	FVector LocalPosition = FVector::ZeroVector;
+
+	/** Size of the area of effect */
+	float Radius = 0.f;
+
+	/** Id of the shot that was predicted, the server tells whether it agrees by this id */
+	uint16 ShotId = 0;
+};
 
 UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
 class ARMORBLASTING_API UBlastableComponent : public USceneComponent
@@ -23,13 +84,52 @@ public:
 	UBlastableComponent();
 
 protected:
+	virtual void PostInitProperties() override;
+
+	// Called when the component is registered, before the game starts
+	virtual void OnRegister() override;
+
 	// Called when the game starts
 	virtual void BeginPlay() override;
 
+	// Called when the game ends or the owner is destroyed
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 public:	
 	// Called every frame
 	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
 
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	// Called on the server before sending an update to clients
+	virtual void PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker) override;
+
+	/// <summary>
+	/// Stamp a blast replicated from the server. Events arriving before BeginPlay are applied once
+	/// the armor is set up. Events of a newer damage epoch reset damage first.
+	/// </summary>
+	/// <param name="Event"> Quantized blast, relative to the piece it hit </param>
+	void ApplyNetEvent(const FBlastableNetEvent& Event);
+
+	/// <summary>
+	/// Stamp the damage a shot fired on this client is expected to do, without waiting for the
+	/// server. Blasts replicated later confirm the prediction, and predictions the server rejects
+	/// are rolled back.
+	/// </summary>
+	/// <param name="Hit">Trace result of the local shot against one of the blastable meshes</param>
+	/// <param name="ImpactRadius">Size of the area of effect around the hit location</param>
+	/// <param name="ShotId">Id of the shot, as sent to the server</param>
+	void PredictBlast(const FHitResult& Hit, float ImpactRadius, uint16 ShotId);
+
+	/// <summary>
+	/// Roll back predictions of shots the server resolved without hitting this blastable where they
+	/// were predicted. The rest wait for their replicated blasts to confirm them.
+	/// </summary>
+	/// <param name="FirstShotId">Id of the first shot the server resolved</param>
+	/// <param name="NumShots">Amount of consecutive shot ids resolved</param>
+	/// <param name="Hits">Armor the resolved shots hit on the server</param>
+	void ResolvePredictions(uint16 FirstShotId, int32 NumShots, TArrayView<const FBlastableShotHit> Hits);
+
 	/**  
 	* @param HitLocation Where the object was hit in world space
 	* @param Radius Size of area of efect around `HitLocation`
@@ -38,11 +138,88 @@ public:
 	void UnwrapToRenderTarget(FVector HitLocation = FVector::ZeroVector, float Radius = 0);
 
 	/// <summary>
-	/// Try to blast this object's surface at the specified location
+	/// Try to blast this object's surface at the specified location. The surface is found with a probe
+	/// against the pieces near it, prefer the overload taking the hit when the caller already traced.
 	/// </summary>
 	/// <param name="Location">Location in world space where this object was hit</param>
 	void Blast(FVector Location, float ImpactRadius);
 
+	/// <summary>
+	/// Blast this object's surface where a trace hit it. Prefer this over the location version when a 
+	/// hit result is available, since it does not need to search for the piece that was hit.
+	/// </summary>
+	/// <param name="Hit">Trace result against one of the blastable meshes</param>
+	/// <param name="ImpactRadius">Size of the area of effect around the hit location</param>
+	/// <param name="Weapon">Weapon that fired the blast, only used by telemetry</param>
+	void Blast(const FHitResult& Hit, float ImpactRadius, FName Weapon = NAME_None);
+
+	/// <summary>
+	/// Apply many blasts at once. Armor materials are swapped only once for the whole batch.
+	/// </summary>
+	/// <param name="Requests">Blasts to apply, all of them targeting this component</param>
+	void BlastBatch(TArrayView<const FBlastRequest> Requests);
+
+	/// <summary>
+	/// Queue a blast at the specified location. Unlike `Blast`, this is safe to call from any thread, 
+	/// the blast is applied on the game thread during the next frame.
+	/// </summary>
+	/// <param name="Location">Location in world space where this object was hit</param>
+	/// <param name="ImpactRadius">Size of the area of effect around `Location`</param>
+	void SubmitBlast(const FVector& Location, float ImpactRadius);
+
+	/// <summary>
+	/// Queue a blast where a trace hit this object. Safe to call from any thread.
+	/// </summary>
+	/// <param name="Hit">Trace result against one of the blastable meshes</param>
+	/// <param name="ImpactRadius">Size of the area of effect around the hit location</param>
+	/// <param name="Weapon">Weapon that fired the blast, only used by telemetry</param>
+	void SubmitBlast(const FHitResult& Hit, float ImpactRadius, FName Weapon = NAME_None);
+
+	/// <summary>
+	/// Clear all damage dealt to this blastable. Render targets and material instances are kept, 
+	/// so this is cheap enough to call when reusing a pooled actor.
+	/// </summary>
+	UFUNCTION(BlueprintCallable, Category = "ArmorBlasting")
+	void ResetDamage();
+
+	/// <summary>
+	/// Pause or resume all the periodic work of this blastable, used by actor pools to park blastables 
+	/// that are not in use.
+	/// </summary>
+	/// <param name="bActive">Whether the blastable is in use</param>
+	void SetBlastableActive(bool bActive);
+
+	/// <summary>
+	/// Get the fraction of a blastable piece surface destroyed so far. This is an estimate 
+	/// kept on the CPU, it does not read back the damage map.
+	/// </summary>
+	/// <param name="Piece">One of the meshes tagged as 'BlastableMesh'</param>
+	/// <returns>Destroyed fraction in [0, 1], 0 if `Piece` is not blastable</returns>
+	UFUNCTION(BlueprintCallable, Category = "ArmorBlasting")
+	float GetPieceDestroyedFraction(UStaticMeshComponent* Piece) const;
+
+	/// <summary>
+	/// Check if a trace hit armor that was already blasted open. Uses the CPU side occupancy grid and 
+	/// damage mirror, so it is cheap enough to call for every pellet of a shotgun shot. Game thread
+	/// only, both are written by blasts.
+	/// </summary>
+	/// <param name="Hit">Trace result against one of the blastable meshes</param>
+	/// <returns>True if the hit landed on a hole, false if it landed on armor or could not be mapped to UVs</returns>
+	bool IsHoleAt(const FHitResult& Hit) const;
+
+	/// <summary>
+	/// Find the armor surface close to a world location using short traces against the blastable meshes
+	/// </summary>
+	/// <param name="Location">Point in world space near the armor surface</param>
+	/// <param name="OutHit">Hit against the closest blastable mesh</param>
+	/// <param name="ProbeDistance">How far from `Location` to look for the surface</param>
+	/// <returns>True if some armor surface was found</returns>
+	bool FindSurfaceHit(const FVector& Location, FHitResult& OutHit, float ProbeDistance = 10.f) const;
+
+	/** Called when a blastable piece gets more destroyed than one of the `IntegrityThresholds` */
+	UPROPERTY(BlueprintAssignable, Category = "ArmorBlasting")
+	FOnArmorIntegrityThresholdCrossed OnArmorIntegrityThresholdCrossed;
+
 	/** Get render target used to store damage for this blastable */
 	UFUNCTION(BlueprintCallable)
 	UTextureRenderTarget2D* GetDamageRenderTarget() const { return DamageRenderTarget; } // TODO: Devolver esto a DamageRenderTarget
@@ -51,43 +228,208 @@ public:
 	UFUNCTION(BlueprintCallable)
 	UTextureRenderTarget2D* GetTimeDamageRenderTarget() const { return Cast<UTextureRenderTarget2D>(TimeDamageRenderTarget); } // TODO: Devolver esto a DamageRenderTarget
 
-protected:
 	/// <summary>
-	/// Checks if this component is properly configured
+	/// Get a view over the CPU side copy of the damage map. Sampling it never stalls the GPU, 
+	/// but it lags a few frames behind the latest blast.
 	/// </summary>
-	void CheckComponentConsistency() const;
+	FBlastableDamageQuery GetDamageQuery() const { return FBlastableDamageQuery(this); }
+
+	/// <summary>
+	/// Sample damage near a point of the armor surface using the CPU side copy of the damage map
+	/// </summary>
+	/// <param name="Location"> Point in world space close to the armor surface </param>
+	/// <returns> Damage intensity in [0, 1], 0 if no armor was found near `Location` </returns>
+	UFUNCTION(BlueprintCallable, Category = "ArmorBlasting")
+	float SampleDamageAtLocation(FVector Location) const;
+
+	/** CPU side copy of the damage map */
+	const FBlastableDamageMirror& GetDamageMirror() const { return DamageMirror; }
+
+	/// <summary>
+	/// Sample damage in the shared UV layout, from the CPU backend or the copy of the damage map
+	/// </summary>
+	/// <returns> Damage intensity in [0, 1] </returns>
+	float SampleDamageUV(const FVector2D& UV) const;
+
+	/** Whether damage can be sampled yet */
+	bool HasDamageData() const;
+
+	/** Whether damage is kept in system memory instead of render targets */
+	bool UsesCpuDamage() const { return bUseCpuDamage; }
+
+	/** Damage kept in system memory, only used by the CPU backend */
+	const FBlastableCpuDamage& GetCpuDamage() const { return CpuDamage; }
+
+	/// <summary>
+	/// Apply stamps queued in the CPU backend. Only touches this component's damage, so different
+	/// blastables can be splatted in parallel.
+	/// </summary>
+	void SplatCpuStamps() { CpuDamage.FlushStamps(); }
+
+	/// <summary>
+	/// Upload the regions of the CPU damage touched since the last upload. Game thread only.
+	/// </summary>
+	void UploadCpuDamage();
+
+	/// <summary>
+	/// Encode the damage of this blastable, from system memory only. The damage map comes from the
+	/// CPU backend or the CPU side copy, so taking a record never waits for the GPU.
+	/// </summary>
+	/// <param name="OutRecord"> Record to fill </param>
+	/// <returns> False if there is no damage to record </returns>
+	bool CaptureDamageRecord(FBlastableDamageRecord& OutRecord) const;
+
+	/// <summary>
+	/// Add the damage of a record to this blastable. The damage map is restored with a single
+	/// upload, without replaying any stamp. Game thread only.
+	/// </summary>
+	/// <returns> False if the record is from a newer version or can't be decoded </returns>
+	bool RestoreDamageRecord(const FBlastableDamageRecord& Record);
+
+	/** Key the damage of this blastable is persisted under */
+	FString GetPersistentId() const;
+
+	/** Whether damage is kept while streamed out and written to save games */
+	bool ShouldPersistDamage() const { return bPersistDamage; }
+
+	/** Width and height of the damage render targets, before `ab.DamageResolutionScale` */
+	int32 GetDamageRenderTargetSize() const { return DamageRenderTargetSize; }
+
+	/** Change the size of the damage render targets. Only has effect before BeginPlay. */
+	void SetDamageRenderTargetSize(int32 Size) { DamageRenderTargetSize = Size; }
+
+	/// <summary>
+	/// Resize the damage targets and restart the fading timer after the scalability settings changed,
+	/// keeping the damage already done. Game thread only.
+	/// </summary>
+	void ApplyScalability();
+
+	/** Meshes tagged as 'BlastableMesh' in the owner */
+	const TArray<UStaticMeshComponent*>& GetBlastableMeshes() const { return BlastableMeshes; }
 
 protected:
+	// Called when the component or its parents move
+	virtual void OnUpdateTransform(EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport = ETeleportType::None) override;
+
+	/// <summary>
+	/// Unwrap the blastable meshes once per stamp into the damage render targets
+	/// </summary>
+	/// <param name="Stamps">Hit location in world space (XYZ) and radius (W) of every stamp</param>
+	/// <param name="bFadingLayer">Whether stamps also go into the fading damage target</param>
+	void UnwrapStampsToRenderTarget(TArrayView<const FVector4> Stamps, bool bFadingLayer = true);
 
 	/// <summary>
-	/// This function will keep all Scene Capture default settings in one place.
+	/// Stamp against the reference pose position map instead of capturing the posed armor. Every
+	/// stamp is moved into the space of the pieces it reaches, which are rigid and attached to
+	/// bones, so the result doesn't depend on the animation frame.
 	/// </summary>
-	void SetUpSceneRender2D();
+	/// <param name="Stamps">Hit location in world space (XYZ) and radius (W) of every stamp</param>
+	/// <param name="Targets">Render targets every stamp is drawn into</param>
+	void StampInReferencePose(TArrayView<const FVector4> Stamps, TArrayView<UTextureRenderTarget2D* const> Targets);
 
 	/// <summary>
-	/// Set up material parameters and create dynamic material instances for the unwrapping material
+	/// Stamp into the given render targets, against the position map when available or capturing the armor otherwise
 	/// </summary>
-	/// <param name="Material">Base material for unwrapping</param>
-	void SetUnwrapMaterial(UMaterial* Material);
+	void StampTargets(TArrayView<const FVector4> Stamps, TArrayView<UTextureRenderTarget2D* const> Targets);
 
 	/// <summary>
-	/// Set up material parameters and create dynamic material instances for the fading damage material
+	/// Remove the pending prediction matching a replicated blast, if any
 	/// </summary>
-	/// <param name="Material"> Base material for color fading over time </param>
-	void SetFadingMaterial(UMaterial* Material);
+	/// <returns>True if this client had predicted the blast</returns>
+	bool ConfirmPrediction(const FBlastableNetEvent& Event);
 
 	/// <summary>
-	/// Helper function to collect meshes that are intended to be blastable.
+	/// Restore the damage target to the confirmed damage and stamp the predictions still pending.
+	/// Costs one copy plus one stamp per pending prediction, no matter how much damage was confirmed.
 	/// </summary>
-	/// <returns>An array of meshes child of the current owner that are tagged with 'BlastableMesh' </returns>
-	TArray<UStaticMeshComponent*> GetBlastableMeshSet() const;
+	void RollBackPredictions();
+
+	/** Whether blasts on this component should be sent to clients */
+	bool ShouldRecordNetEvents() const;
+
+	/// <summary>
+	/// Queue a blast for replication, relative to the piece it hit so it lands on the same spot on every client
+	/// </summary>
+	/// <param name="Location">Location in world space of the blast</param>
+	/// <param name="ImpactRadius">Size of the area of effect around `Location`</param>
+	/// <param name="Piece">Piece that was hit, or null if unknown</param>
+	void RecordNetEvent(const FVector& Location, float ImpactRadius, const UPrimitiveComponent* Piece);
+
+	/** Add an event to the replicated ones, dropping the oldest when there are too many */
+	void AddNetEvent(const FBlastableNetEvent& Event);
+
+	/// <summary>
+	/// Keep an event over the network budget for a later update. Once the backlog is as long as
+	/// `MaxRecentNetEvents`, events are merged into overlapping ones instead of queued.
+	/// </summary>
+	void DeferNetEvent(const FBlastableNetEvent& Event);
+
+	/** Send deferred events, oldest first, while the network budget allows it */
+	void SendDeferredNetEvents();
+
+	/** Most events added between two network updates, so none is dropped before clients get it */
+	int32 GetMaxNetEventsPerUpdate() const { return FMath::Max(1, MaxRecentNetEvents / 2); }
+
+	/// <summary>
+	/// Reset damage if the server reset it since the last event or epoch this client got
+	/// </summary>
+	void CatchUpDamageEpoch(uint8 Epoch);
+
+	/** Server time, in seconds, as known by this machine */
+	float GetServerTime() const;
+
+	/** Merge the damage snapshot received from the server into the damage targets and integrity estimate */
+	void ApplyDamageSnapshot();
+
+	/** Renderer of the world drawing queued stamps and fades, null when drawing through canvases */
+	FBlastableDamageRenderer* GetDamageRenderer() const;
+
+	/// <summary>
+	/// Draw a stamp and a fade into scratch targets through the same paths real blasts take, so their
+	/// shaders and pipeline states are ready before the first hit. The CPU backend uploads its damage
+	/// textures instead. Done once per class while loading.
+	/// </summary>
+	void WarmUpRendering(class UBlastablePreloadSubsystem& Preload);
+
+	/** Send stamps and fades queued for the damage targets to the render thread, before something overwrites a target */
+	void SubmitQueuedDamage();
+
+	/** Drop stamps and fades queued for the damage targets, before they are cleared or go away */
+	void ForgetQueuedDamage();
+
+	/** Queue an update of every mip of a damage target, after it was cleared, copied or drawn to through a canvas */
+	void RefreshDamageMips(UTextureRenderTarget2D* Target);
+
+	/** Merge integrity cells into the grid, firing thresholds crossed because of them */
+	void MergeIntegrityCells(const TArray<uint8>& Cells);
+
+	/** Upload damage texels once and add them to the damage targets, one draw per target */
+	void DrawDamageTexels(const TArray<uint8>& Texels, int32 Resolution);
+
+	UFUNCTION()
+	void OnRep_DamageSnapshot();
+
+	UFUNCTION()
+	void OnRep_DamageEpoch();
+
+	/// <summary>
+	/// Distance from this component to the farthest point of the blastable meshes
+	/// </summary>
+	float ComputeBoundsRadius() const;
+
+	/// <summary>
+	/// Checks if this component is properly configured
+	/// </summary>
+	void CheckComponentConsistency() const;
+
+protected:
 
 	/** Update fading damage every few ms to implement the slow fading effect */
 	UFUNCTION()
 	void UpdateFadingDamageRenderTarget();
 
 	/// <summary>
-	/// Access the skeletal mesh component from the owner, assume the owner is a character with a skeletal mesh
+	/// Search the skeletal mesh component of the owner. Only called once in BeginPlay, captures use the one cached in `Core`.
 	/// </summary>
 	/// <returns> Pointer to the owner's skeletal mesh component, or null if the owner doesn't provide a skeletal mesh </returns>
 	USkeletalMeshComponent* GetMeshComponent() const;
@@ -102,34 +444,225 @@ protected:
 	/** Render target where the damage over time will be drawn */
 	UTextureRenderTarget2D* TimeDamageRenderTarget;
 
-	/** Material used to unwrap the texture, an instance will be created in runtime */
+	/** Material used to unwrap the texture, an instance will be created in runtime. Preloaded when the component registers. */
+	UPROPERTY(EditAnywhere, Category = "Resources")
+	TSoftObjectPtr<UMaterial> UnwrapMaterial;
+
+	/** Material drawn over the UV bounds of a piece to stamp damage against the position map. It gets
+		`RT_PositionMap`, `HitLocalPosition`, `DamageRadius` and `PieceId`, and should output damage for
+		texels whose alpha matches `PieceId` and whose position lies within the radius, blending additively.
+		Only used where the stamp shaders aren't available, below SM5. When neither is, damage is stamped
+		by capturing the posed armor with the unwrap material.
+	*/
 	UPROPERTY(EditAnywhere, Category = "Resources")
-	UMaterial* UnwrapMaterial;
+	TSoftObjectPtr<UMaterialInterface> StampMaterial;
+
+	/** Width and height of the reference pose position map, shared by every instance of a class */
+	UPROPERTY(EditAnywhere, Category = "Resources", meta = (ClampMin = "16", ClampMax = "2048"))
+	int32 PositionMapResolution = 256;
+
+	/** Position map of the armor, owned by the class setup cache */
+	UPROPERTY(Transient)
+	UTexture2D* PositionMap;
+
+	/** One stamp material instance per stamp drawn in the same canvas pass, parameters are read when the pass renders */
+	UPROPERTY(Transient)
+	TArray<UMaterialInstanceDynamic*> StampMaterialPool;
+
+	/** Maximum amount of stamps drawn in the same canvas pass */
+	static constexpr int32 MaxStampsPerPass = 16;
 
 	/** Material instance used to compute unwraping */
 	UPROPERTY()
 	UMaterialInstanceDynamic* UnwrapMaterialInstance;
 
-	/** Material used to fade damange over time, an instance will be created in runtime */
+	/** Material used to fade damange over time, an instance will be created in runtime. Preloaded when the component registers. */
 	UPROPERTY(EditAnywhere, Category = "Resources")
-	UMaterial* FadingMaterial;
+	TSoftObjectPtr<UMaterial> FadingMaterial;
 
 	/** Material instance used for fading damage */
 	UPROPERTY()
 	UMaterialInstanceDynamic* UnwrapFadingMaterialInstance;
 
+	/** Where damage is kept. The CPU backend keeps integrity and hole aware traces working on
+		dedicated servers and headless runs, without rendering anything.
+	*/
+	UPROPERTY(EditAnywhere, Category = "Backend")
+	EBlastableDamageBackend DamageBackend = EBlastableDamageBackend::Auto;
+
+	/** Texels per side of the whole UV layout in the CPU backend, rounded up to whole damage tiles.
+		Only the tiles that get stamped take memory, so this can be high even for many blastables.
+	*/
+	UPROPERTY(EditAnywhere, Category = "Backend", meta = (ClampMin = "16", ClampMax = "2048"))
+	int32 CpuDamageResolution = 256;
+
+	/** Damage kept in system memory by the CPU backend */
+	FBlastableCpuDamage CpuDamage;
+
+	/** Textures the armor samples permanent and fading damage from in the CPU backend, with the
+		layout of the damage render targets. Only created on machines that render.
+	*/
+	UPROPERTY(Transient)
+	UTexture2D* CpuDamageTexture;
+
+	UPROPERTY(Transient)
+	UTexture2D* CpuFadingDamageTexture;
+
+	/** Backend chosen in BeginPlay */
+	bool bUseCpuDamage = false;
+
+	/** Width and height of the damage render targets. Run the BlastableUV commandlet to get the
+		smallest size that keeps the texel density you want on the armor of a class.
+	*/
+	UPROPERTY(EditAnywhere, Category = "VFX", meta = (ClampMin = "32", ClampMax = "4096"))
+	int32 DamageRenderTargetSize = 1024;
+
 	/** How much time every damage mark takes to dissapear */
 	UPROPERTY(EditAnywhere, Category = "VFX")
 	float TimeToVanishDamage = 2.f;
 
-	/** Meshes marked as Blastable. These are obtained using the GetBlastableMeshSet, 
-		and cached to prevent overhead of multiple object searches
+	/** Meshes marked as Blastable. These are resolved through the per class setup cache, 
+		to prevent overhead of multiple object searches
 	*/
 	UPROPERTY(EditDefaultsOnly, Category = "Component")
 	TArray<UStaticMeshComponent*> BlastableMeshes;
 
+	/** Meshes that draw the armor, the blastable pieces as seen by the shared capture flow */
+	UPROPERTY(Transient)
+	TArray<UMeshComponent*> ArmorRenderMeshes;
+
+	/** Shared unwrap and capture flow, drawing `ArmorRenderMeshes` over the owner skeletal body */
+	TBlastableCore<FBlastableSkeletalMeshSource> Core;
+
 	/// <summary>
 	/// Used to repeat fading damage material 
 	/// </summary>
 	FTimerHandle DamageFadingTimerHandle;
+
+	/** Resolution of the CPU side copy of the damage map, rounded up to a multiple of 64 */
+	UPROPERTY(EditAnywhere, Category = "Damage Query")
+	int32 DamageMirrorResolution = 128;
+
+	/** Minimum time in seconds between two refreshes of the CPU side copy of the damage map */
+	UPROPERTY(EditAnywhere, Category = "Damage Query")
+	float DamageMirrorRefreshInterval = 0.1f;
+
+	/** Small render target the damage map is downsampled into before reading it back */
+	UPROPERTY()
+	UTextureRenderTarget2D* DamageMirrorRenderTarget;
+
+	/** CPU side copy of the damage map */
+	FBlastableDamageMirror DamageMirror;
+
+	/** Whether the damage map changed since the last readback was queued */
+	bool bDamageMirrorDirty = false;
+
+	/** Time since the last readback was queued */
+	float TimeSinceDamageMirrorRefresh = 0.f;
+
+	/// <summary>
+	/// Update the integrity estimate of the piece hit by `Hit` and fire threshold events. Every hit
+	/// tracked is also recorded when blast telemetry is on.
+	/// </summary>
+	void TrackIntegrity(const FHitResult& Hit, float ImpactRadius, FName Weapon = NAME_None);
+
+	/** Destroyed fractions that trigger `OnArmorIntegrityThresholdCrossed`, in [0, 1] */
+	UPROPERTY(EditAnywhere, Category = "Integrity")
+	TArray<float> IntegrityThresholds;
+
+	/** Breach above which a texel is considered blasted open, and traces go through it */
+	UPROPERTY(EditAnywhere, Category = "Integrity", meta = (ClampMin = "0.0", ClampMax = "1.0"))
+	float HoleDamageThreshold = 0.99f;
+
+	/**
+	 * Damage a hit adds at its center. Damage erodes paint, primer and metal before breaching the armor,
+	 * each layer a quarter of the range, so 1 breaches in a single hit and 0.25 takes four hits on the
+	 * same spot. Materials read the layer from the damage texture, see `BlastableErosion`. Only the
+	 * stamp shaders and the CPU backend erode, blastables stamping through captures always use 1.
+	 */
+	UPROPERTY(EditAnywhere, Category = "Integrity", meta = (ClampMin = "0.01", ClampMax = "1.0"))
+	float ErosionPerHit = 1.f;
+
+	/** Resolution of the occupancy grid used to estimate integrity */
+	UPROPERTY(EditAnywhere, Category = "Integrity")
+	int32 IntegrityGridResolution = 128;
+
+	/** Coarse CPU side record of destroyed armor, shared by all pieces since they share the UV layout */
+	FBlastableDamageGrid IntegrityGrid;
+
+	/** Integrity estimate of every piece, parallel to `BlastableMeshes` */
+	TArray<FBlastablePieceIntegrity> PieceIntegrity;
+
+	/// <summary>
+	/// Fire threshold events for every integrity threshold the piece crossed since the last call
+	/// </summary>
+	void BroadcastCrossedThresholds(int32 PieceIndex);
+
+	/** Latest blasts, replicated to clients as they are added */
+	UPROPERTY(Replicated)
+	FBlastableNetEventArray NetEvents;
+
+	/** Maximum amount of blasts kept for replication. At most half of them are added per network update, the rest wait for later updates. */
+	UPROPERTY(EditAnywhere, Category = "Network", meta = (ClampMin = "1", ClampMax = "255"))
+	int32 MaxRecentNetEvents = 32;
+
+	/** Run length encoded integrity grid, only sent to clients when they start receiving this blastable */
+	UPROPERTY(Transient, ReplicatedUsing = OnRep_DamageSnapshot)
+	TArray<uint8> DamageSnapshot;
+
+	/** Whether `DamageSnapshot` is older than the integrity grid */
+	bool bDamageSnapshotDirty = false;
+
+	/** Bumped every time damage is reset on the server, so clients reset too */
+	UPROPERTY(Transient, ReplicatedUsing = OnRep_DamageEpoch)
+	uint8 DamageEpoch = 0;
+
+	/** Damage epoch whose reset this client already applied */
+	uint8 AppliedDamageEpoch = 0;
+
+	/** Blasts over the network budget, sent with later updates so clients don't miss them */
+	TArray<FBlastableNetEvent> DeferredNetEvents;
+
+	/** Events added since the last network update */
+	int32 NetEventsSinceUpdate = 0;
+
+	/** Blasts and snapshot received before BeginPlay */
+	TArray<FBlastableNetEvent> PendingNetEvents;
+	bool bDamageSnapshotPending = false;
+
+	/** Damage the server agreed on. Only created on clients that predict blasts, to roll back mispredictions. */
+	UPROPERTY(Transient)
+	UTextureRenderTarget2D* ConfirmedDamageRenderTarget;
+
+	/** Blasts predicted by this client and not confirmed yet, oldest first */
+	TArray<FBlastablePrediction> PendingPredictions;
+
+	/** Whether some prediction was dropped since the last rollback */
+	bool bPredictionRollbackPending = false;
+
+	/** Maximum distance in cm between a prediction and a replicated blast for the blast to confirm it */
+	UPROPERTY(EditAnywhere, Category = "Network", meta = (ClampMin = "0.0"))
+	float PredictionTolerance = 4.f;
+
+	/** Maximum amount of pending predictions, bounding the cost of a rollback */
+	UPROPERTY(EditAnywhere, Category = "Network", meta = (ClampMin = "1", ClampMax = "64"))
+	int32 MaxPendingPredictions = 32;
+
+	/** Whether damage is kept while this blastable is streamed out, and written to save games */
+	UPROPERTY(EditAnywhere, Category = "Persistence")
+	bool bPersistDamage = false;
+
+	/** Key the damage is persisted under. Leave empty for blastables placed in a level, spawned
+		blastables must set one that is the same every time they are spawned.
+	*/
+	UPROPERTY(EditAnywhere, Category = "Persistence", meta = (EditCondition = "bPersistDamage"))
+	FString PersistentId;
+
+	/** Texture the snapshot is uploaded into before drawing it on the damage target */
+	UPROPERTY(Transient)
+	UTexture2D* SnapshotTexture;
+
+	/** Subsystem of the owning world, cached so that other threads don't have to look it up */
+	UPROPERTY(Transient)
+	UBlastableSubsystem* BlastableSubsystem;
 };
@@ -0,0 +1,131 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BlastableCore.h"
+#include "Engine/Canvas.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "Engine/Texture2D.h"
+#include "Kismet/KismetRenderingLibrary.h"
+
+void BlastableCore::SetUpSceneCapture(USceneCaptureComponent2D* SceneCapture, bool bAccumulate)
+{
+	SceneCapture->CompositeMode = bAccumulate ? SCCM_Additive : SCCM_Overwrite;
+	SceneCapture->bCaptureEveryFrame = false;
+	SceneCapture->bCaptureOnMovement = false;
+	SceneCapture->ShowOnlyActors.Add(SceneCapture->GetOwner());
+	SceneCapture->PrimitiveRenderMode = ESceneCapturePrimitiveRenderMode::PRM_UseShowOnlyList;
+	SceneCapture->SetRelativeLocation({ 0,0,512 });
+	SceneCapture->SetRelativeRotation(FRotator{ -90,-90,0 });
+	SceneCapture->ProjectionType = ECameraProjectionMode::Orthographic;
+	// Has to cover the layout the unwrap material draws in front of the capture, changing it means changing the material
+	SceneCapture->OrthoWidth = 1024;
+	SceneCapture->ShowFlags.Atmosphere = 0;
+	SceneCapture->ShowFlags.AmbientCubemap = 0;
+	if (bAccumulate)
+	{
+		SceneCapture->ShowFlags.Lighting = 0;
+		SceneCapture->ShowFlags.PostProcessing = 0;
+	}
+}
+
+UMaterialInstanceDynamic* BlastableCore::CreateUnwrapMaterial(UMaterialInterface* Material, UObject* Outer)
+{
+	if (!IsValid(Material) || !IsValid(Outer))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Could not set up UnwrapMaterial since the specified material is not valid"));
+		return nullptr;
+	}
+
+	auto const Instance = UMaterialInstanceDynamic::Create(Material, Outer, TEXT("UnwrapMaterialInstace"));
+	if (Instance == nullptr)
+		UE_LOG(LogTemp, Error, TEXT("Could not set up material instance for unwrap material"));
+
+	return Instance;
+}
+
+UMaterialInstanceDynamic* BlastableCore::CreateFadingMaterial(UMaterialInterface* Material, UObject* Outer, UTextureRenderTarget2D* FadingTarget)
+{
+	if (!IsValid(Material) || !IsValid(Outer))
+		return nullptr;
+
+	auto const Instance = UMaterialInstanceDynamic::Create(Material, Outer, TEXT("FadingMaterialInstace"));
+	if (Instance == nullptr)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Could not set up material instance for fading material"));
+		return nullptr;
+	}
+
+	Instance->SetTextureParameterValue(FName("RT_FadingTexture"), FadingTarget);
+	return Instance;
+}
+
+UTextureRenderTarget2D* BlastableCore::CreateDamageRenderTarget(UObject* Outer, FName Name, int32 Size, bool bFading, bool bMips)
+{
+	auto const Target = NewObject<UTextureRenderTarget2D>(Outer, Name);
+	Target->ClearColor = FColor::Black;
+
+	// bNeedsTwoCopies is necessary to prevent the DrawMaterial call from clearing the render target
+	// used to fade over time before actually fading it. (making it black before sampling the texture
+	// and writing back to it)
+	Target->bNeedsTwoCopies = bFading;
+	if (!bFading)
+		Target->RenderTargetFormat = ETextureRenderTargetFormat::RTF_R8;
+
+	// Distant armor samples small mips instead of aliasing over the full target. The damage renderer
+	// updates them over what every flush touched.
+	Target->bAutoGenerateMips = bMips;
+	Target->ResizeTarget(Size, Size);
+	return Target;
+}
+
+void BlastableCore::FadeRenderTarget(UObject* WorldContextObject, UTextureRenderTarget2D* Target, UMaterialInstanceDynamic* FadingMaterial)
+{
+	if (Target == nullptr || FadingMaterial == nullptr)
+		return;
+
+	// Store what we draw
+	FVector2D Size;
+	UCanvas* Canvas;
+	FDrawToRenderTargetContext Context;
+
+	// Begin a Draw Canvas To Render Target to render the material that fades the render target.
+	// This material should just sample from the target and write back the same color but dimmer.
+	UKismetRenderingLibrary::BeginDrawCanvasToRenderTarget(WorldContextObject, Target, Canvas, Size, Context);
+	{
+		Canvas->K2_DrawMaterial(FadingMaterial, FVector2D::ZeroVector, Size, FVector2D::ZeroVector);
+	}
+	UKismetRenderingLibrary::EndDrawCanvasToRenderTarget(WorldContextObject, Context);
+}
+
+void BlastableCore::CopyRenderTarget(UObject* WorldContextObject, UTextureRenderTarget2D* Source, UTextureRenderTarget2D* Target)
+{
+	if (Source == nullptr || Target == nullptr)
+		return;
+
+	FVector2D Size;
+	UCanvas* Canvas;
+	FDrawToRenderTargetContext Context;
+	UKismetRenderingLibrary::BeginDrawCanvasToRenderTarget(WorldContextObject, Target, Canvas, Size, Context);
+	{
+		Canvas->K2_DrawTexture(Source, FVector2D::ZeroVector, Size, FVector2D::ZeroVector, FVector2D::UnitVector, FLinearColor::White, BLEND_Opaque);
+	}
+	UKismetRenderingLibrary::EndDrawCanvasToRenderTarget(WorldContextObject, Context);
+}
+
+UTexture2D* BlastableCore::CreateCpuTexture(int32 Size, EPixelFormat Format, bool bNearest)
+{
+	auto const Texture = UTexture2D::CreateTransient(Size, Size, Format);
+	if (Texture == nullptr)
+		return nullptr;
+
+	Texture->SRGB = false;
+	Texture->AddressX = TA_Clamp;
+	Texture->AddressY = TA_Clamp;
+	if (bNearest)
+		Texture->Filter = TF_Nearest;
+
+	auto& Mip = Texture->PlatformData->Mips[0];
+	FMemory::Memzero(Mip.BulkData.Lock(LOCK_READ_WRITE), Size * Size * GPixelFormats[Format].BlockBytes);
+	Mip.BulkData.Unlock();
+	Texture->UpdateResource();
+	return Texture;
+}
@@ -0,0 +1,211 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/PrimitiveComponent.h"
+#include "Components/SceneCaptureComponent2D.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Components/StaticMeshComponent.h"
+#include "Materials/MaterialInstanceDynamic.h"
+
+class UTextureRenderTarget2D;
+class UTexture2D;
+
+/**
+ * Parts of the blasting flow that don't depend on where the meshes come from
+ */
+namespace BlastableCore
+{
+	/// <summary>
+	/// Keep all Scene Capture default settings in one place
+	/// </summary>
+	/// <param name="bAccumulate"> Whether captures add up unlit into the target, or replace what it had like props always did </param>
+	ARMORBLASTING_API void SetUpSceneCapture(USceneCaptureComponent2D* SceneCapture, bool bAccumulate);
+
+	/// <summary>
+	/// Create the dynamic instance of the unwrap material
+	/// </summary>
+	/// <param name="Material"> Base material for unwrapping </param>
+	/// <param name="Outer"> Owner of the instance </param>
+	/// <returns> Material instance, or null if `Material` is not valid </returns>
+	ARMORBLASTING_API UMaterialInstanceDynamic* CreateUnwrapMaterial(UMaterialInterface* Material, UObject* Outer);
+
+	/// <summary>
+	/// Create the dynamic instance of the fading material, reading from `FadingTarget`
+	/// </summary>
+	ARMORBLASTING_API UMaterialInstanceDynamic* CreateFadingMaterial(UMaterialInterface* Material, UObject* Outer, UTextureRenderTarget2D* FadingTarget);
+
+	/// <summary>
+	/// Create a render target for damage. Targets that don't fade hold the packed erosion layers in a
+	/// single normalized channel, so stamps saturate once a texel is breached.
+	/// </summary>
+	/// <param name="Outer"> Owner of the render target </param>
+	/// <param name="Name"> Name of the render target </param>
+	/// <param name="Size"> Width and height </param>
+	/// <param name="bFading"> Whether the target will be faded by drawing it onto itself </param>
+	/// <param name="bMips"> Whether to give it a full mip chain. Only for targets drawn by the damage
+	/// renderer, which updates mips over what changed, the engine regenerates them whole after every
+	/// capture or canvas draw. </param>
+	ARMORBLASTING_API UTextureRenderTarget2D* CreateDamageRenderTarget(UObject* Outer, FName Name, int32 Size, bool bFading, bool bMips);
+
+	/// <summary>
+	/// Draw the fading material on the target, making its damage a bit dimmer
+	/// </summary>
+	ARMORBLASTING_API void FadeRenderTarget(UObject* WorldContextObject, UTextureRenderTarget2D* Target, UMaterialInstanceDynamic* FadingMaterial);
+
+	/// <summary>
+	/// Overwrite a render target with the contents of another one, in a single draw
+	/// </summary>
+	ARMORBLASTING_API void CopyRenderTarget(UObject* WorldContextObject, UTextureRenderTarget2D* Source, UTextureRenderTarget2D* Target);
+
+	/// <summary>
+	/// Create a transient texture cleared to zero, updated region by region from the CPU
+	/// </summary>
+	/// <param name="Size"> Width and height </param>
+	/// <param name="Format"> Pixel format, one or four bytes per pixel </param>
+	/// <param name="bNearest"> Whether to sample without filtering, for textures storing indices </param>
+	ARMORBLASTING_API UTexture2D* CreateCpuTexture(int32 Size, EPixelFormat Format, bool bNearest);
+}
+
+/** Mesh source of props made of a single static mesh */
+struct FBlastableStaticMeshSource
+{
+	UStaticMeshComponent* Mesh = nullptr;
+
+	template <typename FuncType>
+	FORCEINLINE void ForEachArmorMesh(FuncType&& Func) const
+	{
+		if (Mesh != nullptr)
+			Func(Mesh);
+	}
+
+	/** Props have no body under their surface */
+	FORCEINLINE void SetBodyVisible(bool bVisible) const {}
+
+	FORCEINLINE bool IsValid() const { return Mesh != nullptr; }
+};
+
+/** Mesh source of characters: many armor meshes over a skeletal body that must not show up in captures */
+struct FBlastableSkeletalMeshSource
+{
+	/** Meshes drawing the armor, owned by the blastable component */
+	const TArray<UMeshComponent*>* ArmorMeshes = nullptr;
+
+	/** Body of the character, might be null for actors made only of armor */
+	USkeletalMeshComponent* Body = nullptr;
+
+	template <typename FuncType>
+	FORCEINLINE void ForEachArmorMesh(FuncType&& Func) const
+	{
+		for (auto const Mesh : *ArmorMeshes)
+		{
+			if (Mesh != nullptr)
+				Func(Mesh);
+		}
+	}
+
+	FORCEINLINE void SetBodyVisible(bool bVisible) const
+	{
+		if (Body != nullptr)
+			Body->SetVisibility(bVisible);
+	}
+
+	FORCEINLINE bool IsValid() const { return ArmorMeshes != nullptr && ArmorMeshes->Num() > 0; }
+};
+
+/**
+ * Unwrap and capture flow shared by every blastable, specialized at compile time over where its
+ * meshes come from, so the capture path never has to search or cast components.
+ *
+ * A mesh source provides `ForEachArmorMesh(Func)`, calling `Func` with every mesh that has to be
+ * drawn with the unwrap material, `SetBodyVisible(bool)`, to hide whatever should not show up in
+ * captures, and `IsValid()`.
+ */
+template <typename MeshSourceType>
+class TBlastableCore
+{
+public:
+	MeshSourceType MeshSource;
+
+	/// <summary>
+	/// Capture a batch of stamps into the given damage targets. Materials are swapped only once
+	/// for the whole batch, every stamp just updates the unwrap parameters and captures.
+	/// </summary>
+	/// <param name="SceneCapture"> Capture set up with `BlastableCore::SetUpSceneCapture` </param>
+	/// <param name="UnwrapMaterial"> Instance of the unwrap material </param>
+	/// <param name="Targets"> Render targets every stamp is captured into </param>
+	/// <param name="Stamps"> Hit location in xyz and radius in w of every stamp </param>
+	/// <param name="CaptureCenter"> Point in world space the capture should look down at </param>
+	void UnwrapStamps(USceneCaptureComponent2D* SceneCapture, UMaterialInstanceDynamic* UnwrapMaterial, TArrayView<UTextureRenderTarget2D* const> Targets, TArrayView<const FVector4> Stamps, const FVector& CaptureCenter) const
+	{
+		// Sanity checks: Check for validity of required resources
+		// (blastable meshes, unwrap material)
+		if (!MeshSource.IsValid())
+		{
+			UE_LOG(LogTemp, Error, TEXT("Error trying to unwrap to render target: Blastable Mesh not properly configured"));
+			return;
+		}
+
+		if (!::IsValid(UnwrapMaterial) || !UnwrapMaterial->IsValidLowLevel())
+		{
+			UE_LOG(LogTemp, Error, TEXT("Error trying to unwrap to render target: UnwrapMaterialInstance not properly set"));
+			return;
+		}
+
+		if (SceneCapture == nullptr || Stamps.Num() == 0)
+			return;
+
+		// Prevent body to show up in unwrapped texture during scene capture
+		MeshSource.SetBodyVisible(false);
+
+		// Make sure that the scene capture is in the right position. Note that it might not be
+		// properly placed when the actor is moving. We use global transformations to prevent
+		// local transforms from messing the placing of the scene capture's camera. Also store
+		// previous rotation to restore it when we finish.
+		const FRotator OldRotation = SceneCapture->GetComponentRotation();
+		const FVector OldPosition = SceneCapture->GetComponentLocation();
+		SceneCapture->SetWorldLocationAndRotation(CaptureCenter + FVector{ 0,0,512 }, FRotator(-90, -90, 0));
+
+		// Update material in all armor pieces to unwrap material, storing the original ones to
+		// restore them later. Note that UVs for each piece should be aware of other pieces UVs
+		// so that they don't overlap
+		TArray<UMaterialInterface*, TInlineAllocator<32>> OldMaterials;
+		MeshSource.ForEachArmorMesh([&OldMaterials, UnwrapMaterial](UPrimitiveComponent* Mesh)
+		{
+			for (int32 i = 0; i < Mesh->GetNumMaterials(); i++)
+			{
+				OldMaterials.Add(Mesh->GetMaterial(i));
+				Mesh->SetMaterial(i, UnwrapMaterial);
+			}
+		});
+
+		// Capture Scene with just the unwrapped material and hit locations
+		for (auto const& Stamp : Stamps)
+		{
+			UnwrapMaterial->SetScalarParameterValue(TEXT("DamageRadius"), Stamp.W);
+			UnwrapMaterial->SetVectorParameterValue(TEXT("HitLocation"), FVector(Stamp));
+
+			for (auto const Target : Targets)
+			{
+				if (Target == nullptr)
+					continue;
+
+				SceneCapture->TextureTarget = Target;
+				SceneCapture->CaptureScene();
+			}
+		}
+
+		// Restore old materials, meshes are visited in the same order as before
+		int32 NextMaterial = 0;
+		MeshSource.ForEachArmorMesh([&OldMaterials, &NextMaterial](UPrimitiveComponent* Mesh)
+		{
+			for (int32 i = 0; i < Mesh->GetNumMaterials(); i++)
+				Mesh->SetMaterial(i, OldMaterials[NextMaterial++]);
+		});
+
+		// Leave everything as we found it
+		MeshSource.SetBodyVisible(true);
+		SceneCapture->SetWorldLocationAndRotation(OldPosition, OldRotation);
+	}
+};
@@ -0,0 +1,378 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BlastableCpuDamage.h"
+#include "BlastableDamageTilePool.h"
+#include "Engine/Texture2D.h"
+
+namespace
+{
+	constexpr int32 TileSize = FBlastableDamageTilePool::TileSize;
+
+	/// <summary>
+	/// Add the coverage of a disc to a rectangle of a tile, four texels of a row at once. Coverage
+	/// falls off over one texel at the border, like a bilinear sample of the disc would.
+	/// </summary>
+	/// <param name="Rect"> Texels to splat, relative to the tile </param>
+	/// <param name="Center"> Center of the disc, relative to the tile </param>
+	void SplatTile(uint8* Damage, uint8* Fading, const FIntRect& Rect, const FVector2D& Center, float Radius, float Erosion)
+	{
+		const VectorRegister LaneCenters = MakeVectorRegister(0.5f, 1.5f, 2.5f, 3.5f);
+		const VectorRegister StampCenterX = VectorSetFloat1(Center.X);
+		const VectorRegister RadiusPlusHalf = VectorSetFloat1(Radius + 0.5f);
+		const VectorRegister MaxAmount = VectorSetFloat1(255.f);
+		const VectorRegister ErosionAmount = VectorSetFloat1(255.f * Erosion);
+
+		// sqrt(x) is computed as x * rsqrt(x), biased so the texel under the center doesn't divide by zero
+		const VectorRegister Bias = VectorSetFloat1(1e-4f);
+
+		for (int32 Y = Rect.Min.Y; Y < Rect.Max.Y; Y++)
+		{
+			const float DY = Y + 0.5f - Center.Y;
+			const VectorRegister DYSquared = VectorSetFloat1(DY * DY);
+			uint8* DamageRow = Damage + Y * TileSize;
+			uint8* FadingRow = Fading + Y * TileSize;
+
+			for (int32 X = Rect.Min.X; X < Rect.Max.X; X += 4)
+			{
+				const VectorRegister DX = VectorSubtract(VectorAdd(VectorSetFloat1(float(X)), LaneCenters), StampCenterX);
+				const VectorRegister DistanceSquared = VectorMultiplyAdd(DX, DX, DYSquared);
+				const VectorRegister Distance = VectorMultiply(DistanceSquared, VectorReciprocalSqrt(VectorAdd(DistanceSquared, Bias)));
+				const VectorRegister Coverage = VectorMin(VectorMax(VectorSubtract(RadiusPlusHalf, Distance), VectorZero()), VectorOne());
+
+				MS_ALIGN(16) float Amounts[4] GCC_ALIGN(16);
+				MS_ALIGN(16) float Erosions[4] GCC_ALIGN(16);
+				VectorStoreAligned(VectorMultiply(Coverage, MaxAmount), Amounts);
+				VectorStoreAligned(VectorMultiply(Coverage, ErosionAmount), Erosions);
+
+				// Saturating adds, damage goes through the erosion layers and stays once breached
+				const int32 Lanes = FMath::Min(4, Rect.Max.X - X);
+				for (int32 Lane = 0; Lane < Lanes; Lane++)
+				{
+					DamageRow[X + Lane] = uint8(FMath::Min(DamageRow[X + Lane] + int32(Erosions[Lane] + 0.5f), 255));
+					FadingRow[X + Lane] = uint8(FMath::Min(FadingRow[X + Lane] + int32(Amounts[Lane] + 0.5f), 255));
+				}
+			}
+		}
+	}
+
+	/** Grow a dirty rectangle to cover `Rect` */
+	void MarkDirty(FIntRect& Dirty, bool& bDirty, const FIntRect& Rect)
+	{
+		if (bDirty)
+			Dirty.Union(Rect);
+		else
+			Dirty = Rect;
+		bDirty = true;
+	}
+
+	/// <summary>
+	/// Copy a region of a page into a damage texture
+	/// </summary>
+	/// <param name="Source"> Texels of the tile holding the page, null to upload an undamaged region </param>
+	/// <param name="Origin"> Position of the page in the texture, in texels </param>
+	/// <param name="Region"> Texels to upload, relative to the page </param>
+	void UploadRegion(UTexture2D* Texture, const uint8* Source, const FIntPoint& Origin, const FIntRect& Region)
+	{
+		const int32 Width = Region.Width();
+		const int32 Height = Region.Height();
+		if (Texture == nullptr || Width <= 0 || Height <= 0)
+			return;
+
+		// The render thread reads the texels later, so they are copied while the tile is free to change
+		uint8* Data = new uint8[Width * Height];
+		for (int32 Row = 0; Row < Height; Row++)
+		{
+			if (Source != nullptr)
+				FMemory::Memcpy(Data + Row * Width, Source + (Region.Min.Y + Row) * TileSize + Region.Min.X, Width);
+			else
+				FMemory::Memzero(Data + Row * Width, Width);
+		}
+
+		auto const Update = new FUpdateTextureRegion2D(Origin.X + Region.Min.X, Origin.Y + Region.Min.Y, 0, 0, Width, Height);
+		Texture->UpdateTextureRegions(0, 1, Update, Width, 1, Data, [](uint8* SrcData, const FUpdateTextureRegion2D* Regions)
+		{
+			delete[] SrcData;
+			delete Regions;
+		});
+	}
+}
+
+void FBlastableCpuDamage::Init(int32 InResolution, TArrayView<const FBox2D> PieceUVBounds, FBlastableDamageTilePool* InPool)
+{
+	Release();
+
+	Pool = InPool;
+	PagesPerRow = FMath::DivideAndRoundUp(FMath::Max(InResolution, 1), TileSize);
+	Resolution = PagesPerRow * TileSize;
+	Pages.SetNum(PagesPerRow * PagesPerRow);
+
+	for (auto const& Bounds : PieceUVBounds)
+	{
+		if (!Bounds.bIsValid)
+		{
+			PieceRects.Add(FIntRect());
+			continue;
+		}
+
+		PieceRects.Add(FIntRect(
+			FMath::Clamp(FMath::FloorToInt(Bounds.Min.X * Resolution), 0, Resolution),
+			FMath::Clamp(FMath::FloorToInt(Bounds.Min.Y * Resolution), 0, Resolution),
+			FMath::Clamp(FMath::CeilToInt(Bounds.Max.X * Resolution), 0, Resolution),
+			FMath::Clamp(FMath::CeilToInt(Bounds.Max.Y * Resolution), 0, Resolution)));
+	}
+}
+
+void FBlastableCpuDamage::Reset()
+{
+	for (auto& Page : Pages)
+	{
+		if (Page.Tile == INDEX_NONE)
+			continue;
+
+		// The page reads as undamaged again, the textures still show the damage of the tile
+		Pool->Free(Page.Tile);
+		Page = FPage();
+		MarkDirty(Page.DamageDirty, Page.bDamageDirty, FIntRect(0, 0, TileSize, TileSize));
+		MarkDirty(Page.FadingDirty, Page.bFadingDirty, FIntRect(0, 0, TileSize, TileSize));
+	}
+
+	PendingStamps.Reset();
+}
+
+void FBlastableCpuDamage::Invalidate()
+{
+	for (auto& Page : Pages)
+	{
+		MarkDirty(Page.DamageDirty, Page.bDamageDirty, FIntRect(0, 0, TileSize, TileSize));
+		MarkDirty(Page.FadingDirty, Page.bFadingDirty, FIntRect(0, 0, TileSize, TileSize));
+	}
+}
+
+void FBlastableCpuDamage::Release()
+{
+	Reset();
+	Pages.Empty();
+	PieceRects.Empty();
+	Pool = nullptr;
+	Resolution = 0;
+	PagesPerRow = 0;
+}
+
+void FBlastableCpuDamage::QueueStamp(int32 Piece, const FVector2D& UV, float UVRadius, float Erosion)
+{
+	if (Pool == nullptr || !PieceRects.IsValidIndex(Piece) || UVRadius <= 0.f)
+		return;
+
+	// Work in texel units from here on
+	const FIntRect& PieceRect = PieceRects[Piece];
+	const FVector2D Center = UV * Resolution;
+	const float Radius = UVRadius * Resolution;
+
+	const FIntRect Rect(
+		FMath::Max(FMath::FloorToInt(Center.X - Radius - 0.5f), PieceRect.Min.X),
+		FMath::Max(FMath::FloorToInt(Center.Y - Radius - 0.5f), PieceRect.Min.Y),
+		FMath::Min(FMath::CeilToInt(Center.X + Radius + 0.5f), PieceRect.Max.X),
+		FMath::Min(FMath::CeilToInt(Center.Y + Radius + 0.5f), PieceRect.Max.Y));
+	if (Rect.Min.X >= Rect.Max.X || Rect.Min.Y >= Rect.Max.Y)
+		return;
+
+	// The pool is shared by every blastable, so tiles are taken here on the game thread and
+	// splatting never has to lock
+	for (int32 PageY = Rect.Min.Y / TileSize; PageY <= (Rect.Max.Y - 1) / TileSize; PageY++)
+	{
+		for (int32 PageX = Rect.Min.X / TileSize; PageX <= (Rect.Max.X - 1) / TileSize; PageX++)
+		{
+			FPage& Page = Pages[PageY * PagesPerRow + PageX];
+			if (Page.Tile == INDEX_NONE)
+				TakeTile(Page);
+		}
+	}
+
+	PendingStamps.Add({ Rect, Center, Radius, Erosion });
+}
+
+void FBlastableCpuDamage::FlushStamps()
+{
+	for (auto const& Stamp : PendingStamps)
+	{
+		for (int32 PageY = Stamp.Rect.Min.Y / TileSize; PageY <= (Stamp.Rect.Max.Y - 1) / TileSize; PageY++)
+		{
+			for (int32 PageX = Stamp.Rect.Min.X / TileSize; PageX <= (Stamp.Rect.Max.X - 1) / TileSize; PageX++)
+			{
+				// Pages without a tile are the ones the pool couldn't give one to
+				FPage& Page = Pages[PageY * PagesPerRow + PageX];
+				if (Page.Tile == INDEX_NONE)
+					continue;
+
+				// Clip the stamp to the page, relative to its tile
+				const FIntPoint Origin(PageX * TileSize, PageY * TileSize);
+				const FIntRect Local(
+					FMath::Max(Stamp.Rect.Min.X - Origin.X, 0),
+					FMath::Max(Stamp.Rect.Min.Y - Origin.Y, 0),
+					FMath::Min(Stamp.Rect.Max.X - Origin.X, TileSize),
+					FMath::Min(Stamp.Rect.Max.Y - Origin.Y, TileSize));
+
+				SplatTile(Pool->GetDamage(Page.Tile), Pool->GetFading(Page.Tile), Local, Stamp.Center - FVector2D(Origin), Stamp.Radius, Stamp.Erosion);
+
+				MarkDirty(Page.DamageDirty, Page.bDamageDirty, Local);
+				MarkDirty(Page.FadingDirty, Page.bFadingDirty, Local);
+				Page.bHasFading = true;
+			}
+		}
+	}
+
+	PendingStamps.Reset();
+}
+
+void FBlastableCpuDamage::Export(TArray<uint8>& OutTexels) const
+{
+	OutTexels.SetNumZeroed(Resolution * Resolution);
+	for (int32 PageIndex = 0; PageIndex < Pages.Num(); PageIndex++)
+	{
+		if (Pages[PageIndex].Tile == INDEX_NONE)
+			continue;
+
+		const uint8* Damage = Pool->GetDamage(Pages[PageIndex].Tile);
+		const FIntPoint Origin((PageIndex % PagesPerRow) * TileSize, (PageIndex / PagesPerRow) * TileSize);
+		for (int32 Row = 0; Row < TileSize; Row++)
+			FMemory::Memcpy(OutTexels.GetData() + (Origin.Y + Row) * Resolution + Origin.X, Damage + Row * TileSize, TileSize);
+	}
+}
+
+void FBlastableCpuDamage::Import(TArrayView<const uint8> Texels, int32 TexelsResolution)
+{
+	if (Pool == nullptr || TexelsResolution <= 0 || Texels.Num() != TexelsResolution * TexelsResolution)
+		return;
+
+	// Index of the source texel nearest to a texel of this map
+	auto const SourceIndex = [&](int32 X, int32 Y)
+	{
+		return (Y * TexelsResolution / Resolution) * TexelsResolution + X * TexelsResolution / Resolution;
+	};
+
+	for (int32 PageIndex = 0; PageIndex < Pages.Num(); PageIndex++)
+	{
+		const FIntPoint Origin((PageIndex % PagesPerRow) * TileSize, (PageIndex / PagesPerRow) * TileSize);
+
+		// Pages without damage in the source stay without a tile
+		bool bDamaged = false;
+		for (int32 Y = 0; Y < TileSize && !bDamaged; Y++)
+		{
+			for (int32 X = 0; X < TileSize && !bDamaged; X++)
+				bDamaged = Texels[SourceIndex(Origin.X + X, Origin.Y + Y)] != 0;
+		}
+
+		FPage& Page = Pages[PageIndex];
+		if (!bDamaged)
+			continue;
+
+		if (Page.Tile == INDEX_NONE && !TakeTile(Page))
+			continue;
+
+		uint8* Damage = Pool->GetDamage(Page.Tile);
+		for (int32 Y = 0; Y < TileSize; Y++)
+		{
+			for (int32 X = 0; X < TileSize; X++)
+			{
+				uint8& Texel = Damage[Y * TileSize + X];
+				Texel = FMath::Max(Texel, Texels[SourceIndex(Origin.X + X, Origin.Y + Y)]);
+			}
+		}
+
+		MarkDirty(Page.DamageDirty, Page.bDamageDirty, FIntRect(0, 0, TileSize, TileSize));
+	}
+}
+
+void FBlastableCpuDamage::Fade(float Amount)
+{
+	const int32 Step = FMath::Clamp(FMath::CeilToInt(Amount * 255.f), 0, 255);
+	if (Step == 0)
+		return;
+
+	for (auto& Page : Pages)
+	{
+		// Pages that had nothing left to fade are skipped, and don't need an upload
+		if (Page.Tile == INDEX_NONE || !Page.bHasFading)
+			continue;
+
+		bool bHasFading = false;
+		uint8* Fading = Pool->GetFading(Page.Tile);
+		for (int32 i = 0; i < TileSize * TileSize; i++)
+		{
+			Fading[i] = uint8(FMath::Max(Fading[i] - Step, 0));
+			bHasFading |= Fading[i] != 0;
+		}
+
+		Page.bHasFading = bHasFading;
+		Page.FadingDirty = FIntRect(0, 0, TileSize, TileSize);
+		Page.bFadingDirty = true;
+	}
+}
+
+void FBlastableCpuDamage::UploadDirtyRegions(UTexture2D* DamageTexture, UTexture2D* FadingTexture)
+{
+	for (int32 PageIndex = 0; PageIndex < Pages.Num(); PageIndex++)
+	{
+		FPage& Page = Pages[PageIndex];
+		const bool bHasTile = Page.Tile != INDEX_NONE;
+		const FIntPoint Origin((PageIndex % PagesPerRow) * TileSize, (PageIndex / PagesPerRow) * TileSize);
+
+		if (Page.bDamageDirty)
+			UploadRegion(DamageTexture, bHasTile ? Pool->GetDamage(Page.Tile) : nullptr, Origin, Page.DamageDirty);
+		if (Page.bFadingDirty)
+			UploadRegion(FadingTexture, bHasTile ? Pool->GetFading(Page.Tile) : nullptr, Origin, Page.FadingDirty);
+
+		Page.bDamageDirty = false;
+		Page.bFadingDirty = false;
+	}
+}
+
+bool FBlastableCpuDamage::TakeTile(FPage& Page)
+{
+	Page.Tile = Pool->Allocate();
+	if (Page.Tile == INDEX_NONE)
+		return false;
+
+	MarkDirty(Page.DamageDirty, Page.bDamageDirty, FIntRect(0, 0, TileSize, TileSize));
+	MarkDirty(Page.FadingDirty, Page.bFadingDirty, FIntRect(0, 0, TileSize, TileSize));
+	return true;
+}
+
+const FBlastableCpuDamage::FPage* FBlastableCpuDamage::FindTexel(const FVector2D& UV, int32& OutIndex) const
+{
+	const FIntPoint Texel(FMath::FloorToInt(UV.X * Resolution), FMath::FloorToInt(UV.Y * Resolution));
+	if (Texel.X < 0 || Texel.Y < 0 || Texel.X >= Resolution || Texel.Y >= Resolution)
+		return nullptr;
+
+	const FPage& Page = Pages[(Texel.Y / TileSize) * PagesPerRow + Texel.X / TileSize];
+	if (Page.Tile == INDEX_NONE)
+		return nullptr;
+
+	OutIndex = (Texel.Y % TileSize) * TileSize + Texel.X % TileSize;
+	return &Page;
+}
+
+float FBlastableCpuDamage::Sample(const FVector2D& UV) const
+{
+	int32 Index;
+	auto const Page = FindTexel(UV, Index);
+	return Page != nullptr ? Pool->GetDamage(Page->Tile)[Index] / 255.f : 0.f;
+}
+
+float FBlastableCpuDamage::SampleFading(const FVector2D& UV) const
+{
+	int32 Index;
+	auto const Page = FindTexel(UV, Index);
+	return Page != nullptr ? Pool->GetFading(Page->Tile)[Index] / 255.f : 0.f;
+}
+
+SIZE_T FBlastableCpuDamage::GetAllocatedSize() const
+{
+	SIZE_T Size = Pages.GetAllocatedSize() + PieceRects.GetAllocatedSize() + PendingStamps.GetAllocatedSize();
+	for (auto const& Page : Pages)
+	{
+		if (Page.Tile != INDEX_NONE)
+			Size += 2 * TileSize * TileSize;
+	}
+	return Size;
+}
@@ -0,0 +1,159 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UTexture2D;
+class FBlastableDamageTilePool;
+
+/**
+ * Damage map kept in system memory. Machines that can't render, like dedicated servers or headless
+ * runs under -nullrhi, get the same gameplay answers they would get from the damage render targets
+ * without a single capture or canvas draw.
+ *
+ * The map is sparse: the UV layout is split in pages of `FBlastableDamageTilePool::TileSize`
+ * texels, and a page only takes a tile from the shared pool the first time a stamp touches it.
+ * Untouched pages read as undamaged. Stamps are discs in UV space with a one texel soft edge, added
+ * with saturation like the additive stamps of the GPU path, and clipped to the UV bounds of the
+ * piece they hit. Their cost follows the stamp area, never the resolution.
+ *
+ * On machines that render, the regions touched since the last upload are copied into two textures
+ * with the layout of the damage targets, so the armor materials sample them like they would sample
+ * the targets and the GPU never has to redraw the whole damage map. Pages that take or give back a
+ * tile are uploaded whole, so texels a tile held for another blastable never show up.
+ */
+class ARMORBLASTING_API FBlastableCpuDamage
+{
+public:
+	/// <summary>
+	/// Set up an empty page table, no tile is taken until something is stamped
+	/// </summary>
+	/// <param name="InResolution"> Texels per side of the whole UV layout, rounded up to whole pages </param>
+	/// <param name="PieceUVBounds"> UV bounds of every piece, an empty box means the piece takes no damage </param>
+	/// <param name="InPool"> Pool tiles are taken from, must outlive this map or its next `Release` </param>
+	void Init(int32 InResolution, TArrayView<const FBox2D> PieceUVBounds, FBlastableDamageTilePool* InPool);
+
+	/** Mark every texel as undamaged, giving every tile back to the pool */
+	void Reset();
+
+	/** Give every tile back to the pool and forget the page table */
+	void Release();
+
+	/** Mark every page dirty, so the next upload writes the whole damage textures */
+	void Invalidate();
+
+	/// <summary>
+	/// Queue a stamp to be applied by the next `FlushStamps`. Takes the tiles the stamp touches, so
+	/// it must be called on the game thread.
+	/// </summary>
+	/// <param name="Piece"> Index of the piece </param>
+	/// <param name="UV"> Center of the disc in UV space </param>
+	/// <param name="UVRadius"> Radius of the disc in UV space </param>
+	/// <param name="Erosion"> Damage added to texels fully inside the disc, the fading layer always gets a full stamp </param>
+	void QueueStamp(int32 Piece, const FVector2D& UV, float UVRadius, float Erosion = 1.f);
+
+	/** Whether some stamp is waiting for `FlushStamps` */
+	bool HasPendingStamps() const { return PendingStamps.Num() > 0; }
+
+	/// <summary>
+	/// Apply every queued stamp. Only touches tiles owned by this map, so different maps can be flushed in parallel.
+	/// </summary>
+	void FlushStamps();
+
+	/// <summary>
+	/// Copy the regions touched since the last upload into the damage textures. Game thread only.
+	/// </summary>
+	/// <param name="DamageTexture"> G8 texture of `GetResolution()` size for permanent damage </param>
+	/// <param name="FadingTexture"> G8 texture of `GetResolution()` size for fading damage </param>
+	void UploadDirtyRegions(UTexture2D* DamageTexture, UTexture2D* FadingTexture);
+
+	/// <summary>
+	/// Copy the permanent damage of every texel, undamaged pages included
+	/// </summary>
+	/// <param name="OutTexels"> `GetResolution()` squared texels in row major order </param>
+	void Export(TArray<uint8>& OutTexels) const;
+
+	/// <summary>
+	/// Add permanent damage read from somewhere else, like a save game. Only pages with some damage
+	/// take a tile, so it must be called on the game thread.
+	/// </summary>
+	/// <param name="Texels"> Damage in row major order, resampled to the resolution of this map </param>
+	/// <param name="TexelsResolution"> Texels per side of `Texels` </param>
+	void Import(TArrayView<const uint8> Texels, int32 TexelsResolution);
+
+	/// <summary>
+	/// Make fading damage dimmer
+	/// </summary>
+	/// <param name="Amount"> How much to remove from every texel, in [0, 1] </param>
+	void Fade(float Amount);
+
+	/// <summary>
+	/// Get the permanent damage under `UV`
+	/// </summary>
+	/// <returns> Damage intensity in [0, 1] </returns>
+	float Sample(const FVector2D& UV) const;
+
+	/// <summary>
+	/// Get the fading damage under `UV`
+	/// </summary>
+	/// <returns> Damage intensity in [0, 1] </returns>
+	float SampleFading(const FVector2D& UV) const;
+
+	/** Texels per side of the whole UV layout */
+	int32 GetResolution() const { return Resolution; }
+
+	/** Pages per side of the page table */
+	int32 GetPagesPerRow() const { return PagesPerRow; }
+
+	/** Bytes used by this map, counting the tiles it owns */
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	struct FPage
+	{
+		/** Tile of the pool holding this page, INDEX_NONE while nothing was stamped on it */
+		int32 Tile = INDEX_NONE;
+
+		/** Union of the texels changed since the last upload, relative to the page */
+		FIntRect DamageDirty;
+		FIntRect FadingDirty;
+		bool bDamageDirty = false;
+		bool bFadingDirty = false;
+
+		/** Whether some texel of the page may still have fading damage */
+		bool bHasFading = false;
+	};
+
+	struct FPendingStamp
+	{
+		/** Texels the stamp can touch, in texels of the whole layout */
+		FIntRect Rect;
+
+		/** Disc in texels of the whole layout */
+		FVector2D Center;
+		float Radius;
+
+		/** Damage added to texels fully inside the disc */
+		float Erosion;
+	};
+
+	/** Take a tile for a page, marking the whole page dirty so the texels it held before are overwritten */
+	bool TakeTile(FPage& Page);
+
+	/** Find the page holding `UV` and the index of its texel in the tile */
+	const FPage* FindTexel(const FVector2D& UV, int32& OutIndex) const;
+
+	/** Page table, row major */
+	TArray<FPage> Pages;
+
+	/** Texels covered by every piece, in texels of the whole layout */
+	TArray<FIntRect> PieceRects;
+
+	/** Stamps waiting for `FlushStamps` */
+	TArray<FPendingStamp> PendingStamps;
+
+	FBlastableDamageTilePool* Pool = nullptr;
+	int32 Resolution = 0;
+	int32 PagesPerRow = 0;
+};
@@ -0,0 +1,88 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BlastableDamageGrid.h"
+#include "BlastableTypes.h"
+
+void FBlastableDamageGrid::Init(int32 InResolution)
+{
+	Resolution = FMath::Max(InResolution, 1);
+	Cells.Init(0, Resolution * Resolution);
+}
+
+void FBlastableDamageGrid::Reset()
+{
+	FMemory::Memzero(Cells.GetData(), Cells.Num());
+}
+
+bool FBlastableDamageGrid::MergeCells(const TArray<uint8>& InCells)
+{
+	if (InCells.Num() != Cells.Num())
+		return false;
+
+	for (int32 i = 0; i < Cells.Num(); i++)
+		Cells[i] = FMath::Max(Cells[i], InCells[i]);
+	return true;
+}
+
+float FBlastableDamageGrid::Stamp(const FVector2D& UV, float UVRadius, const TBitArray<>* Mask, float Erosion)
+{
+	if (Resolution == 0 || UVRadius <= 0.f || Erosion <= 0.f)
+		return 0.f;
+
+	// Work in cell units from here on
+	const float CenterX = UV.X * Resolution;
+	const float CenterY = UV.Y * Resolution;
+	const float Radius = UVRadius * Resolution;
+
+	const int32 MinX = FMath::Clamp(FMath::FloorToInt(CenterX - Radius), 0, Resolution - 1);
+	const int32 MaxX = FMath::Clamp(FMath::FloorToInt(CenterX + Radius), 0, Resolution - 1);
+	const int32 MinY = FMath::Clamp(FMath::FloorToInt(CenterY - Radius), 0, Resolution - 1);
+	const int32 MaxY = FMath::Clamp(FMath::FloorToInt(CenterY + Radius), 0, Resolution - 1);
+
+	float Breached = 0.f;
+	for (int32 Y = MinY; Y <= MaxY; Y++)
+	{
+		for (int32 X = MinX; X <= MaxX; X++)
+		{
+			const int32 Index = Y * Resolution + X;
+			if (Mask != nullptr && !(*Mask)[Index])
+				continue;
+
+			// Approximate how much of the cell is inside the disc using the distance to its center,
+			// a cell half inside the border is half covered.
+			const float Distance = FVector2D(X + 0.5f - CenterX, Y + 0.5f - CenterY).Size();
+			const float Coverage = FMath::Clamp(Radius - Distance + 0.5f, 0.f, 1.f);
+			const int32 Amount = FMath::RoundToInt(Coverage * Erosion * 255.f);
+			if (Amount == 0)
+				continue;
+
+			uint8& Cell = Cells[Index];
+			const float OldBreach = BlastableErosion::GetBreach(Cell / 255.f);
+			Cell = static_cast<uint8>(FMath::Min(Cell + Amount, 255));
+			Breached += BlastableErosion::GetBreach(Cell / 255.f) - OldBreach;
+		}
+	}
+
+	return Breached;
+}
+
+float FBlastableDamageGrid::GetBreachedCells(const TBitArray<>& Mask) const
+{
+	float Breached = 0.f;
+	for (TConstSetBitIterator<> It(Mask); It; ++It)
+	{
+		if (Cells.IsValidIndex(It.GetIndex()))
+			Breached += BlastableErosion::GetBreach(Cells[It.GetIndex()] / 255.f);
+	}
+	return Breached;
+}
+
+float FBlastableDamageGrid::Sample(const FVector2D& UV) const
+{
+	if (Resolution == 0)
+		return 0.f;
+
+	const int32 X = FMath::Clamp(FMath::FloorToInt(UV.X * Resolution), 0, Resolution - 1);
+	const int32 Y = FMath::Clamp(FMath::FloorToInt(UV.Y * Resolution), 0, Resolution - 1);
+	return Cells[Y * Resolution + X] / 255.f;
+}
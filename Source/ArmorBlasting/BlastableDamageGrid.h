@@ -0,0 +1,65 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Coarse CPU side occupancy grid over the armor UV layout. Every cell stores its eroded damage,
+ * from 0 (untouched) to 255 (fully breached), going through the layers of `BlastableErosion`.
+ *
+ * Stamps add to the cells and saturate, like the stamps drawn on the damage targets, so only the
+ * breached part of a cell counts as destroyed area and hitting a breached spot again adds nothing.
+ */
+class ARMORBLASTING_API FBlastableDamageGrid
+{
+public:
+	/// <summary>
+	/// Allocate the grid and clear it
+	/// </summary>
+	/// <param name="InResolution"> Width and height of the grid in cells </param>
+	void Init(int32 InResolution);
+
+	/** Mark every cell as undamaged */
+	void Reset();
+
+	/// <summary>
+	/// Stamp a disc of damage over the grid
+	/// </summary>
+	/// <param name="UV"> Center of the disc in UV space </param>
+	/// <param name="UVRadius"> Radius of the disc in UV space </param>
+	/// <param name="Mask"> If provided, only cells set in the mask are stamped </param>
+	/// <param name="Erosion"> Damage added to cells fully inside the disc </param>
+	/// <returns> Newly breached area, measured in cells </returns>
+	float Stamp(const FVector2D& UV, float UVRadius, const TBitArray<>* Mask = nullptr, float Erosion = 1.f);
+
+	/// <summary>
+	/// Get how eroded the cell under `UV` is
+	/// </summary>
+	/// <returns> Damage of the cell in [0, 1] </returns>
+	float Sample(const FVector2D& UV) const;
+
+	/// <summary>
+	/// Breached area of a set of cells
+	/// </summary>
+	/// <param name="Mask"> Cells to measure </param>
+	/// <returns> Breached area, measured in cells </returns>
+	float GetBreachedCells(const TBitArray<>& Mask) const;
+
+	/** Width and height of the grid in cells */
+	int32 GetResolution() const { return Resolution; }
+
+	/** Raw cell coverage in row major order */
+	const TArray<uint8>& GetCells() const { return Cells; }
+
+	/// <summary>
+	/// Merge cells into the grid, every cell keeps the maximum of its current and new coverage
+	/// </summary>
+	/// <param name="InCells"> Cell coverage in row major order, must match the resolution </param>
+	/// <returns> False if the amount of cells doesn't match the resolution </returns>
+	bool MergeCells(const TArray<uint8>& InCells);
+
+private:
+	TArray<uint8> Cells;
+	int32 Resolution = 0;
+};
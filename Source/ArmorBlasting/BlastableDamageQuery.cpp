@@ -0,0 +1,198 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BlastableDamageQuery.h"
+#include "BlastableComponent.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "Engine/Canvas.h"
+#include "Kismet/KismetRenderingLibrary.h"
+#include "Kismet/GameplayStatics.h"
+#include "RHIGPUReadback.h"
+#include "RenderingThread.h"
+
+FBlastableDamageMirror::FBlastableDamageMirror() = default;
+
+FBlastableDamageMirror::~FBlastableDamageMirror()
+{
+	Release();
+}
+
+void FBlastableDamageMirror::Initialize(int32 InResolution)
+{
+	Release();
+
+	Resolution = Align(FMath::Max(InResolution, 64), 64);
+	SharedState = MakeShared<FSharedState, ESPMode::ThreadSafe>();
+
+	for (int32 i = 0; i < RingSize; i++)
+		SharedState->Ring.Add(MakeUnique<FRHIGPUTextureReadback>(TEXT("BlastableDamageMirror")));
+}
+
+void FBlastableDamageMirror::Release()
+{
+	if (!SharedState.IsValid())
+		return;
+
+	// Readbacks might still be in use by the GPU, so let the render thread drop the last reference
+	TSharedPtr<FSharedState, ESPMode::ThreadSafe> State = MoveTemp(SharedState);
+	ENQUEUE_RENDER_COMMAND(ReleaseBlastableDamageMirror)(
+		[State](FRHICommandListImmediate& RHICmdList) mutable
+		{
+			State->Ring.Empty();
+			State.Reset();
+		});
+
+	Texels.Empty();
+	Generation = 0;
+	DiscardUpToGeneration = 0;
+}
+
+bool FBlastableDamageMirror::RequestRefresh(UTextureRenderTarget2D* Source, UTextureRenderTarget2D* MirrorTarget)
+{
+	if (!SharedState.IsValid() || Source == nullptr || MirrorTarget == nullptr)
+		return false;
+
+	// Every slot is busy, try again next frame instead of waiting for the GPU
+	if (SharedState->InFlight.GetValue() >= RingSize)
+		return false;
+
+	// Downsample on the GPU so that we only read back a few kilobytes
+	FVector2D Size;
+	UCanvas* Canvas;
+	FDrawToRenderTargetContext Context;
+	UKismetRenderingLibrary::BeginDrawCanvasToRenderTarget(MirrorTarget, MirrorTarget, Canvas, Size, Context);
+	{
+		Canvas->K2_DrawTexture(Source, FVector2D::ZeroVector, Size, FVector2D::ZeroVector, FVector2D::UnitVector, FLinearColor::White, BLEND_Opaque);
+	}
+	UKismetRenderingLibrary::EndDrawCanvasToRenderTarget(MirrorTarget, Context);
+
+	FTextureRenderTargetResource* MirrorResource = MirrorTarget->GameThread_GetRenderTargetResource();
+	if (MirrorResource == nullptr)
+		return false;
+
+	SharedState->InFlight.Increment();
+	ENQUEUE_RENDER_COMMAND(RequestBlastableDamageMirror)(
+		[State = SharedState, MirrorResource](FRHICommandListImmediate& RHICmdList)
+		{
+			FRHIGPUTextureReadback& Readback = *State->Ring[State->NextSlot];
+			Readback.EnqueueCopy(RHICmdList, MirrorResource->GetRenderTargetTexture());
+			State->NextSlot = (State->NextSlot + 1) % RingSize;
+		});
+
+	return true;
+}
+
+void FBlastableDamageMirror::Reset()
+{
+	Texels.Empty();
+	if (!SharedState.IsValid())
+		return;
+
+	// Readbacks are published in the order they were queued, so everything in flight right now
+	// will be published with a generation up to this one
+	FScopeLock ScopeLock(&SharedState->Lock);
+	DiscardUpToGeneration = SharedState->PublishedGeneration + SharedState->InFlight.GetValue();
+	Generation = SharedState->PublishedGeneration;
+}
+
+void FBlastableDamageMirror::Tick()
+{
+	if (!SharedState.IsValid())
+		return;
+
+	// Pick up whatever the render thread published since the last tick
+	{
+		FScopeLock ScopeLock(&SharedState->Lock);
+		if (SharedState->PublishedGeneration != Generation && SharedState->PublishedGeneration > DiscardUpToGeneration)
+		{
+			Texels = SharedState->Published;
+			Generation = SharedState->PublishedGeneration;
+		}
+	}
+
+	if (SharedState->InFlight.GetValue() == 0)
+		return;
+
+	// Consume finished readbacks in the order they were queued. Readbacks that are not ready yet
+	// are left for a later frame, we never wait for them.
+	ENQUEUE_RENDER_COMMAND(PollBlastableDamageMirror)(
+		[State = SharedState, TexelCount = Resolution * Resolution](FRHICommandListImmediate& RHICmdList)
+		{
+			while (State->InFlight.GetValue() > 0)
+			{
+				FRHIGPUTextureReadback& Readback = *State->Ring[State->OldestSlot];
+				if (!Readback.IsReady())
+					break;
+
+				// Mirror target is BGRA8, we only keep the red channel which stores holes
+				TArray<uint8> Damage;
+				Damage.SetNumUninitialized(TexelCount);
+				const FColor* Colors = static_cast<const FColor*>(Readback.Lock(TexelCount * sizeof(FColor)));
+				if (Colors != nullptr)
+				{
+					for (int32 i = 0; i < TexelCount; i++)
+						Damage[i] = Colors[i].R;
+				}
+				Readback.Unlock();
+
+				State->OldestSlot = (State->OldestSlot + 1) % RingSize;
+				State->InFlight.Decrement();
+
+				if (Colors == nullptr)
+					continue;
+
+				FScopeLock ScopeLock(&State->Lock);
+				State->Published = MoveTemp(Damage);
+				State->PublishedGeneration++;
+			}
+		});
+}
+
+float FBlastableDamageMirror::Sample(const FVector2D& UV) const
+{
+	if (Texels.Num() == 0)
+		return 0.f;
+
+	const int32 X = FMath::Clamp(FMath::FloorToInt(UV.X * Resolution), 0, Resolution - 1);
+	const int32 Y = FMath::Clamp(FMath::FloorToInt(UV.Y * Resolution), 0, Resolution - 1);
+	return Texels[Y * Resolution + X] / 255.f;
+}
+
+FBlastableDamageQuery::FBlastableDamageQuery(const UBlastableComponent* InBlastable)
+	: Blastable(InBlastable)
+{
+}
+
+bool FBlastableDamageQuery::IsValid() const
+{
+	return Blastable.IsValid() && Blastable->HasDamageData();
+}
+
+float FBlastableDamageQuery::SampleUV(const FVector2D& UV) const
+{
+	if (!Blastable.IsValid())
+		return 0.f;
+
+	return Blastable->SampleDamageUV(UV);
+}
+
+bool FBlastableDamageQuery::SampleHit(const FHitResult& Hit, float& OutDamage) const
+{
+	OutDamage = 0.f;
+
+	FVector2D UV;
+	if (!UGameplayStatics::FindCollisionUV(Hit, 0, UV))
+		return false;
+
+	OutDamage = SampleUV(UV);
+	return true;
+}
+
+bool FBlastableDamageQuery::SampleWorldLocation(const FVector& Location, float& OutDamage, float ProbeDistance) const
+{
+	OutDamage = 0.f;
+	if (!Blastable.IsValid())
+		return false;
+
+	FHitResult Hit;
+	return Blastable->FindSurfaceHit(Location, Hit, ProbeDistance) && SampleHit(Hit, OutDamage);
+}
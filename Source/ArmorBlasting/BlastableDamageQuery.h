@@ -0,0 +1,150 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeCounter.h"
+
+class UTextureRenderTarget2D;
+class UBlastableComponent;
+class FRHIGPUTextureReadback;
+struct FHitResult;
+
+/**
+ * Low resolution copy of a damage render target that lives in system memory.
+ *
+ * The damage render target is first downsampled on the GPU into a small mirror target, and the
+ * mirror target is then copied back to the CPU using a ring of asynchronous readbacks. Readbacks
+ * are only consumed once the GPU is done with them, so the copy lags a few frames behind the
+ * GPU but never stalls the render thread.
+ */
+class ARMORBLASTING_API FBlastableDamageMirror
+{
+public:
+	/** Amount of readbacks that can be in flight at the same time */
+	static constexpr int32 RingSize = 3;
+
+	FBlastableDamageMirror();
+	~FBlastableDamageMirror();
+
+	/// <summary>
+	/// Allocate the readback ring. Resolution is rounded up to a multiple of 64 texels so that
+	/// rows are tightly packed in the staging buffers of every RHI.
+	/// </summary>
+	/// <param name="InResolution"> Width and height of the CPU side copy </param>
+	void Initialize(int32 InResolution);
+
+	/// <summary>
+	/// Release render thread resources. Safe to call more than once.
+	/// </summary>
+	void Release();
+
+	/// <summary>
+	/// Downsample `Source` into `MirrorTarget` and queue a readback for it. Does nothing
+	/// if all readbacks in the ring are still in flight.
+	/// </summary>
+	/// <param name="Source"> Full resolution damage render target </param>
+	/// <param name="MirrorTarget"> Small render target of `GetResolution()` size used as readback source </param>
+	/// <returns> True if a readback was queued </returns>
+	bool RequestRefresh(UTextureRenderTarget2D* Source, UTextureRenderTarget2D* MirrorTarget);
+
+	/// <summary>
+	/// Forget every texel read back so far, including readbacks still in flight. Used when the 
+	/// damage map is cleared, so that stale readbacks don't bring old damage back.
+	/// </summary>
+	void Reset();
+
+	/// <summary>
+	/// Poll finished readbacks and pick up the newest one. Should be called once per frame from the game thread.
+	/// </summary>
+	void Tick();
+
+	/// <summary>
+	/// Sample damage stored in the CPU side copy
+	/// </summary>
+	/// <param name="UV"> Texture coordinates to sample </param>
+	/// <returns> Damage intensity in [0, 1], or 0 if no readback has finished yet </returns>
+	float Sample(const FVector2D& UV) const;
+
+	/** Width and height of the CPU side copy */
+	int32 GetResolution() const { return Resolution; }
+
+	/** Whether at least one readback has finished */
+	bool HasData() const { return Texels.Num() > 0; }
+
+	/** Incremented every time a new readback is picked up */
+	uint32 GetGeneration() const { return Generation; }
+
+	/** Raw texels, one byte of damage per texel in row major order */
+	const TArray<uint8>& GetTexels() const { return Texels; }
+
+private:
+	/** State shared with the render thread */
+	struct FSharedState
+	{
+		/** Render thread only */
+		TArray<TUniquePtr<FRHIGPUTextureReadback>> Ring;
+		int32 NextSlot = 0;
+		int32 OldestSlot = 0;
+
+		/** Amount of readbacks queued but not yet consumed, written from both threads */
+		FThreadSafeCounter InFlight;
+
+		/** Last readback copied out by the render thread, guarded by `Lock` */
+		FCriticalSection Lock;
+		TArray<uint8> Published;
+		uint32 PublishedGeneration = 0;
+	};
+
+	TSharedPtr<FSharedState, ESPMode::ThreadSafe> SharedState;
+
+	/** Game thread copy of the newest readback */
+	TArray<uint8> Texels;
+	uint32 Generation = 0;
+
+	/** Readbacks published up to this generation were queued before the last `Reset` and are ignored */
+	uint32 DiscardUpToGeneration = 0;
+
+	int32 Resolution = 0;
+};
+
+/**
+ * Read only view over the damage of a blastable, backed by its CPU side damage mirror, or by its
+ * damage in system memory when it uses the CPU backend.
+ * Cheap to copy, and never touches the GPU.
+ */
+struct ARMORBLASTING_API FBlastableDamageQuery
+{
+	explicit FBlastableDamageQuery(const UBlastableComponent* InBlastable);
+
+	/** Whether there is any damage data to sample */
+	bool IsValid() const;
+
+	/// <summary>
+	/// Sample damage at the given texture coordinates of the armor
+	/// </summary>
+	/// <param name="UV"> Coordinates in the shared armor UV layout </param>
+	/// <returns> Damage intensity in [0, 1] </returns>
+	float SampleUV(const FVector2D& UV) const;
+
+	/// <summary>
+	/// Sample damage where a trace hit the armor. Requires 'Support UV From Hit Results' in the physics settings.
+	/// </summary>
+	/// <param name="Hit"> Trace result against one of the blastable meshes </param>
+	/// <param name="OutDamage"> Damage intensity in [0, 1] </param>
+	/// <returns> True if the hit could be mapped to texture coordinates </returns>
+	bool SampleHit(const FHitResult& Hit, float& OutDamage) const;
+
+	/// <summary>
+	/// Sample damage at a point near the armor surface. A short trace towards the owner is used to
+	/// find the surface point, so this is more expensive than `SampleHit`.
+	/// </summary>
+	/// <param name="Location"> Point in world space near the armor surface </param>
+	/// <param name="OutDamage"> Damage intensity in [0, 1] </param>
+	/// <param name="ProbeDistance"> How far from `Location` to look for the surface </param>
+	/// <returns> True if some armor surface was found near `Location` </returns>
+	bool SampleWorldLocation(const FVector& Location, float& OutDamage, float ProbeDistance = 10.f) const;
+
+private:
+	TWeakObjectPtr<const UBlastableComponent> Blastable;
+};
@@ -0,0 +1,264 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BlastableDamageRenderer.h"
+#include "BlastableStampShaders.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "TextureResource.h"
+#include "RenderGraphBuilder.h"
+#include "RenderTargetPool.h"
+#include "RHIStaticStates.h"
+#include "PipelineStateCache.h"
+#include "CommonRenderResources.h"
+
+BEGIN_SHADER_PARAMETER_STRUCT(FBlastableDamagePassParameters, )
+	RENDER_TARGET_BINDING_SLOTS()
+END_SHADER_PARAMETER_STRUCT()
+
+namespace
+{
+	/// <summary>
+	/// Regenerate the mips of a target over the rectangle that changed in its first mip. Every mip is
+	/// averaged from the one above, only over the texels covering the rectangle, so the cost follows
+	/// the size of the stamps rather than the size of the target.
+	/// </summary>
+	/// <param name="Texture"> Target, with every mip after the first one to be updated </param>
+	/// <param name="Size"> Width and height of the first mip </param>
+	/// <param name="NumMips"> Mips of the target, including the first one </param>
+	/// <param name="Dirty"> Texels of the first mip that changed </param>
+	void AddMipPasses(FRDGBuilder& GraphBuilder, FRDGTextureRef Texture, FIntPoint Size, int32 NumMips, FIntRect Dirty)
+	{
+		auto const ShaderMap = GetGlobalShaderMap(GMaxRHIFeatureLevel);
+		TShaderMapRef<FBlastableFadeVS> VertexShader(ShaderMap);
+		TShaderMapRef<FBlastableDownsamplePS> PixelShader(ShaderMap);
+
+		for (int32 Mip = 1; Mip < NumMips; Mip++)
+		{
+			// Rounding outwards keeps every texel touching the rectangle, texels of a mip come from
+			// two by two blocks of the one above
+			const FIntPoint MipSize(FMath::Max(Size.X >> Mip, 1), FMath::Max(Size.Y >> Mip, 1));
+			const int32 Round = (1 << Mip) - 1;
+			const FIntRect MipRect(
+				Dirty.Min.X >> Mip, Dirty.Min.Y >> Mip,
+				FMath::Min((Dirty.Max.X + Round) >> Mip, MipSize.X), FMath::Min((Dirty.Max.Y + Round) >> Mip, MipSize.Y));
+			if (MipRect.Area() <= 0)
+				break;
+
+			auto const PassParameters = GraphBuilder.AllocParameters<FBlastableDownsamplePS::FParameters>();
+			PassParameters->SourceMip = GraphBuilder.CreateSRV(FRDGTextureSRVDesc::CreateForMipLevel(Texture, Mip - 1));
+			PassParameters->SourceMipSampler = TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp, AM_Clamp>::GetRHI();
+			PassParameters->InvDestSize = FVector2D(1.f / MipSize.X, 1.f / MipSize.Y);
+			PassParameters->RenderTargets[0] = FRenderTargetBinding(Texture, ERenderTargetLoadAction::ELoad, Mip);
+
+			GraphBuilder.AddPass(RDG_EVENT_NAME("BlastableDamageMip %d %dx%d", Mip, MipRect.Width(), MipRect.Height()), PassParameters, ERDGPassFlags::Raster,
+				[PassParameters, VertexShader, PixelShader, MipRect](FRHICommandList& RHICmdList)
+			{
+				// The strip covers the viewport, and the viewport only what changed
+				RHICmdList.SetViewport(MipRect.Min.X, MipRect.Min.Y, 0.f, MipRect.Max.X, MipRect.Max.Y, 1.f);
+
+				FGraphicsPipelineStateInitializer PSOInit;
+				RHICmdList.ApplyCachedRenderTargets(PSOInit);
+				PSOInit.DepthStencilState = TStaticDepthStencilState<false, CF_Always>::GetRHI();
+				PSOInit.RasterizerState = TStaticRasterizerState<>::GetRHI();
+				PSOInit.BlendState = TStaticBlendState<>::GetRHI();
+				PSOInit.PrimitiveType = PT_TriangleStrip;
+				PSOInit.BoundShaderState.VertexDeclarationRHI = GEmptyVertexDeclaration.VertexDeclarationRHI;
+				PSOInit.BoundShaderState.VertexShaderRHI = VertexShader.GetVertexShader();
+				PSOInit.BoundShaderState.PixelShaderRHI = PixelShader.GetPixelShader();
+				SetGraphicsPipelineState(RHICmdList, PSOInit);
+
+				SetShaderParameters(RHICmdList, PixelShader, PixelShader.GetPixelShader(), *PassParameters);
+				RHICmdList.DrawPrimitive(0, 2, 1);
+			});
+		}
+	}
+}
+
+FBlastableDamageRenderer::FBlastableDamageRenderer(const FAutoRegister& AutoRegister)
+	: FSceneViewExtensionBase(AutoRegister)
+{
+}
+
+void FBlastableDamageRenderer::AddStamps(UTextureRenderTarget2D* Target, UTexture* PositionMap, TArrayView<const FBlastableGpuStamp> Stamps, float Intensity)
+{
+	if (Target == nullptr || PositionMap == nullptr || PositionMap->Resource == nullptr || Stamps.Num() == 0)
+		return;
+
+	FTargetWork& Work = Pending.FindOrAdd(Target);
+	Work.Target = Target->GameThread_GetRenderTargetResource();
+	Work.PositionMap = PositionMap->Resource;
+	for (auto const& Stamp : Stamps)
+	{
+		Work.Stamps.Add(FVector4(Stamp.UVBounds.Min, Stamp.UVBounds.GetSize()));
+		Work.Stamps.Add(FVector4(Stamp.LocalPosition, Stamp.Radius));
+		Work.Stamps.Add(FVector4(Stamp.Piece + 1, Intensity, 0.f, 0.f));
+	}
+}
+
+void FBlastableDamageRenderer::AddFade(UTextureRenderTarget2D* Target, float Amount)
+{
+	if (Target == nullptr || Amount <= 0.f)
+		return;
+
+	FTargetWork& Work = Pending.FindOrAdd(Target);
+	Work.Target = Target->GameThread_GetRenderTargetResource();
+	Work.Fade = FMath::Min(Work.Fade + Amount, 1.f);
+}
+
+void FBlastableDamageRenderer::AddFullMipRefresh(UTextureRenderTarget2D* Target)
+{
+	if (Target == nullptr || !Target->bAutoGenerateMips)
+		return;
+
+	FTargetWork& Work = Pending.FindOrAdd(Target);
+	Work.Target = Target->GameThread_GetRenderTargetResource();
+	Work.bFullMips = true;
+}
+
+void FBlastableDamageRenderer::RemoveTarget(UTextureRenderTarget2D* Target)
+{
+	Pending.Remove(Target);
+}
+
+void FBlastableDamageRenderer::Submit()
+{
+	if (Pending.Num() == 0)
+		return;
+
+	TArray<FTargetWork> Work;
+	Pending.GenerateValueArray(Work);
+	Pending.Reset();
+
+	ENQUEUE_RENDER_COMMAND(BlastableDamage)([Work = MoveTemp(Work)](FRHICommandListImmediate& RHICmdList) mutable
+	{
+		Render(RHICmdList, Work);
+	});
+}
+
+void FBlastableDamageRenderer::BeginRenderViewFamily(FSceneViewFamily& InViewFamily)
+{
+	// Every view family rendered this frame calls this, only the first one finds work to submit
+	Submit();
+}
+
+void FBlastableDamageRenderer::Render(FRHICommandListImmediate& RHICmdList, TArray<FTargetWork>& Work)
+{
+	// Every stamp of the frame goes in a single buffer, targets draw their own range of it
+	TResourceArray<FVector4> StampData;
+	TArray<uint32, TInlineAllocator<64>> FirstStamps;
+	for (auto const& TargetWork : Work)
+	{
+		FirstStamps.Add(StampData.Num() / 3);
+		StampData.Append(TargetWork.Stamps);
+	}
+
+	FShaderResourceViewRHIRef StampsSRV;
+	if (StampData.Num() > 0)
+	{
+		const uint32 Size = StampData.GetResourceDataSize();
+		FRHIResourceCreateInfo CreateInfo(&StampData);
+		FStructuredBufferRHIRef StampBuffer = RHICreateStructuredBuffer(sizeof(FVector4), Size, BUF_ShaderResource | BUF_Volatile, CreateInfo);
+		StampsSRV = RHICreateShaderResourceView(StampBuffer);
+	}
+
+	auto const ShaderMap = GetGlobalShaderMap(GMaxRHIFeatureLevel);
+	TShaderMapRef<FBlastableStampVS> StampVS(ShaderMap);
+	TShaderMapRef<FBlastableStampPS> StampPS(ShaderMap);
+	TShaderMapRef<FBlastableFadeVS> FadeVS(ShaderMap);
+	TShaderMapRef<FBlastableFadePS> FadePS(ShaderMap);
+
+	FRDGBuilder GraphBuilder(RHICmdList);
+	for (int32 i = 0; i < Work.Num(); i++)
+	{
+		const FTargetWork& TargetWork = Work[i];
+		FRHITexture* const TargetTexture = TargetWork.Target != nullptr ? TargetWork.Target->GetRenderTargetTexture() : nullptr;
+		if (TargetTexture == nullptr)
+			continue;
+
+		auto const Texture = GraphBuilder.RegisterExternalTexture(CreateRenderTarget(TargetTexture, TEXT("BlastableDamage")));
+		const FIntPoint Size = TargetWork.Target->GetSizeXY();
+		const float Fade = TargetWork.Fade;
+		const uint32 FirstStamp = FirstStamps[i];
+		const uint32 NumStamps = TargetWork.Stamps.Num() / 3;
+		FRHITexture* const PositionMap = TargetWork.PositionMap != nullptr ? TargetWork.PositionMap->TextureRHI.GetReference() : nullptr;
+
+		// Targets only waiting for their mips have nothing to draw
+		if (Fade > 0.f || (NumStamps > 0 && PositionMap != nullptr))
+		{
+			auto const PassParameters = GraphBuilder.AllocParameters<FBlastableDamagePassParameters>();
+			PassParameters->RenderTargets[0] = FRenderTargetBinding(Texture, ERenderTargetLoadAction::ELoad);
+
+			GraphBuilder.AddPass(RDG_EVENT_NAME("BlastableDamage %dx%d", Size.X, Size.Y), PassParameters, ERDGPassFlags::Raster,
+				[=](FRHICommandList& RHICmdList)
+			{
+				RHICmdList.SetViewport(0, 0, 0.f, Size.X, Size.Y, 1.f);
+
+				FGraphicsPipelineStateInitializer PSOInit;
+				RHICmdList.ApplyCachedRenderTargets(PSOInit);
+				PSOInit.DepthStencilState = TStaticDepthStencilState<false, CF_Always>::GetRHI();
+				PSOInit.RasterizerState = TStaticRasterizerState<>::GetRHI();
+				PSOInit.PrimitiveType = PT_TriangleStrip;
+				PSOInit.BoundShaderState.VertexDeclarationRHI = GEmptyVertexDeclaration.VertexDeclarationRHI;
+
+				// Fade first, so this frame's stamps show at full intensity. Reverse subtract removes the
+				// same amount from every texel without reading the target.
+				if (Fade > 0.f)
+				{
+					PSOInit.BlendState = TStaticBlendState<CW_RGBA, BO_ReverseSubtract, BF_One, BF_One, BO_ReverseSubtract, BF_One, BF_One>::GetRHI();
+					PSOInit.BoundShaderState.VertexShaderRHI = FadeVS.GetVertexShader();
+					PSOInit.BoundShaderState.PixelShaderRHI = FadePS.GetPixelShader();
+					SetGraphicsPipelineState(RHICmdList, PSOInit);
+
+					FBlastableFadePS::FParameters FadeParameters;
+					FadeParameters.FadeAmount = Fade;
+					SetShaderParameters(RHICmdList, FadePS, FadePS.GetPixelShader(), FadeParameters);
+					RHICmdList.DrawPrimitive(0, 2, 1);
+				}
+
+				// Every stamp of the target in one instanced draw, added like the canvas stamps were.
+				// Normalized targets saturate, which is what caps erosion once a texel is breached.
+				if (NumStamps > 0 && PositionMap != nullptr)
+				{
+					PSOInit.BlendState = TStaticBlendState<CW_RGBA, BO_Add, BF_One, BF_One, BO_Add, BF_One, BF_One>::GetRHI();
+					PSOInit.BoundShaderState.VertexShaderRHI = StampVS.GetVertexShader();
+					PSOInit.BoundShaderState.PixelShaderRHI = StampPS.GetPixelShader();
+					SetGraphicsPipelineState(RHICmdList, PSOInit);
+
+					FBlastableStampVS::FParameters VertexParameters;
+					VertexParameters.Stamps = StampsSRV;
+					VertexParameters.FirstStamp = FirstStamp;
+					SetShaderParameters(RHICmdList, StampVS, StampVS.GetVertexShader(), VertexParameters);
+
+					FBlastableStampPS::FParameters PixelParameters;
+					PixelParameters.PositionMap = PositionMap;
+					PixelParameters.PositionMapSampler = TStaticSamplerState<SF_Point>::GetRHI();
+					SetShaderParameters(RHICmdList, StampPS, StampPS.GetPixelShader(), PixelParameters);
+
+					RHICmdList.DrawPrimitive(0, 2, NumStamps);
+				}
+			});
+		}
+
+		// Fades and writes from outside change every texel, stamps only the pieces they were drawn over
+		const int32 NumMips = TargetTexture->GetNumMips();
+		if (NumMips <= 1)
+			continue;
+
+		FIntRect Dirty(FIntPoint::ZeroValue, Size);
+		if (Fade <= 0.f && !TargetWork.bFullMips)
+		{
+			Dirty = FIntRect(Size, FIntPoint::ZeroValue);
+			for (uint32 Stamp = 0; PositionMap != nullptr && Stamp < NumStamps; Stamp++)
+			{
+				const FVector4& Rect = TargetWork.Stamps[Stamp * 3];
+				Dirty.Include(FIntPoint(FMath::FloorToInt(Rect.X * Size.X), FMath::FloorToInt(Rect.Y * Size.Y)));
+				Dirty.Include(FIntPoint(FMath::CeilToInt((Rect.X + Rect.Z) * Size.X), FMath::CeilToInt((Rect.Y + Rect.W) * Size.Y)));
+			}
+			Dirty.Clip(FIntRect(FIntPoint::ZeroValue, Size));
+		}
+
+		if (Dirty.Area() > 0)
+			AddMipPasses(GraphBuilder, Texture, Size, NumMips, Dirty);
+	}
+
+	GraphBuilder.Execute();
+}
@@ -0,0 +1,109 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "SceneViewExtension.h"
+
+class UTextureRenderTarget2D;
+class UTexture;
+
+/** Stamp in the space of the piece it hits, drawn against the position map of its blastable */
+struct FBlastableGpuStamp
+{
+	/** Texels of the target the piece covers */
+	FBox2D UVBounds;
+
+	/** Center of the stamp in the space of the piece */
+	FVector LocalPosition;
+
+	/** Radius of the stamp in the space of the piece */
+	float Radius;
+
+	/** Index of the piece */
+	int32 Piece;
+};
+
+/**
+ * Draws the damage of every blastable of a world in a single render graph per frame.
+ *
+ * Blastables queue stamps and fades instead of drawing them through a canvas each. Right before
+ * the scene renders, everything queued is uploaded in one stamp buffer and recorded as one raster
+ * pass per target: the fade first, then all of its stamps in one instanced draw. The fixed cost of
+ * a draw setup is paid per target and frame, no matter how many blasts happened.
+ *
+ * Targets with mips get them updated right after, one small pass per mip, only over the pieces the
+ * stamps were drawn on. Fades touch every texel and update the whole chain.
+ *
+ * Stamps and fades are added to what the targets already have, so they can be reordered freely
+ * with other additive draws. Anything that overwrites a target must call `Submit` first, and
+ * anything drawing to a target with mips outside of the renderer must call `AddFullMipRefresh` after.
+ */
+class ARMORBLASTING_API FBlastableDamageRenderer : public FSceneViewExtensionBase
+{
+public:
+	FBlastableDamageRenderer(const FAutoRegister& AutoRegister);
+
+	/// <summary>
+	/// Queue stamps against a position map. Game thread only.
+	/// </summary>
+	/// <param name="Target"> Damage target to add the stamps to </param>
+	/// <param name="PositionMap"> Position map of the blastable owning `Target` </param>
+	/// <param name="Stamps"> Stamps to draw </param>
+	/// <param name="Intensity"> Damage added to texels fully inside a stamp </param>
+	void AddStamps(UTextureRenderTarget2D* Target, UTexture* PositionMap, TArrayView<const FBlastableGpuStamp> Stamps, float Intensity = 1.f);
+
+	/// <summary>
+	/// Queue a fade, removing the same amount of damage from every texel. Game thread only.
+	/// </summary>
+	/// <param name="Target"> Damage target to fade </param>
+	/// <param name="Amount"> Damage to remove, in [0, 1] </param>
+	void AddFade(UTextureRenderTarget2D* Target, float Amount);
+
+	/// <summary>
+	/// Queue an update of every mip of a target, after its first mip was cleared, copied or drawn to
+	/// outside of the renderer. Targets without mips are ignored. Game thread only.
+	/// </summary>
+	/// <param name="Target"> Damage target whose first mip changed </param>
+	void AddFullMipRefresh(UTextureRenderTarget2D* Target);
+
+	/** Drop everything queued for a target, because it was cleared or is going away. Game thread only. */
+	void RemoveTarget(UTextureRenderTarget2D* Target);
+
+	/** Send everything queued to the render thread now, instead of waiting for the next frame to render. Game thread only. */
+	void Submit();
+
+	// ISceneViewExtension interface
+	virtual void SetupViewFamily(FSceneViewFamily& InViewFamily) override {}
+	virtual void SetupView(FSceneViewFamily& InViewFamily, FSceneView& InView) override {}
+	virtual void BeginRenderViewFamily(FSceneViewFamily& InViewFamily) override;
+	virtual void PreRenderViewFamily_RenderThread(FRHICommandListImmediate& RHICmdList, FSceneViewFamily& InViewFamily) override {}
+	virtual void PreRenderView_RenderThread(FRHICommandListImmediate& RHICmdList, FSceneView& InView) override {}
+	// End of ISceneViewExtension interface
+
+private:
+	/** Work queued for a single target */
+	struct FTargetWork
+	{
+		/** Render resource of the target */
+		class FTextureRenderTargetResource* Target = nullptr;
+
+		/** Render resource of the position map, null if there are no stamps */
+		class FTextureResource* PositionMap = nullptr;
+
+		/** Packed stamps, three float4 per stamp as read by the stamp shader */
+		TArray<FVector4> Stamps;
+
+		/** Damage to remove before stamping */
+		float Fade = 0.f;
+
+		/** Whether every mip must be updated, because the first one was written outside of the renderer */
+		bool bFullMips = false;
+	};
+
+	/** Record one pass per target in a render graph and execute it. Render thread only. */
+	static void Render(FRHICommandListImmediate& RHICmdList, TArray<FTargetWork>& Work);
+
+	/** Work queued on the game thread since the last submit */
+	TMap<UTextureRenderTarget2D*, FTargetWork> Pending;
+};
@@ -0,0 +1,49 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BlastableDamageTilePool.h"
+
+void FBlastableDamageTilePool::Init(int32 Capacity)
+{
+	Capacity = FMath::Max(Capacity, 1);
+
+	// The outer array never grows after this, so tiles can be written from other threads while
+	// the game thread takes and frees different ones
+	Texels.Reset();
+	Texels.SetNum(Capacity);
+
+	FreeTiles.Reset(Capacity);
+	for (int32 Tile = Capacity - 1; Tile >= 0; Tile--)
+		FreeTiles.Add(Tile);
+
+	bWarnedExhausted = false;
+}
+
+int32 FBlastableDamageTilePool::Allocate()
+{
+	check(IsInGameThread());
+
+	if (FreeTiles.Num() == 0)
+	{
+		if (!bWarnedExhausted)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Blastable damage tile pool is exhausted (%d tiles), new damage won't be stored"), Texels.Num());
+			bWarnedExhausted = true;
+		}
+		return INDEX_NONE;
+	}
+
+	const int32 Tile = FreeTiles.Pop(false);
+	Texels[Tile].Init(0, 2 * TileSize * TileSize);
+	return Tile;
+}
+
+void FBlastableDamageTilePool::Free(int32 Tile)
+{
+	check(IsInGameThread());
+
+	if (!Texels.IsValidIndex(Tile) || Texels[Tile].Num() == 0)
+		return;
+
+	Texels[Tile].Empty();
+	FreeTiles.Add(Tile);
+}
@@ -0,0 +1,59 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Damage tiles shared by every blastable of a world using the CPU backend. A blastable only takes
+ * tiles for the regions of its UV layout that were actually stamped, so memory follows the damage
+ * done instead of the amount of blastables.
+ *
+ * Every tile keeps permanent and fading damage in system memory.
+ */
+class ARMORBLASTING_API FBlastableDamageTilePool
+{
+public:
+	/** Texels per side of a tile */
+	static constexpr int32 TileSize = 64;
+
+	/// <summary>
+	/// Set the capacity of the pool. Texels are only allocated when tiles are taken.
+	/// </summary>
+	/// <param name="Capacity"> Most tiles that can be taken at the same time </param>
+	void Init(int32 Capacity);
+
+	/** Whether `Init` was called */
+	bool IsInitialized() const { return Texels.Num() > 0; }
+
+	/// <summary>
+	/// Take a cleared tile from the pool. Game thread only.
+	/// </summary>
+	/// <returns> Index of the tile, or INDEX_NONE if the pool is exhausted </returns>
+	int32 Allocate();
+
+	/** Give a tile back to the pool, releasing its texels. Game thread only. */
+	void Free(int32 Tile);
+
+	/** Permanent damage of a tile, row major. Safe to write from any thread while the tile is owned. */
+	uint8* GetDamage(int32 Tile) { return Texels[Tile].GetData(); }
+
+	/** Fading damage of a tile, row major. Safe to write from any thread while the tile is owned. */
+	uint8* GetFading(int32 Tile) { return Texels[Tile].GetData() + TileSize * TileSize; }
+
+	const uint8* GetDamage(int32 Tile) const { return Texels[Tile].GetData(); }
+	const uint8* GetFading(int32 Tile) const { return Texels[Tile].GetData() + TileSize * TileSize; }
+
+	/** Amount of tiles currently owned by some blastable */
+	int32 GetNumAllocated() const { return Texels.Num() - FreeTiles.Num(); }
+
+private:
+	/** Permanent then fading damage of every tile, empty while the tile is free */
+	TArray<TArray<uint8>> Texels;
+
+	/** Tiles nobody owns, taken from the back */
+	TArray<int32> FreeTiles;
+
+	/** Whether exhaustion of the pool was already reported */
+	bool bWarnedExhausted = false;
+};
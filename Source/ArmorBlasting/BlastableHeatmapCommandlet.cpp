@@ -0,0 +1,175 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BlastableHeatmapCommandlet.h"
+#include "BlastableTelemetry.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/PackageName.h"
+
+UBlastableHeatmapCommandlet::UBlastableHeatmapCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+namespace
+{
+	/// <summary>
+	/// Black to red to yellow to white, so hot spots stand out from merely warm areas
+	/// </summary>
+	FColor HeatColor(float Heat)
+	{
+		const float R = FMath::Clamp(Heat * 3.f, 0.f, 1.f);
+		const float G = FMath::Clamp(Heat * 3.f - 1.f, 0.f, 1.f);
+		const float B = FMath::Clamp(Heat * 3.f - 2.f, 0.f, 1.f);
+		return FLinearColor(R, G, B).ToFColor(false);
+	}
+
+	/** Blueprint classes end in _C, the heatmap is named after the blueprint */
+	FString GetHeatmapFilename(const FString& ClassName)
+	{
+		FString ShortName = FPackageName::ObjectPathToObjectName(ClassName);
+		ShortName.RemoveFromEnd(TEXT("_C"));
+		return FPaths::MakeValidFileName(ShortName);
+	}
+}
+
+int32 UBlastableHeatmapCommandlet::Main(const FString& Params)
+{
+	TArray<FString> Tokens;
+	TArray<FString> Switches;
+	TMap<FString, FString> ParamValues;
+	ParseCommandLine(*Params, Tokens, Switches, ParamValues);
+
+	FString InputDirectory = FBlastableTelemetry::GetDefaultDirectory();
+	if (auto const InputParam = ParamValues.Find(TEXT("Input")))
+		InputDirectory = *InputParam;
+
+	FString OutputDirectory = FBlastableTelemetry::GetDefaultDirectory() / TEXT("Heatmaps");
+	if (auto const OutputParam = ParamValues.Find(TEXT("Output")))
+		OutputDirectory = *OutputParam;
+
+	if (auto const ResolutionParam = ParamValues.Find(TEXT("Resolution")))
+		Resolution = FMath::Clamp(FCString::Atoi(**ResolutionParam), 16, 4096);
+
+	FString WeaponFilter;
+	if (auto const WeaponParam = ParamValues.Find(TEXT("Weapon")))
+		WeaponFilter = *WeaponParam;
+
+	TArray<FString> Files;
+	IFileManager::Get().FindFiles(Files, *InputDirectory, FBlastableTelemetry::FileExtension);
+	if (Files.Num() == 0)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("BlastableHeatmap: no telemetry files in %s"), *InputDirectory);
+		return 1;
+	}
+
+	// Ids are per file, everything is accumulated by name
+	TMap<FString, FClassHeatmap> Heatmaps;
+	int32 NumHits = 0;
+	for (auto const& File : Files)
+	{
+		FBlastableTelemetryFile Telemetry;
+		if (!Telemetry.Read(InputDirectory / File))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("BlastableHeatmap: %s is not a telemetry file"), *File);
+			continue;
+		}
+
+		for (auto const& Hit : Telemetry.Hits)
+		{
+			auto const ClassName = Telemetry.Classes.Find(Hit.Class);
+			auto const WeaponName = Telemetry.Weapons.Find(Hit.Weapon);
+			if (ClassName == nullptr)
+				continue;
+
+			const FString Weapon = WeaponName != nullptr ? *WeaponName : FString();
+			if (!WeaponFilter.IsEmpty() && Weapon != WeaponFilter)
+				continue;
+
+			FClassHeatmap& Heatmap = Heatmaps.FindOrAdd(*ClassName);
+			if (Heatmap.Heat.Num() == 0)
+				Heatmap.Heat.SetNumZeroed(Resolution * Resolution);
+
+			Splat(Heatmap, Hit.U, Hit.V, Hit.UVRadius);
+			Heatmap.PieceHits.FindOrAdd(Hit.Piece)++;
+			Heatmap.WeaponHits.FindOrAdd(Weapon)++;
+			Heatmap.NumHits++;
+			NumHits++;
+		}
+	}
+
+	IFileManager::Get().MakeDirectory(*OutputDirectory, true);
+
+	int32 Failed = 0;
+	for (auto const& Heatmap : Heatmaps)
+	{
+		if (!WriteHeatmap(Heatmap.Key, Heatmap.Value, OutputDirectory))
+			Failed++;
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("BlastableHeatmap: %d hits from %d files, %d classes written to %s"), NumHits, Files.Num(), Heatmaps.Num() - Failed, *OutputDirectory);
+	return Failed > 0 ? 1 : 0;
+}
+
+void UBlastableHeatmapCommandlet::Splat(FClassHeatmap& Heatmap, float U, float V, float UVRadius) const
+{
+	// Tiny blasts still count as a single texel
+	const float Radius = FMath::Max(UVRadius * Resolution, 0.5f);
+	const float CenterX = U * Resolution;
+	const float CenterY = V * Resolution;
+
+	const int32 MinX = FMath::Max(FMath::FloorToInt(CenterX - Radius), 0);
+	const int32 MaxX = FMath::Min(FMath::CeilToInt(CenterX + Radius), Resolution - 1);
+	const int32 MinY = FMath::Max(FMath::FloorToInt(CenterY - Radius), 0);
+	const int32 MaxY = FMath::Min(FMath::CeilToInt(CenterY + Radius), Resolution - 1);
+
+	for (int32 Y = MinY; Y <= MaxY; Y++)
+	{
+		for (int32 X = MinX; X <= MaxX; X++)
+		{
+			const float Distance = FVector2D::Distance(FVector2D(X + 0.5f, Y + 0.5f), FVector2D(CenterX, CenterY));
+			if (Distance <= Radius)
+				Heatmap.Heat[Y * Resolution + X] += 1.f - Distance / Radius;
+		}
+	}
+}
+
+bool UBlastableHeatmapCommandlet::WriteHeatmap(const FString& ClassName, const FClassHeatmap& Heatmap, const FString& OutputDirectory) const
+{
+	float MaxHeat = 0.f;
+	int32 HitTexels = 0;
+	for (auto const Heat : Heatmap.Heat)
+	{
+		MaxHeat = FMath::Max(MaxHeat, Heat);
+		HitTexels += Heat > 0.f ? 1 : 0;
+	}
+
+	// Square root, so a few hot spots don't make everything else look cold
+	TArray<FColor> Pixels;
+	Pixels.SetNumUninitialized(Heatmap.Heat.Num());
+	for (int32 i = 0; i < Heatmap.Heat.Num(); i++)
+		Pixels[i] = HeatColor(MaxHeat > 0.f ? FMath::Sqrt(Heatmap.Heat[i] / MaxHeat) : 0.f);
+
+	const FString Filename = OutputDirectory / GetHeatmapFilename(ClassName) + TEXT(".bmp");
+	if (!FFileHelper::CreateBitmap(*Filename, Resolution, Resolution, Pixels.GetData()))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("BlastableHeatmap: could not write %s"), *Filename);
+		return false;
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("BlastableHeatmap: %s: %d hits, %.1f%% of the UV space hit"), *ClassName, Heatmap.NumHits, 100.f * HitTexels / FMath::Max(Heatmap.Heat.Num(), 1));
+
+	auto PieceHits = Heatmap.PieceHits;
+	PieceHits.ValueSort(TGreater<int32>());
+	for (auto const& Piece : PieceHits)
+		UE_LOG(LogTemp, Display, TEXT("BlastableHeatmap: %s: piece %d, %d hits (%.1f%%)"), *ClassName, Piece.Key, Piece.Value, 100.f * Piece.Value / Heatmap.NumHits);
+
+	for (auto const& Weapon : Heatmap.WeaponHits)
+		UE_LOG(LogTemp, Display, TEXT("BlastableHeatmap: %s: weapon %s, %d hits"), *ClassName, Weapon.Key.IsEmpty() ? TEXT("unknown") : *Weapon.Key, Weapon.Value);
+
+	return true;
+}
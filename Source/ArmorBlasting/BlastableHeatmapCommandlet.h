@@ -0,0 +1,61 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "BlastableHeatmapCommandlet.generated.h"
+
+/**
+ * Aggregates blast telemetry files into UV heatmaps, one per blastable class.
+ *
+ * Every hit is splatted with its own radius in the shared UV layout of the armor of its class, so
+ * heatmaps line up with the damage textures and with the layouts reported by the BlastableUV
+ * commandlet. Areas that are hit a lot deserve more texel density, areas that are never hit can
+ * give theirs away. Hits per piece and per weapon are logged along with every heatmap.
+ *
+ * Usage: UE4Editor-Cmd ArmorBlasting.uproject -run=BlastableHeatmap [-Input=Dir] [-Output=Dir] [-Resolution=512] [-Weapon=Name]
+ *   -Input:  folder with the telemetry files, Saved/BlastTelemetry by default
+ *   -Output: folder to write the heatmaps to, Saved/BlastTelemetry/Heatmaps by default
+ *   -Weapon: only count hits of this weapon
+ */
+UCLASS()
+class ARMORBLASTING_API UBlastableHeatmapCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UBlastableHeatmapCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+protected:
+	/** Hits of a single class, accumulated across files */
+	struct FClassHeatmap
+	{
+		/** Splatted hits, `Resolution` squared */
+		TArray<float> Heat;
+
+		/** Hits per piece index */
+		TMap<int32, int32> PieceHits;
+
+		/** Hits per weapon name */
+		TMap<FString, int32> WeaponHits;
+
+		int32 NumHits = 0;
+	};
+
+	/// <summary>
+	/// Splat a hit into a heatmap, with a linear falloff towards its border
+	/// </summary>
+	void Splat(FClassHeatmap& Heatmap, float U, float V, float UVRadius) const;
+
+	/// <summary>
+	/// Write a heatmap as a bitmap, normalized by its hottest texel, and log its stats
+	/// </summary>
+	/// <returns> False if the bitmap could not be written </returns>
+	bool WriteHeatmap(const FString& ClassName, const FClassHeatmap& Heatmap, const FString& OutputDirectory) const;
+
+	/** Width and height of the heatmaps */
+	int32 Resolution = 512;
+};
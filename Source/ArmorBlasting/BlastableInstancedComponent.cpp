@@ -0,0 +1,240 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BlastableInstancedComponent.h"
+#include "ArmorBlasting.h"
+#include "Engine/Canvas.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "Kismet/KismetRenderingLibrary.h"
+#include "Materials/MaterialInstanceDynamic.h"
+#include "PhysicsEngine/BodySetup.h"
+
+UBlastableInstancedComponent::UBlastableInstancedComponent()
+{
+	// Only ticks while there are stamps waiting to be drawn
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = false;
+
+	NumCustomDataFloats = 1;
+}
+
+void UBlastableInstancedComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (NumCustomDataFloats <= DamageTileCustomDataIndex)
+		SetNumCustomDataFloats(DamageTileCustomDataIndex + 1);
+
+	// Shots trace in ECC_Enemy, props keep the rest of their collision as it is
+	SetCollisionResponseToChannel(ECC_Enemy, ECollisionResponse::ECR_Block);
+
+	DamageAtlas = NewObject<UTextureRenderTarget2D>(this, TEXT("DamageAtlas"));
+	DamageAtlas->RenderTargetFormat = ETextureRenderTargetFormat::RTF_RGBA8;
+	DamageAtlas->ClearColor = FLinearColor::Black;
+	DamageAtlas->ResizeTarget(DamageAtlasSize, DamageAtlasSize);
+
+	TileOwners.Init(INDEX_NONE, DamageAtlasTilesPerRow * DamageAtlasTilesPerRow);
+	TileAge.Reset();
+	RebuildTileOwners();
+
+	if (!FBlastablePieceLayout::Build(this, 128, Layout))
+		UE_LOG(LogTemp, Warning, TEXT("Blastable instances %s have no UV layout, they won't take damage"), *GetName());
+
+	// Let every material find the atlas
+	for (int32 i = 0; i < GetNumMaterials(); i++)
+	{
+		auto const Material = GetMaterial(i);
+		if (Material == nullptr)
+			continue;
+
+		auto DynamicMaterial = Cast<UMaterialInstanceDynamic>(Material);
+		if (DynamicMaterial == nullptr)
+		{
+			DynamicMaterial = UMaterialInstanceDynamic::Create(Material, this);
+			SetMaterial(i, DynamicMaterial);
+		}
+
+		DynamicMaterial->SetTextureParameterValue(FName("RT_DamageAtlas"), DamageAtlas);
+		DynamicMaterial->SetScalarParameterValue(FName("DamageAtlasTilesPerRow"), DamageAtlasTilesPerRow);
+	}
+}
+
+void UBlastableInstancedComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	FlushStamps();
+	SetComponentTickEnabled(false);
+}
+
+bool UBlastableInstancedComponent::RemoveInstance(int32 InstanceIndex)
+{
+	const int32 Tile = GetDamageTile(InstanceIndex);
+	if (Tile != INDEX_NONE)
+	{
+		TileOwners[Tile] = INDEX_NONE;
+		TileAge.Remove(Tile);
+	}
+
+	if (!Super::RemoveInstance(InstanceIndex))
+		return false;
+
+	// Removing instances moves others around, custom data moves with them
+	RebuildTileOwners();
+	return true;
+}
+
+bool UBlastableInstancedComponent::Blast(const FHitResult& Hit, float ImpactRadius)
+{
+	if (Hit.GetComponent() != this || !IsValidInstance(Hit.Item))
+		return false;
+
+	auto const BodySetup = GetBodySetup();
+	if (BodySetup == nullptr)
+		return false;
+
+	// Collision UVs are stored in mesh space, so the hit has to be brought into the space of the instance
+	FTransform InstanceTransform;
+	GetInstanceTransform(Hit.Item, InstanceTransform, true);
+
+	FVector2D UV;
+	if (!BodySetup->CalcUVAtLocation(InstanceTransform.InverseTransformPosition(Hit.Location), Hit.FaceIndex, 0, UV))
+		return false;
+
+	BlastInstance(Hit.Item, UV, ImpactRadius);
+	return true;
+}
+
+void UBlastableInstancedComponent::BlastInstance(int32 InstanceIndex, const FVector2D& UV, float ImpactRadius)
+{
+	if (!IsValidInstance(InstanceIndex) || !Layout.IsValid() || DamageAtlas == nullptr)
+		return;
+
+	// The layout was measured at the component scale, instances add their own on top
+	FTransform InstanceTransform;
+	GetInstanceTransform(InstanceIndex, InstanceTransform, false);
+	const FVector InstanceScale = InstanceTransform.GetScale3D().GetAbs();
+	const float AverageScale = FMath::Max((InstanceScale.X + InstanceScale.Y + InstanceScale.Z) / 3.f, KINDA_SMALL_NUMBER);
+
+	const int32 Tile = AcquireTile(InstanceIndex);
+	PendingStamps.Add({ Tile, UV, ImpactRadius * Layout.UVPerCm / AverageScale, false });
+	SetComponentTickEnabled(true);
+}
+
+void UBlastableInstancedComponent::ResetInstanceDamage(int32 InstanceIndex)
+{
+	const int32 Tile = GetDamageTile(InstanceIndex);
+	if (Tile == INDEX_NONE)
+		return;
+
+	TileOwners[Tile] = INDEX_NONE;
+	TileAge.Remove(Tile);
+	SetInstanceTile(InstanceIndex, INDEX_NONE);
+}
+
+int32 UBlastableInstancedComponent::GetDamageTile(int32 InstanceIndex) const
+{
+	const int32 DataIndex = InstanceIndex * NumCustomDataFloats + DamageTileCustomDataIndex;
+	if (!IsValidInstance(InstanceIndex) || !PerInstanceSMCustomData.IsValidIndex(DataIndex))
+		return INDEX_NONE;
+
+	return FMath::RoundToInt(PerInstanceSMCustomData[DataIndex]) - 1;
+}
+
+int32 UBlastableInstancedComponent::AcquireTile(int32 InstanceIndex)
+{
+	int32 Tile = GetDamageTile(InstanceIndex);
+	if (Tile != INDEX_NONE)
+		return Tile;
+
+	Tile = TileOwners.Find(INDEX_NONE);
+	if (Tile == INDEX_NONE)
+	{
+		// Atlas is full, the instance damaged the longest ago loses its damage
+		Tile = TileAge[0];
+		TileAge.RemoveAt(0);
+		SetInstanceTile(TileOwners[Tile], INDEX_NONE);
+	}
+
+	TileOwners[Tile] = InstanceIndex;
+	TileAge.Add(Tile);
+	SetInstanceTile(InstanceIndex, Tile);
+
+	// Tiles can be reused, start from a clean one
+	PendingStamps.Add({ Tile, FVector2D::ZeroVector, 0.f, true });
+	return Tile;
+}
+
+void UBlastableInstancedComponent::SetInstanceTile(int32 InstanceIndex, int32 Tile)
+{
+	if (IsValidInstance(InstanceIndex))
+		SetCustomDataValue(InstanceIndex, DamageTileCustomDataIndex, float(Tile + 1), true);
+}
+
+void UBlastableInstancedComponent::RebuildTileOwners()
+{
+	for (auto& Owner : TileOwners)
+		Owner = INDEX_NONE;
+
+	for (int32 i = 0; i < GetInstanceCount(); i++)
+	{
+		const int32 Tile = GetDamageTile(i);
+		if (TileOwners.IsValidIndex(Tile))
+			TileOwners[Tile] = i;
+	}
+
+	// Drop tiles no instance owns anymore, keeping the order of the rest
+	TileAge.RemoveAll([this](int32 Tile) { return TileOwners[Tile] == INDEX_NONE; });
+}
+
+void UBlastableInstancedComponent::FlushStamps()
+{
+	if (PendingStamps.Num() == 0 || DamageAtlas == nullptr)
+		return;
+
+	FVector2D Size;
+	UCanvas* Canvas;
+	FDrawToRenderTargetContext Context;
+	UKismetRenderingLibrary::BeginDrawCanvasToRenderTarget(this, DamageAtlas, Canvas, Size, Context);
+	{
+		for (auto const& Stamp : PendingStamps)
+		{
+			const FBox2D TileRect = GetTileRect(Stamp.Tile);
+			const FVector2D TileSize = TileRect.GetSize();
+
+			if (Stamp.bClear)
+			{
+				Canvas->K2_DrawTexture(nullptr, TileRect.Min, TileSize, FVector2D::ZeroVector, FVector2D::UnitVector, FLinearColor::Black, BLEND_Opaque);
+				continue;
+			}
+
+			if (StampMaterial == nullptr)
+				continue;
+
+			// Clip the stamp to its tile so that it never bleeds into the damage of other instances,
+			// adjusting the stamp coordinates so that the visible part stays the same
+			const FBox2D StampRect(
+				TileRect.Min + (Stamp.UV - FVector2D(Stamp.UVRadius, Stamp.UVRadius)) * TileSize,
+				TileRect.Min + (Stamp.UV + FVector2D(Stamp.UVRadius, Stamp.UVRadius)) * TileSize);
+			const FBox2D Clipped(
+				FVector2D::Max(StampRect.Min, TileRect.Min),
+				FVector2D::Min(StampRect.Max, TileRect.Max));
+
+			const FVector2D ClippedSize = Clipped.Max - Clipped.Min;
+			if (ClippedSize.X <= 0.f || ClippedSize.Y <= 0.f)
+				continue;
+
+			const FVector2D StampSize = StampRect.GetSize();
+			Canvas->K2_DrawMaterial(StampMaterial, Clipped.Min, ClippedSize, (Clipped.Min - StampRect.Min) / StampSize, ClippedSize / StampSize);
+		}
+	}
+	UKismetRenderingLibrary::EndDrawCanvasToRenderTarget(this, Context);
+
+	PendingStamps.Reset();
+}
+
+FBox2D UBlastableInstancedComponent::GetTileRect(int32 Tile) const
+{
+	const float TileSize = float(DamageAtlasSize) / DamageAtlasTilesPerRow;
+	const FVector2D Min((Tile % DamageAtlasTilesPerRow) * TileSize, (Tile / DamageAtlasTilesPerRow) * TileSize);
+	return FBox2D(Min, Min + FVector2D(TileSize, TileSize));
+}
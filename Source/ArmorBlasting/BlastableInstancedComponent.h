@@ -0,0 +1,125 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+#include "BlastableUVLayout.h"
+#include "BlastableInstancedComponent.generated.h"
+
+class UTextureRenderTarget2D;
+class UMaterialInterface;
+
+/**
+ * Hierarchical instanced static mesh whose instances can be blasted one by one.
+ *
+ * Damage of every instance lives in a tile of a single atlas render target shared by the whole
+ * component. The tile of an instance is stored in its per instance custom data, so the mesh
+ * material can find it, and tiles are only handed out once an instance is hit for the first time.
+ * Stamps are drawn straight into the atlas with a canvas, there is no scene capture involved.
+ *
+ * Mesh materials are expected to read the tile from `PerInstanceCustomData[DamageTileCustomDataIndex]`,
+ * where 0 means no damage and N means tile N - 1, and to sample `RT_DamageAtlas` laid out in
+ * `DamageAtlasTilesPerRow` tiles per row.
+ */
+UCLASS(ClassGroup = (ArmorBlasting), meta = (BlueprintSpawnableComponent))
+class ARMORBLASTING_API UBlastableInstancedComponent : public UHierarchicalInstancedStaticMeshComponent
+{
+	GENERATED_BODY()
+
+public:
+	UBlastableInstancedComponent();
+
+	virtual void BeginPlay() override;
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+	virtual bool RemoveInstance(int32 InstanceIndex) override;
+
+	/// <summary>
+	/// Blast the instance hit by a trace. Requires 'Support UV From Hit Results' in the physics settings.
+	/// </summary>
+	/// <param name="Hit"> Trace result against this component, with face index </param>
+	/// <param name="ImpactRadius"> Radius of the hole in world units </param>
+	/// <returns> True if the hit could be mapped to the instance surface </returns>
+	UFUNCTION(BlueprintCallable, Category = "ArmorBlasting")
+	bool Blast(const FHitResult& Hit, float ImpactRadius);
+
+	/// <summary>
+	/// Blast an instance at the given texture coordinates
+	/// </summary>
+	/// <param name="InstanceIndex"> Instance to blast </param>
+	/// <param name="UV"> Texture coordinates of the impact in the mesh UV layout </param>
+	/// <param name="ImpactRadius"> Radius of the hole in world units </param>
+	void BlastInstance(int32 InstanceIndex, const FVector2D& UV, float ImpactRadius);
+
+	/// <summary>
+	/// Remove every damage of an instance and give its tile back
+	/// </summary>
+	UFUNCTION(BlueprintCallable, Category = "ArmorBlasting")
+	void ResetInstanceDamage(int32 InstanceIndex);
+
+	/** Render target holding the damage of every instance */
+	UTextureRenderTarget2D* GetDamageAtlas() const { return DamageAtlas; }
+
+	/** Tile of the atlas used by an instance, or INDEX_NONE if it was never damaged */
+	int32 GetDamageTile(int32 InstanceIndex) const;
+
+protected:
+	/// <summary>
+	/// Get the tile of an instance, handing out a new one if it has none. When the atlas is full,
+	/// the tile of the instance damaged the longest ago is taken over.
+	/// </summary>
+	int32 AcquireTile(int32 InstanceIndex);
+
+	/** Write the tile of an instance in its custom data */
+	void SetInstanceTile(int32 InstanceIndex, int32 Tile);
+
+	/** Recover which instance owns every tile from the instances custom data */
+	void RebuildTileOwners();
+
+	/** Draw every pending stamp and tile clear in a single canvas pass */
+	void FlushStamps();
+
+	/** Rectangle of a tile in atlas pixels */
+	FBox2D GetTileRect(int32 Tile) const;
+
+	/** Width and height of the damage atlas */
+	UPROPERTY(EditAnywhere, Category = "Damage", meta = (ClampMin = "64", ClampMax = "8192"))
+	int32 DamageAtlasSize = 2048;
+
+	/** Tiles per row of the damage atlas, there are this squared tiles in total */
+	UPROPERTY(EditAnywhere, Category = "Damage", meta = (ClampMin = "1", ClampMax = "64"))
+	int32 DamageAtlasTilesPerRow = 16;
+
+	/** Custom data float where the damage tile of every instance is stored */
+	UPROPERTY(EditAnywhere, Category = "Damage", meta = (ClampMin = "0"))
+	int32 DamageTileCustomDataIndex = 0;
+
+	/** Material drawn for every stamp. Should be additive and fade radially from the center of its quad. */
+	UPROPERTY(EditAnywhere, Category = "Damage")
+	UMaterialInterface* StampMaterial;
+
+	UPROPERTY(Transient)
+	UTextureRenderTarget2D* DamageAtlas;
+
+	/** UV layout of the mesh at the component scale */
+	FBlastablePieceLayout Layout;
+
+	/** Instance owning every tile, INDEX_NONE for free tiles */
+	TArray<int32> TileOwners;
+
+	/** Tiles in the order they were handed out, the first one is evicted when the atlas is full */
+	TArray<int32> TileAge;
+
+	struct FPendingStamp
+	{
+		int32 Tile;
+		FVector2D UV;
+		float UVRadius;
+
+		/** Clear the whole tile instead of stamping */
+		bool bClear;
+	};
+
+	/** Stamps waiting for the next canvas pass */
+	TArray<FPendingStamp> PendingStamps;
+};
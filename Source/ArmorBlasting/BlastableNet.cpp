@@ -0,0 +1,120 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BlastableNet.h"
+#include "BlastableComponent.h"
+
+void FBlastableNetEvent::Set(uint8 InPiece, const FVector& LocalPosition, float InRadius, float ServerTime)
+{
+	auto const Quantize = [](float Value)
+	{
+		return int16(FMath::Clamp(FMath::RoundToInt(Value / PositionScale), int32(MIN_int16), int32(MAX_int16)));
+	};
+
+	Piece = InPiece;
+	X = Quantize(LocalPosition.X);
+	Y = Quantize(LocalPosition.Y);
+	Z = Quantize(LocalPosition.Z);
+	Radius = uint8(FMath::Clamp(FMath::RoundToInt(InRadius / RadiusScale), 1, int32(MAX_uint8)));
+	Time = uint16(FMath::RoundToInt(ServerTime / TimeScale) & 0xFFFF);
+}
+
+float FBlastableNetEvent::GetAge(float ServerTime) const
+{
+	const uint16 Now = uint16(FMath::RoundToInt(ServerTime / TimeScale) & 0xFFFF);
+	return uint16(Now - Time) * TimeScale;
+}
+
+bool FBlastableNetEvent::Absorb(const FBlastableNetEvent& Other)
+{
+	if (Piece != Other.Piece || Epoch != Other.Epoch)
+		return false;
+
+	const FVector Center = GetLocalPosition();
+	const FVector OtherCenter = Other.GetLocalPosition();
+	const float Distance = FVector::Dist(Center, OtherCenter);
+	if (Distance > GetRadius() + Other.GetRadius())
+		return false;
+
+	// Smallest sphere around both blasts
+	FVector MergedCenter = Center;
+	float MergedRadius = GetRadius();
+	if (Distance + GetRadius() <= Other.GetRadius())
+	{
+		MergedCenter = OtherCenter;
+		MergedRadius = Other.GetRadius();
+	}
+	else if (Distance + Other.GetRadius() > GetRadius())
+	{
+		MergedRadius = (Distance + GetRadius() + Other.GetRadius()) * 0.5f;
+		MergedCenter = Center + (OtherCenter - Center) / Distance * (MergedRadius - GetRadius());
+	}
+
+	if (MergedRadius > MAX_uint8 * RadiusScale)
+		return false;
+
+	const uint16 LatestTime = int16(Other.Time - Time) > 0 ? Other.Time : Time;
+	Set(Piece, MergedCenter, MergedRadius, 0.f);
+	Time = LatestTime;
+	return true;
+}
+
+void FBlastableNetEvent::PostReplicatedAdd(const FBlastableNetEventArray& InArraySerializer)
+{
+	if (InArraySerializer.Owner != nullptr)
+		InArraySerializer.Owner->ApplyNetEvent(*this);
+}
+
+void BlastableNet::EncodeCells(const TArray<uint8>& Cells, TArray<uint8>& OutBytes)
+{
+	OutBytes.Reset();
+
+	int32 Index = 0;
+	while (Index < Cells.Num())
+	{
+		const uint8 Level = Cells[Index] >> 4;
+		int32 Length = 1;
+		while (Index + Length < Cells.Num() && Length < 16 + MAX_uint8 && (Cells[Index + Length] >> 4) == Level)
+			Length++;
+
+		if (Length < 16)
+		{
+			OutBytes.Add(uint8(Level << 4) | uint8(Length));
+		}
+		else
+		{
+			OutBytes.Add(uint8(Level << 4));
+			OutBytes.Add(uint8(Length - 16));
+		}
+
+		Index += Length;
+	}
+}
+
+bool BlastableNet::DecodeCells(const TArray<uint8>& Bytes, int32 NumCells, TArray<uint8>& OutCells)
+{
+	OutCells.Reset(NumCells);
+
+	int32 Index = 0;
+	while (Index < Bytes.Num())
+	{
+		const uint8 Level = Bytes[Index] >> 4;
+		int32 Length = Bytes[Index] & 0xF;
+		Index++;
+
+		if (Length == 0)
+		{
+			if (Index >= Bytes.Num())
+				return false;
+			Length = Bytes[Index++] + 16;
+		}
+
+		if (OutCells.Num() + Length > NumCells)
+			return false;
+
+		// Expand the level back to the full range, so a fully destroyed cell stays at 255
+		OutCells.AddUninitialized(Length);
+		FMemory::Memset(OutCells.GetData() + OutCells.Num() - Length, uint8(Level * 17), Length);
+	}
+
+	return OutCells.Num() == NumCells;
+}
@@ -0,0 +1,161 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/NetSerialization.h"
+#include "BlastableNet.generated.h"
+
+class UBlastableComponent;
+struct FBlastableNetEventArray;
+
+/**
+ * A blast as it travels through the network. Positions are stored in the space of the piece that was
+ * hit, so they land on the same spot of the armor no matter how the target is posed on each machine.
+ * The payload is 11 bytes: piece, position, radius, time and damage epoch.
+ */
+USTRUCT()
+struct FBlastableNetEvent : public FFastArraySerializerItem
+{
+	GENERATED_BODY()
+
+	/** Piece that was hit is not known, `X`, `Y` and `Z` are relative to the owner actor */
+	static constexpr uint8 NoPiece = 255;
+
+	/** Centimeters per unit of the quantized position */
+	static constexpr float PositionScale = 1.f / 16.f;
+
+	/** Centimeters per unit of the quantized radius */
+	static constexpr float RadiusScale = 0.5f;
+
+	/** Seconds per unit of the quantized time */
+	static constexpr float TimeScale = 0.1f;
+
+	/** Index of the piece in the blastable meshes of the target, or `NoPiece` */
+	UPROPERTY()
+	uint8 Piece = NoPiece;
+
+	/** Quantized position in the space of the piece */
+	UPROPERTY()
+	int16 X = 0;
+
+	UPROPERTY()
+	int16 Y = 0;
+
+	UPROPERTY()
+	int16 Z = 0;
+
+	/** Quantized radius of the blast */
+	UPROPERTY()
+	uint8 Radius = 0;
+
+	/** Quantized server time of the blast, wraps around every couple of hours */
+	UPROPERTY()
+	uint16 Time = 0;
+
+	/** Damage reset of the server this blast happened after, so clients reset before applying it */
+	UPROPERTY()
+	uint8 Epoch = 0;
+
+	/** Position in the space of the piece, in centimeters */
+	FVector GetLocalPosition() const { return FVector(X, Y, Z) * PositionScale; }
+
+	/** Radius in centimeters */
+	float GetRadius() const { return Radius * RadiusScale; }
+
+	/// <summary>
+	/// Fill the quantized fields. Positions are clamped to +-2048 cm and radii to 127 cm.
+	/// </summary>
+	void Set(uint8 InPiece, const FVector& LocalPosition, float InRadius, float ServerTime);
+
+	/// <summary>
+	/// Seconds since this event happened, handling wrap around of the quantized time
+	/// </summary>
+	float GetAge(float ServerTime) const;
+
+	/// <summary>
+	/// Grow this event to cover an overlapping blast on the same piece, keeping the latest time
+	/// </summary>
+	/// <returns> False if the blasts don't overlap or can't be covered by a single event </returns>
+	bool Absorb(const FBlastableNetEvent& Other);
+
+	/** Apply the event as soon as it arrives on a client */
+	void PostReplicatedAdd(const FBlastableNetEventArray& InArraySerializer);
+};
+
+/**
+ * Recent blasts of a blastable. Only events added since the last update of a client are sent, and
+ * events are dropped once clients had enough time to receive them, so the cost of a blastable is
+ * the same no matter how long it has been taking damage.
+ */
+USTRUCT()
+struct FBlastableNetEventArray : public FFastArraySerializer
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<FBlastableNetEvent> Items;
+
+	/** Blastable that owns this array, used to apply events as they arrive */
+	UBlastableComponent* Owner = nullptr;
+
+	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
+	{
+		return FFastArraySerializer::FastArrayDeltaSerialize<FBlastableNetEvent, FBlastableNetEventArray>(Items, DeltaParms, *this);
+	}
+};
+
+template<>
+struct TStructOpsTypeTraits<FBlastableNetEventArray> : public TStructOpsTypeTraitsBase2<FBlastableNetEventArray>
+{
+	enum
+	{
+		WithNetDeltaSerializer = true,
+	};
+};
+
+/**
+ * Armor a shot fired by a client hit on the server. Clients roll back the predictions of their shots
+ * that have none, or have one somewhere else.
+ */
+USTRUCT()
+struct FBlastableShotHit
+{
+	GENERATED_BODY()
+
+	/** Id the client gave to the shot */
+	UPROPERTY()
+	uint16 ShotId = 0;
+
+	/** Blastable whose armor was hit */
+	UPROPERTY()
+	UBlastableComponent* Blastable = nullptr;
+
+	/** Where the armor was hit, in world space */
+	UPROPERTY()
+	FVector_NetQuantize Location = FVector::ZeroVector;
+};
+
+/**
+ * Compact encoding of damage for clients that start receiving a blastable late
+ */
+namespace BlastableNet
+{
+	/// <summary>
+	/// Run length encode damage cells. Cells are quantized to 16 levels first, so soft edges of
+	/// holes don't break runs. Every run is a level in the high nibble and a length in the low
+	/// nibble, with a zero length meaning the next byte holds the length minus 16.
+	/// </summary>
+	/// <param name="Cells"> Damage cells, 0 undamaged to 255 destroyed </param>
+	/// <param name="OutBytes"> Encoded cells </param>
+	ARMORBLASTING_API void EncodeCells(const TArray<uint8>& Cells, TArray<uint8>& OutBytes);
+
+	/// <summary>
+	/// Decode cells encoded with `EncodeCells`
+	/// </summary>
+	/// <param name="Bytes"> Encoded cells </param>
+	/// <param name="NumCells"> Amount of cells expected </param>
+	/// <param name="OutCells"> Decoded cells, resized to `NumCells` </param>
+	/// <returns> False if the data was malformed </returns>
+	ARMORBLASTING_API bool DecodeCells(const TArray<uint8>& Bytes, int32 NumCells, TArray<uint8>& OutCells);
+}
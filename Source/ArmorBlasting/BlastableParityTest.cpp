@@ -0,0 +1,264 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "BlastableCore.h"
+#include "BlastableCpuDamage.h"
+#include "BlastableDamageGrid.h"
+#include "BlastableDamageQuery.h"
+#include "BlastableDamageRenderer.h"
+#include "BlastableDamageTilePool.h"
+#include "BlastableTypes.h"
+#include "Engine/Engine.h"
+#include "Engine/Texture2D.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "Engine/World.h"
+#include "Misc/App.h"
+#include "RenderingThread.h"
+
+namespace
+{
+	/** Texels per side of the damage maps, the test piece is a plane with one texel per centimeter */
+	const int32 MapResolution = 256;
+
+	/** Cells per side of the integrity grid, same as blastables use by default */
+	const int32 GridResolution = 128;
+
+	/** Texels per side of the damage mirror */
+	const int32 MirrorResolution = 64;
+
+	/** Damage every hit adds, below one so that only repeated hits breach, like layered armor */
+	const float Erosion = 0.5f;
+
+	/** Largest difference allowed between the breached fractions of the layout two backends report */
+	const float BreachTolerance = 0.01f;
+
+	/** Largest average difference allowed between the damage of two backends, per texel */
+	const float DamageTolerance = 0.03f;
+
+	struct FParityHit
+	{
+		FVector2D UV;
+		float UVRadius;
+	};
+
+	/** The same hits for every backend, overlapping and repeated so every erosion layer shows up */
+	TArray<FParityHit> MakeHits()
+	{
+		FRandomStream Random(1234);
+		TArray<FParityHit> Hits;
+		for (int32 i = 0; i < 24; i++)
+		{
+			FParityHit Hit;
+			Hit.UV = FVector2D(Random.FRandRange(0.1f, 0.9f), Random.FRandRange(0.1f, 0.9f));
+			Hit.UVRadius = Random.FRandRange(4.f, 12.f) / MapResolution;
+			Hits.Add(Hit);
+			if (i % 2 == 0)
+				Hits.Add(Hit);
+		}
+		return Hits;
+	}
+
+	/** Breached fraction of a damage map */
+	float GetBreachedFraction(const TArray<uint8>& Texels)
+	{
+		float Breached = 0.f;
+		for (auto const Texel : Texels)
+			Breached += BlastableErosion::GetBreach(Texel / 255.f);
+		return Texels.Num() > 0 ? Breached / Texels.Num() : 0.f;
+	}
+
+	/** Average a square damage map down to a smaller one, like the GPU does for the mirror */
+	TArray<uint8> Downsample(const TArray<uint8>& Texels, int32 Resolution, int32 NewResolution)
+	{
+		const int32 Ratio = Resolution / NewResolution;
+		TArray<uint8> Result;
+		Result.SetNumZeroed(NewResolution * NewResolution);
+		for (int32 Y = 0; Y < NewResolution; Y++)
+		{
+			for (int32 X = 0; X < NewResolution; X++)
+			{
+				int32 Sum = 0;
+				for (int32 SubY = 0; SubY < Ratio; SubY++)
+				{
+					for (int32 SubX = 0; SubX < Ratio; SubX++)
+						Sum += Texels[(Y * Ratio + SubY) * Resolution + X * Ratio + SubX];
+				}
+				Result[Y * NewResolution + X] = uint8(Sum / (Ratio * Ratio));
+			}
+		}
+		return Result;
+	}
+
+	/** Average absolute difference between two damage maps of the same size, in [0, 1] */
+	float GetAverageDifference(const TArray<uint8>& A, const TArray<uint8>& B)
+	{
+		float Difference = 0.f;
+		for (int32 i = 0; i < A.Num(); i++)
+			Difference += FMath::Abs(A[i] - B[i]) / 255.f;
+		return A.Num() > 0 ? Difference / A.Num() : 0.f;
+	}
+
+	/** Stamp the hits through the CPU backend, and export its permanent damage */
+	TArray<uint8> StampCpu(const TArray<FParityHit>& Hits)
+	{
+		FBlastableDamageTilePool Pool;
+		Pool.Init(FMath::Square(MapResolution / FBlastableDamageTilePool::TileSize));
+
+		const FBox2D Bounds(FVector2D::ZeroVector, FVector2D::UnitVector);
+		FBlastableCpuDamage Damage;
+		Damage.Init(MapResolution, MakeArrayView(&Bounds, 1), &Pool);
+		for (auto const& Hit : Hits)
+			Damage.QueueStamp(0, Hit.UV, Hit.UVRadius, Erosion);
+		Damage.FlushStamps();
+
+		TArray<uint8> Texels;
+		Damage.Export(Texels);
+		Damage.Release();
+		return Texels;
+	}
+
+	/** Stamp the hits into the integrity grid both backends estimate destroyed armor with */
+	void StampGrid(const TArray<FParityHit>& Hits, FBlastableDamageGrid& Grid)
+	{
+		Grid.Init(GridResolution);
+		for (auto const& Hit : Hits)
+			Grid.Stamp(Hit.UV, Hit.UVRadius, nullptr, Erosion);
+	}
+
+	/** Position map of a plane covering the whole layout, one centimeter per texel */
+	UTexture2D* CreatePlanePositionMap()
+	{
+		UTexture2D* Texture = UTexture2D::CreateTransient(MapResolution, MapResolution, PF_A32B32G32R32F);
+		if (Texture == nullptr)
+			return nullptr;
+
+		Texture->Filter = TF_Nearest;
+		Texture->SRGB = false;
+
+		auto& Mip = Texture->PlatformData->Mips[0];
+		FLinearColor* Texels = static_cast<FLinearColor*>(Mip.BulkData.Lock(LOCK_READ_WRITE));
+		for (int32 Y = 0; Y < MapResolution; Y++)
+		{
+			for (int32 X = 0; X < MapResolution; X++)
+				Texels[Y * MapResolution + X] = FLinearColor(X + 0.5f, Y + 0.5f, 0.f, 1.f);
+		}
+		Mip.BulkData.Unlock();
+		Texture->UpdateResource();
+		return Texture;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBlastableIntegrityParityTest, "ArmorBlasting.Blastable.Parity.Integrity", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FBlastableIntegrityParityTest::RunTest(const FString& Parameters)
+{
+	const TArray<FParityHit> Hits = MakeHits();
+	const TArray<uint8> CpuTexels = StampCpu(Hits);
+
+	FBlastableDamageGrid Grid;
+	StampGrid(Hits, Grid);
+
+	// Integrity estimates and the damage map must agree on how much armor is gone
+	const float GridBreached = GetBreachedFraction(Grid.GetCells());
+	const float CpuBreached = GetBreachedFraction(CpuTexels);
+	TestTrue(FString::Printf(TEXT("Integrity grid breached %.4f of the layout, CPU damage %.4f"), GridBreached, CpuBreached),
+		FMath::Abs(GridBreached - CpuBreached) <= BreachTolerance);
+
+	// And on the damage of the spots that were hit
+	const TArray<uint8> CpuCells = Downsample(CpuTexels, MapResolution, GridResolution);
+	const float Difference = GetAverageDifference(Grid.GetCells(), CpuCells);
+	TestTrue(FString::Printf(TEXT("Integrity grid and CPU damage differ by %.4f per cell"), Difference), Difference <= DamageTolerance);
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBlastableMirrorParityTest, "ArmorBlasting.Blastable.Parity.Mirror", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FBlastableMirrorParityTest::RunTest(const FString& Parameters)
+{
+	if (!FApp::CanEverRender() || GEngine == nullptr)
+	{
+		AddInfo(TEXT("Skipped, the GPU backend needs rendering"));
+		return true;
+	}
+
+	// Canvas draws of the mirror refresh need a world
+	UWorld* const World = UWorld::CreateWorld(EWorldType::Game, false);
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+
+	const TArray<FParityHit> Hits = MakeHits();
+	UTexture2D* const PositionMap = CreatePlanePositionMap();
+	UTextureRenderTarget2D* const Target = BlastableCore::CreateDamageRenderTarget(World, TEXT("ParityDamageTarget"), MapResolution, false, true);
+	Target->UpdateResourceImmediate(true);
+
+	UTextureRenderTarget2D* const MirrorTarget = NewObject<UTextureRenderTarget2D>(World);
+	MirrorTarget->RenderTargetFormat = ETextureRenderTargetFormat::RTF_RGBA8;
+	MirrorTarget->ClearColor = FColor::Black;
+	MirrorTarget->ResizeTarget(MirrorResolution, MirrorResolution);
+	FlushRenderingCommands();
+
+	// Stamp the same hits through the GPU backend, against the plane
+	TArray<FBlastableGpuStamp> Stamps;
+	for (auto const& Hit : Hits)
+	{
+		FBlastableGpuStamp& Stamp = Stamps.AddDefaulted_GetRef();
+		Stamp.UVBounds = FBox2D(FVector2D::ZeroVector, FVector2D::UnitVector);
+		Stamp.LocalPosition = FVector(Hit.UV * MapResolution, 0.f);
+		Stamp.Radius = Hit.UVRadius * MapResolution;
+		Stamp.Piece = 0;
+	}
+
+	auto const Renderer = FSceneViewExtensions::NewExtension<FBlastableDamageRenderer>();
+	Renderer->AddStamps(Target, PositionMap, Stamps, Erosion);
+	Renderer->Submit();
+
+	// Read the damage back through the mirror gameplay queries use, waiting for the GPU a bounded time
+	FBlastableDamageMirror Mirror;
+	Mirror.Initialize(MirrorResolution);
+	if (Mirror.RequestRefresh(Target, MirrorTarget))
+	{
+		const double Deadline = FPlatformTime::Seconds() + 5.0;
+		while (!Mirror.HasData() && FPlatformTime::Seconds() < Deadline)
+		{
+			FlushRenderingCommands();
+			Mirror.Tick();
+			FPlatformProcess::Sleep(0.01f);
+		}
+	}
+
+	if (!Mirror.HasData())
+	{
+		AddError(TEXT("The damage mirror never got a readback"));
+	}
+	else
+	{
+		const TArray<uint8> CpuTexels = Downsample(StampCpu(Hits), MapResolution, Mirror.GetResolution());
+		const float MirrorBreached = GetBreachedFraction(Mirror.GetTexels());
+		const float CpuBreached = GetBreachedFraction(CpuTexels);
+		TestTrue(FString::Printf(TEXT("GPU mirror breached %.4f of the layout, CPU damage %.4f"), MirrorBreached, CpuBreached),
+			FMath::Abs(MirrorBreached - CpuBreached) <= BreachTolerance);
+
+		const float Difference = GetAverageDifference(Mirror.GetTexels(), CpuTexels);
+		TestTrue(FString::Printf(TEXT("GPU mirror and CPU damage differ by %.4f per texel"), Difference), Difference <= DamageTolerance);
+
+		// Holes opened through gameplay come from the integrity grid, it must match what the GPU shows
+		FBlastableDamageGrid Grid;
+		StampGrid(Hits, Grid);
+		const float GridBreached = GetBreachedFraction(Grid.GetCells());
+		TestTrue(FString::Printf(TEXT("Integrity grid breached %.4f of the layout, GPU mirror %.4f"), GridBreached, MirrorBreached),
+			FMath::Abs(GridBreached - MirrorBreached) <= BreachTolerance);
+	}
+
+	Mirror.Release();
+	FlushRenderingCommands();
+	GEngine->DestroyWorldContext(World);
+	World->DestroyWorld(false);
+	return true;
+}
+
+#endif
@@ -0,0 +1,120 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BlastablePersistence.h"
+#include "BlastableComponent.h"
+#include "Kismet/GameplayStatics.h"
+
+void UBlastablePersistenceSubsystem::Deinitialize()
+{
+	Records.Empty();
+	LiveBlastables.Empty();
+	PendingRestores.Empty();
+
+	Super::Deinitialize();
+}
+
+void UBlastablePersistenceSubsystem::RegisterBlastable(UBlastableComponent* Blastable)
+{
+	LiveBlastables.Add(Blastable);
+	if (Records.Contains(Blastable->GetPersistentId()))
+		PendingRestores.AddUnique(Blastable);
+}
+
+void UBlastablePersistenceSubsystem::UnregisterBlastable(UBlastableComponent* Blastable, bool bKeepDamage)
+{
+	LiveBlastables.Remove(Blastable);
+	PendingRestores.Remove(Blastable);
+
+	const FString Id = Blastable->GetPersistentId();
+	if (!bKeepDamage)
+	{
+		Records.Remove(Id);
+		return;
+	}
+
+	// A blastable leaving before its record was restored still owns that record
+	FBlastableDamageRecord Record;
+	if (Blastable->CaptureDamageRecord(Record))
+		Records.Add(Id, MoveTemp(Record));
+}
+
+void UBlastablePersistenceSubsystem::SaveToSlot(const FString& SlotName, int32 UserIndex)
+{
+	auto const SaveGame = Cast<UBlastableSaveGame>(UGameplayStatics::CreateSaveGameObject(UBlastableSaveGame::StaticClass()));
+	if (SaveGame == nullptr)
+		return;
+
+	SaveGame->Records = Records;
+	for (auto const& Weak : LiveBlastables)
+	{
+		auto const Blastable = Weak.Get();
+		if (Blastable == nullptr || PendingRestores.Contains(Weak))
+			continue;
+
+		FBlastableDamageRecord Record;
+		if (Blastable->CaptureDamageRecord(Record))
+			SaveGame->Records.Add(Blastable->GetPersistentId(), MoveTemp(Record));
+	}
+
+	// Serialization is cheap next to the records, the file itself is written on a worker thread
+	UGameplayStatics::AsyncSaveGameToSlot(SaveGame, SlotName, UserIndex, FAsyncSaveGameToSlotDelegate::CreateLambda([](const FString& Slot, const int32, bool bSuccess)
+	{
+		if (!bSuccess)
+			UE_LOG(LogTemp, Warning, TEXT("Could not save blastable damage to slot %s"), *Slot);
+	}));
+}
+
+void UBlastablePersistenceSubsystem::LoadFromSlot(const FString& SlotName, int32 UserIndex)
+{
+	UGameplayStatics::AsyncLoadGameFromSlot(SlotName, UserIndex, FAsyncLoadGameFromSlotDelegate::CreateUObject(this, &UBlastablePersistenceSubsystem::OnSlotLoaded));
+}
+
+void UBlastablePersistenceSubsystem::OnSlotLoaded(const FString& SlotName, int32 UserIndex, USaveGame* SaveGame)
+{
+	auto const BlastableSave = Cast<UBlastableSaveGame>(SaveGame);
+	if (BlastableSave == nullptr)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Could not load blastable damage from slot %s"), *SlotName);
+		return;
+	}
+
+	Records = MoveTemp(BlastableSave->Records);
+
+	// Blastables already in the world take the saved damage instead of the one they have now
+	PendingRestores.Reset();
+	for (auto const& Weak : LiveBlastables)
+	{
+		auto const Blastable = Weak.Get();
+		if (Blastable == nullptr)
+			continue;
+
+		Blastable->ResetDamage();
+		if (Records.Contains(Blastable->GetPersistentId()))
+			PendingRestores.Add(Weak);
+	}
+}
+
+void UBlastablePersistenceSubsystem::Tick(float DeltaTime)
+{
+	int32 Restored = 0;
+	while (PendingRestores.Num() > 0 && Restored < MaxRestoresPerFrame)
+	{
+		auto const Blastable = PendingRestores[0].Get();
+		PendingRestores.RemoveAt(0, 1, false);
+		if (Blastable == nullptr)
+			continue;
+
+		// Once live, the blastable itself is the source of truth for its damage
+		FBlastableDamageRecord Record;
+		if (Records.RemoveAndCopyValue(Blastable->GetPersistentId(), Record))
+		{
+			Blastable->RestoreDamageRecord(Record);
+			Restored++;
+		}
+	}
+}
+
+TStatId UBlastablePersistenceSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UBlastablePersistenceSubsystem, STATGROUP_Tickables);
+}
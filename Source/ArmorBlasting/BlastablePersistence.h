@@ -0,0 +1,136 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/SaveGame.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "Tickable.h"
+#include "BlastablePersistence.generated.h"
+
+class UBlastableComponent;
+
+/**
+ * Damage of a single blastable, compact enough to keep hundreds of them in memory and on disk.
+ *
+ * Both the integrity grid and a low resolution copy of the damage map are stored as run length
+ * encoded 4 bit levels, the same encoding used to replicate damage snapshots. Armor mostly has
+ * long runs of undamaged texels, so a record usually takes a few hundred bytes.
+ */
+USTRUCT()
+struct ARMORBLASTING_API FBlastableDamageRecord
+{
+	GENERATED_BODY()
+
+	/** Bumped every time the layout of a record changes. Records from a newer version are ignored. */
+	static constexpr uint8 CurrentVersion = 1;
+
+	UPROPERTY()
+	uint8 Version = 0;
+
+	/** Cells per side of the integrity grid the record was taken from */
+	UPROPERTY()
+	int32 GridResolution = 0;
+
+	/** Encoded integrity grid */
+	UPROPERTY()
+	TArray<uint8> Cells;
+
+	/** Texels per side of the stored damage map, 0 if the map was not available */
+	UPROPERTY()
+	int32 MapResolution = 0;
+
+	/** Encoded damage map in the shared UV layout */
+	UPROPERTY()
+	TArray<uint8> Map;
+
+	/** Whether this record can be restored by this build */
+	bool IsValid() const { return Version > 0 && Version <= CurrentVersion && GridResolution > 0; }
+};
+
+/** Damage of every persistent blastable, written to disk by `UBlastablePersistenceSubsystem` */
+UCLASS()
+class ARMORBLASTING_API UBlastableSaveGame : public USaveGame
+{
+	GENERATED_BODY()
+
+public:
+	/** Records by persistent id of their blastable */
+	UPROPERTY()
+	TMap<FString, FBlastableDamageRecord> Records;
+};
+
+/**
+ * Keeps the damage of blastables with `bPersistDamage` alive while they are streamed out, and
+ * across save games.
+ *
+ * Blastables store a record when they leave the world and get it back when they begin play again.
+ * Records are restored a few blastables per frame, each one with a single texture upload and one
+ * draw per damage target, so streaming a level with many damaged enemies back in doesn't spike.
+ */
+UCLASS()
+class ARMORBLASTING_API UBlastablePersistenceSubsystem : public UGameInstanceSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	/// <summary>
+	/// Start tracking a blastable that began play, queuing the restore of its record if there is one
+	/// </summary>
+	void RegisterBlastable(UBlastableComponent* Blastable);
+
+	/// <summary>
+	/// Stop tracking a blastable that ended play
+	/// </summary>
+	/// <param name="Blastable"> Blastable leaving the world </param>
+	/// <param name="bKeepDamage"> Whether to store its damage for the next time it begins play, false
+	/// when it was destroyed for good </param>
+	void UnregisterBlastable(UBlastableComponent* Blastable, bool bKeepDamage);
+
+	/// <summary>
+	/// Write the damage of every persistent blastable, live or streamed out, to a save slot. Records
+	/// are encoded on the game thread, the file is written on a worker thread.
+	/// </summary>
+	/// <param name="SlotName"> Name of the save slot </param>
+	/// <param name="UserIndex"> Platform user the slot belongs to </param>
+	UFUNCTION(BlueprintCallable, Category = "ArmorBlasting")
+	void SaveToSlot(const FString& SlotName, int32 UserIndex = 0);
+
+	/// <summary>
+	/// Read the damage of every persistent blastable from a save slot on a worker thread, then
+	/// restore the blastables that are already in the world
+	/// </summary>
+	/// <param name="SlotName"> Name of the save slot </param>
+	/// <param name="UserIndex"> Platform user the slot belongs to </param>
+	UFUNCTION(BlueprintCallable, Category = "ArmorBlasting")
+	void LoadFromSlot(const FString& SlotName, int32 UserIndex = 0);
+
+	/** Forget every stored record, live blastables keep their damage */
+	UFUNCTION(BlueprintCallable, Category = "ArmorBlasting")
+	void ClearRecords() { Records.Reset(); }
+
+	// FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override { return PendingRestores.Num() > 0; }
+	virtual ETickableTickType GetTickableTickType() const override { return ETickableTickType::Conditional; }
+	virtual TStatId GetStatId() const override;
+	// End of FTickableGameObject interface
+
+protected:
+	/** Called on the game thread once a save slot was read */
+	void OnSlotLoaded(const FString& SlotName, int32 UserIndex, USaveGame* SaveGame);
+
+	/** Records of blastables not in the world, and the ones loaded from disk, by persistent id */
+	TMap<FString, FBlastableDamageRecord> Records;
+
+	/** Persistent blastables currently in the world */
+	TSet<TWeakObjectPtr<UBlastableComponent>> LiveBlastables;
+
+	/** Blastables waiting for their record to be restored, oldest first */
+	TArray<TWeakObjectPtr<UBlastableComponent>> PendingRestores;
+
+	/** Records restored every frame, bounding the uploads and draws done in a single frame */
+	int32 MaxRestoresPerFrame = 4;
+};
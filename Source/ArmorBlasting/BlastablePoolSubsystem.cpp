@@ -0,0 +1,84 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BlastablePoolSubsystem.h"
+#include "BlastableCharacter.h"
+#include "Engine/World.h"
+
+void UBlastablePoolSubsystem::Deinitialize()
+{
+	Pools.Empty();
+
+	Super::Deinitialize();
+}
+
+void UBlastablePoolSubsystem::Prewarm(TSubclassOf<ABlastableCharacter> Class, int32 Count)
+{
+	if (Class == nullptr)
+		return;
+
+	auto& Pool = Pools.FindOrAdd(Class.Get());
+	Pool.Free.Reserve(Count);
+
+	while (Pool.Free.Num() < Count)
+	{
+		auto Character = SpawnCharacter(Class, FTransform::Identity);
+		if (Character == nullptr)
+			return;
+
+		Character->OnReleasedToPool();
+		Pool.Free.Add(Character);
+	}
+}
+
+ABlastableCharacter* UBlastablePoolSubsystem::Acquire(TSubclassOf<ABlastableCharacter> Class, const FTransform& Transform)
+{
+	if (Class == nullptr)
+		return nullptr;
+
+	auto Pool = Pools.Find(Class.Get());
+	while (Pool != nullptr && Pool->Free.Num() > 0)
+	{
+		auto Character = Pool->Free.Pop(false);
+
+		// Parked characters might have been destroyed by something else, like a level transition
+		if (!IsValid(Character))
+			continue;
+
+		Character->SetActorTransform(Transform, false, nullptr, ETeleportType::ResetPhysics);
+		Character->OnAcquiredFromPool();
+		return Character;
+	}
+
+	// Pool ran dry, fall back to a regular spawn
+	return SpawnCharacter(Class, Transform);
+}
+
+void UBlastablePoolSubsystem::Release(ABlastableCharacter* Character)
+{
+	if (!IsValid(Character))
+		return;
+
+	auto& Pool = Pools.FindOrAdd(Character->GetClass());
+	if (Pool.Free.Contains(Character))
+		return;
+
+	Character->OnReleasedToPool();
+	Pool.Free.Add(Character);
+}
+
+int32 UBlastablePoolSubsystem::GetNumFree(TSubclassOf<ABlastableCharacter> Class) const
+{
+	auto Pool = Pools.Find(Class.Get());
+	return Pool != nullptr ? Pool->Free.Num() : 0;
+}
+
+ABlastableCharacter* UBlastablePoolSubsystem::SpawnCharacter(TSubclassOf<ABlastableCharacter> Class, const FTransform& Transform)
+{
+	UWorld* World = GetWorld();
+	if (World == nullptr)
+		return nullptr;
+
+	FActorSpawnParameters SpawnParameters;
+	SpawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	return World->SpawnActor<ABlastableCharacter>(Class, Transform, SpawnParameters);
+}
@@ -0,0 +1,73 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "BlastablePoolSubsystem.generated.h"
+
+class ABlastableCharacter;
+
+/** Parked characters of a single class */
+USTRUCT()
+struct FBlastableCharacterPool
+{
+	GENERATED_BODY()
+
+	/** Characters ready to be reused */
+	UPROPERTY()
+	TArray<ABlastableCharacter*> Free;
+};
+
+/**
+ * Pool of blastable characters for wave spawning.
+ *
+ * Setting up a blastable is expensive: it searches tagged meshes, sets up collision, creates render
+ * targets and dynamic material instances. The pool pays that cost while loading, by prewarming
+ * characters, and reuses them during gameplay with a single damage clear.
+ */
+UCLASS()
+class ARMORBLASTING_API UBlastablePoolSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	/// <summary>
+	/// Spawn characters of a class and park them, so that later acquires don't have to spawn anything
+	/// </summary>
+	/// <param name="Class"> Class of the characters to spawn </param>
+	/// <param name="Count"> How many characters of that class should be parked after this call </param>
+	UFUNCTION(BlueprintCallable, Category = "ArmorBlasting")
+	void Prewarm(TSubclassOf<ABlastableCharacter> Class, int32 Count);
+
+	/// <summary>
+	/// Get a character of the given class, reusing a parked one if possible
+	/// </summary>
+	/// <param name="Class"> Class of the character </param>
+	/// <param name="Transform"> Where to place the character </param>
+	/// <returns> An active character, or null if it could not be spawned </returns>
+	UFUNCTION(BlueprintCallable, Category = "ArmorBlasting")
+	ABlastableCharacter* Acquire(TSubclassOf<ABlastableCharacter> Class, const FTransform& Transform);
+
+	/// <summary>
+	/// Park a character so that it can be reused later
+	/// </summary>
+	/// <param name="Character"> Character to park, usually obtained with `Acquire` </param>
+	UFUNCTION(BlueprintCallable, Category = "ArmorBlasting")
+	void Release(ABlastableCharacter* Character);
+
+	/** Amount of parked characters of a class */
+	int32 GetNumFree(TSubclassOf<ABlastableCharacter> Class) const;
+
+protected:
+	/// <summary>
+	/// Spawn a new character, it will be active after this call
+	/// </summary>
+	ABlastableCharacter* SpawnCharacter(TSubclassOf<ABlastableCharacter> Class, const FTransform& Transform);
+
+	/** Parked characters per class */
+	UPROPERTY()
+	TMap<UClass*, FBlastableCharacterPool> Pools;
+};
@@ -0,0 +1,126 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BlastablePositionMap.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/Texture2D.h"
+#include "PhysicsEngine/BodySetup.h"
+
+namespace
+{
+	/** Twice the signed area of the triangle (A, B, C) */
+	float SignedArea2(const FVector2D& A, const FVector2D& B, const FVector2D& C)
+	{
+		return (B.X - A.X) * (C.Y - A.Y) - (C.X - A.X) * (B.Y - A.Y);
+	}
+
+	/** Write the interpolated position of every texel whose center lies inside the triangle */
+	void RasterizeTriangle(const FVector2D UVs[3], const FVector Positions[3], float PieceId, int32 Resolution, TArray<FLinearColor>& Texels)
+	{
+		const float Area = SignedArea2(UVs[0], UVs[1], UVs[2]);
+		if (FMath::IsNearlyZero(Area))
+			return;
+
+		const int32 MinX = FMath::Clamp(FMath::FloorToInt(FMath::Min3(UVs[0].X, UVs[1].X, UVs[2].X) * Resolution), 0, Resolution - 1);
+		const int32 MaxX = FMath::Clamp(FMath::FloorToInt(FMath::Max3(UVs[0].X, UVs[1].X, UVs[2].X) * Resolution), 0, Resolution - 1);
+		const int32 MinY = FMath::Clamp(FMath::FloorToInt(FMath::Min3(UVs[0].Y, UVs[1].Y, UVs[2].Y) * Resolution), 0, Resolution - 1);
+		const int32 MaxY = FMath::Clamp(FMath::FloorToInt(FMath::Max3(UVs[0].Y, UVs[1].Y, UVs[2].Y) * Resolution), 0, Resolution - 1);
+
+		for (int32 Y = MinY; Y <= MaxY; Y++)
+		{
+			for (int32 X = MinX; X <= MaxX; X++)
+			{
+				const FVector2D Center((X + 0.5f) / Resolution, (Y + 0.5f) / Resolution);
+				const float W0 = SignedArea2(UVs[1], UVs[2], Center) / Area;
+				const float W1 = SignedArea2(UVs[2], UVs[0], Center) / Area;
+				const float W2 = 1.f - W0 - W1;
+				if (W0 < 0.f || W1 < 0.f || W2 < 0.f)
+					continue;
+
+				const FVector Position = Positions[0] * W0 + Positions[1] * W1 + Positions[2] * W2;
+				Texels[Y * Resolution + X] = FLinearColor(Position.X, Position.Y, Position.Z, PieceId);
+			}
+		}
+	}
+
+	/** Grow pieces one texel into empty space, so stamps drawn at UV seams don't miss the edge texels */
+	void Dilate(int32 Resolution, TArray<FLinearColor>& Texels)
+	{
+		const TArray<FLinearColor> Source = Texels;
+		for (int32 Y = 0; Y < Resolution; Y++)
+		{
+			for (int32 X = 0; X < Resolution; X++)
+			{
+				if (Source[Y * Resolution + X].A > 0.f)
+					continue;
+
+				for (const FIntPoint& Offset : { FIntPoint(1, 0), FIntPoint(-1, 0), FIntPoint(0, 1), FIntPoint(0, -1) })
+				{
+					const int32 NX = X + Offset.X;
+					const int32 NY = Y + Offset.Y;
+					if (NX < 0 || NY < 0 || NX >= Resolution || NY >= Resolution || Source[NY * Resolution + NX].A <= 0.f)
+						continue;
+
+					Texels[Y * Resolution + X] = Source[NY * Resolution + NX];
+					break;
+				}
+			}
+		}
+	}
+}
+
+UTexture2D* BlastablePositionMap::Bake(const TArray<UStaticMeshComponent*>& Pieces, int32 Resolution, UObject* Outer)
+{
+	Resolution = FMath::Max(Resolution, 1);
+
+	TArray<FLinearColor> Texels;
+	Texels.Init(FLinearColor::Transparent, Resolution * Resolution);
+
+	bool bAnyPiece = false;
+	for (int i = 0; i < Pieces.Num(); i++)
+	{
+		const UBodySetup* BodySetup = Pieces[i] != nullptr ? Pieces[i]->GetBodySetup() : nullptr;
+		if (BodySetup == nullptr || BodySetup->UVInfo.VertUVs.Num() == 0)
+			continue;
+
+		// Collision data is stored in mesh space, which is the space hits get converted into
+		const FBodySetupUVInfo& UVInfo = BodySetup->UVInfo;
+		const TArray<FVector2D>& UVs = UVInfo.VertUVs[0];
+		for (int32 Index = 0; Index + 2 < UVInfo.IndexBuffer.Num(); Index += 3)
+		{
+			const int32 I0 = UVInfo.IndexBuffer[Index], I1 = UVInfo.IndexBuffer[Index + 1], I2 = UVInfo.IndexBuffer[Index + 2];
+			if (!UVs.IsValidIndex(FMath::Max3(I0, I1, I2)) || !UVInfo.VertPositions.IsValidIndex(FMath::Max3(I0, I1, I2)))
+				continue;
+
+			const FVector2D TriangleUVs[3] = { UVs[I0], UVs[I1], UVs[I2] };
+			const FVector TrianglePositions[3] = { UVInfo.VertPositions[I0], UVInfo.VertPositions[I1], UVInfo.VertPositions[I2] };
+			RasterizeTriangle(TriangleUVs, TrianglePositions, float(i + 1), Resolution, Texels);
+		}
+
+		bAnyPiece = true;
+	}
+
+	if (!bAnyPiece)
+		return nullptr;
+
+	Dilate(Resolution, Texels);
+
+	UTexture2D* Texture = UTexture2D::CreateTransient(Resolution, Resolution, PF_A32B32G32R32F);
+	if (Texture == nullptr)
+		return nullptr;
+
+	if (Outer != nullptr)
+		Texture->Rename(nullptr, Outer, REN_DontCreateRedirectors | REN_DoNotDirty);
+
+	Texture->Filter = TF_Nearest;
+	Texture->SRGB = false;
+	Texture->AddressX = TA_Clamp;
+	Texture->AddressY = TA_Clamp;
+
+	auto& Mip = Texture->PlatformData->Mips[0];
+	void* Data = Mip.BulkData.Lock(LOCK_READ_WRITE);
+	FMemory::Memcpy(Data, Texels.GetData(), Texels.Num() * sizeof(FLinearColor));
+	Mip.BulkData.Unlock();
+	Texture->UpdateResource();
+
+	return Texture;
+}
@@ -0,0 +1,29 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UTexture2D;
+class UStaticMeshComponent;
+
+/**
+ * Texture over the shared armor UV layout storing, for every texel, where it lies on its piece.
+ *
+ * Armor pieces are rigid and attached to bones, so the space of a piece is the space of its bone
+ * up to a constant offset, and it doesn't change with animation. Texels store the piece space
+ * position in rgb and the piece index plus one in alpha, zero meaning no piece. Stamping against
+ * this map instead of capturing the posed armor keeps holes in place no matter the animation frame.
+ */
+namespace BlastablePositionMap
+{
+	/// <summary>
+	/// Bake the position map of a set of armor pieces from the UV data of their collision bodies.
+	/// Requires 'Support UV From Hit Results' in the physics settings.
+	/// </summary>
+	/// <param name="Pieces"> Armor pieces, their index in this array is what the map stores </param>
+	/// <param name="Resolution"> Width and height of the map </param>
+	/// <param name="Outer"> Outer of the texture </param>
+	/// <returns> Float texture with the map, or null if no piece had UV data </returns>
+	ARMORBLASTING_API UTexture2D* Bake(const TArray<UStaticMeshComponent*>& Pieces, int32 Resolution, UObject* Outer);
+}
@@ -0,0 +1,123 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BlastablePreload.h"
+#include "BlastableCore.h"
+#include "BlastableSubsystem.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "Misc/App.h"
+#include "ShaderPipelineCache.h"
+
+namespace
+{
+	/** Width and height of the scratch targets, warm ups only care about formats */
+	const int32 ScratchTargetSize = 32;
+}
+
+void UBlastablePreloadSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	// Nothing is drawn while loading, precompile what earlier sessions recorded as fast as possible
+	auto const World = GetWorld();
+	if (FApp::CanEverRender() && World != nullptr && World->IsGameWorld())
+	{
+		FShaderPipelineCache::SetBatchMode(FShaderPipelineCache::BatchMode::Fast);
+		bFastBatching = true;
+	}
+}
+
+void UBlastablePreloadSubsystem::Deinitialize()
+{
+	if (bFastBatching)
+		FShaderPipelineCache::SetBatchMode(FShaderPipelineCache::BatchMode::Background);
+	bFastBatching = false;
+
+	if (bWarmedUpSinceSave)
+		FShaderPipelineCache::SavePipelineFileCache(FPipelineFileCache::SaveMode::Incremental);
+	bWarmedUpSinceSave = false;
+
+	for (auto const& Handle : Handles)
+		Handle->ReleaseHandle();
+	Handles.Empty();
+	Requested.Empty();
+	WarmedUpClasses.Empty();
+
+	Super::Deinitialize();
+}
+
+void UBlastablePreloadSubsystem::Preload(TArray<FSoftObjectPath> Assets, FStreamableDelegate OnLoaded)
+{
+	check(IsInGameThread());
+
+	// Handles of earlier requests already keep known assets loaded
+	bool bNewAssets = false;
+	Assets.RemoveAll([](const FSoftObjectPath& Asset) { return Asset.IsNull(); });
+	for (auto const& Asset : Assets)
+	{
+		bool bAlreadyRequested = false;
+		Requested.Add(Asset, &bAlreadyRequested);
+		bNewAssets |= !bAlreadyRequested;
+	}
+
+	if (Assets.Num() == 0 || (!bNewAssets && !OnLoaded.IsBound()))
+	{
+		OnLoaded.ExecuteIfBound();
+		return;
+	}
+
+	auto Handle = StreamableManager.RequestAsyncLoad(MoveTemp(Assets), MoveTemp(OnLoaded), FStreamableManager::AsyncLoadHighPriority);
+	if (Handle.IsValid() && bNewAssets)
+		Handles.Add(MoveTemp(Handle));
+}
+
+bool UBlastablePreloadSubsystem::ClaimWarmUp(const UClass* Class)
+{
+	bool bAlreadyWarmedUp = false;
+	WarmedUpClasses.Add(Class, &bAlreadyWarmedUp);
+	bWarmedUpSinceSave |= !bAlreadyWarmedUp;
+	return !bAlreadyWarmedUp;
+}
+
+UTextureRenderTarget2D* UBlastablePreloadSubsystem::GetScratchTarget(bool bFading)
+{
+	auto& Target = bFading ? FadingScratchTarget : ScratchTarget;
+	if (Target == nullptr)
+	{
+		// Mip passes are part of what the damage renderer warms up
+		auto const Blastables = GetWorld() != nullptr ? GetWorld()->GetSubsystem<UBlastableSubsystem>() : nullptr;
+		const bool bMips = Blastables != nullptr && Blastables->GetDamageRenderer() != nullptr;
+		Target = BlastableCore::CreateDamageRenderTarget(this, bFading ? TEXT("FadingScratchTarget") : TEXT("ScratchTarget"), ScratchTargetSize, bFading, bMips);
+	}
+	return Target;
+}
+
+void UBlastablePreloadSubsystem::Tick(float DeltaTime)
+{
+	// Switching back and saving happen once, the game may pick another batch mode afterwards
+	if (!bFastBatching)
+		return;
+
+	// Loading settled once every preload landed and nothing recorded is left to precompile
+	for (auto const& Handle : Handles)
+	{
+		if (Handle->IsLoadingInProgress())
+			return;
+	}
+	if (FShaderPipelineCache::NumPrecompilesRemaining() > 0)
+		return;
+
+	FShaderPipelineCache::SetBatchMode(FShaderPipelineCache::BatchMode::Background);
+	bFastBatching = false;
+
+	// Record what the warm ups created, so the next session precompiles it while loading
+	if (bWarmedUpSinceSave)
+	{
+		FShaderPipelineCache::SavePipelineFileCache(FPipelineFileCache::SaveMode::Incremental);
+		bWarmedUpSinceSave = false;
+	}
+}
+
+TStatId UBlastablePreloadSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UBlastablePreloadSubsystem, STATGROUP_Tickables);
+}
@@ -0,0 +1,99 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "Engine/StreamableManager.h"
+#include "BlastablePreload.generated.h"
+
+class UTextureRenderTarget2D;
+
+/**
+ * Gets blasting assets ready before the first shot instead of during it.
+ *
+ * Blastables and weapons reference their materials and effects softly, and ask for them here as soon
+ * as they are registered, so they stream in asynchronously while the level loads. The first blastable
+ * of every class then draws a stamp and a fade into scratch targets of the same formats as its damage
+ * targets, so shaders, pipeline states and render target resources are created during loading too.
+ *
+ * Pipeline states recorded by earlier sessions are precompiled in fast batches until loading settles,
+ * and the ones created by warm ups are saved to the pipeline cache when logging is enabled.
+ */
+UCLASS()
+class ARMORBLASTING_API UBlastablePreloadSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	/// <summary>
+	/// Start loading assets asynchronously, keeping them loaded for as long as the world lives. Game thread only.
+	/// </summary>
+	/// <param name="Assets"> Assets to load, null paths are skipped </param>
+	/// <param name="OnLoaded"> Called once every asset is loaded, maybe right away if they already are </param>
+	void Preload(TArray<FSoftObjectPath> Assets, FStreamableDelegate OnLoaded = FStreamableDelegate());
+
+	/// <summary>
+	/// Get an asset that should have been preloaded, loading it right away if it didn't make it in time
+	/// </summary>
+	/// <returns> The asset, or null if it isn't set </returns>
+	template <typename T>
+	static T* Resolve(const TSoftObjectPtr<T>& Asset)
+	{
+		if (Asset.IsNull() || Asset.Get() != nullptr)
+			return Asset.Get();
+
+		UE_LOG(LogTemp, Log, TEXT("%s was not preloaded in time, loading it now"), *Asset.ToString());
+		return Asset.LoadSynchronous();
+	}
+
+	/// <summary>
+	/// Claim the rendering warm up of a class. Only the first blastable of every class warms up.
+	/// </summary>
+	/// <returns> True if the caller should warm up, false if it already happened </returns>
+	bool ClaimWarmUp(const UClass* Class);
+
+	/// <summary>
+	/// Get a small render target to warm up draws with, created on first use
+	/// </summary>
+	/// <param name="bFading"> Whether it should have the format of fading damage targets </param>
+	UTextureRenderTarget2D* GetScratchTarget(bool bFading);
+
+	// FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override { return bFastBatching; }
+	virtual ETickableTickType GetTickableTickType() const override { return ETickableTickType::Conditional; }
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	// End of FTickableGameObject interface
+
+protected:
+	/** Loads every preload goes through */
+	FStreamableManager StreamableManager;
+
+	/** Handles keeping preloaded assets in memory */
+	TArray<TSharedPtr<FStreamableHandle>> Handles;
+
+	/** Every asset requested so far */
+	TSet<FSoftObjectPath> Requested;
+
+	/** Classes whose first blastable already warmed up */
+	TSet<TWeakObjectPtr<const UClass>> WarmedUpClasses;
+
+	/** Scratch targets warm ups draw into, with the format of regular and fading damage targets */
+	UPROPERTY(Transient)
+	UTextureRenderTarget2D* ScratchTarget;
+
+	UPROPERTY(Transient)
+	UTextureRenderTarget2D* FadingScratchTarget;
+
+	/** Set while recorded pipeline states are precompiled in fast batches, until loading settles */
+	bool bFastBatching = false;
+
+	/** Whether a warm up happened since pipeline states were last saved */
+	bool bWarmedUpSinceSave = false;
+};
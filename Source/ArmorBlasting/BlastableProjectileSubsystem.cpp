@@ -0,0 +1,180 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BlastableProjectileSubsystem.h"
+#include "BlastableComponent.h"
+#include "BlastableInstancedComponent.h"
+#include "BlastableSubsystem.h"
+#include "BlastableTrace.h"
+#include "BlastableScalability.h"
+#include "Engine/World.h"
+#include "Async/ParallelFor.h"
+
+void UBlastableProjectileSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	// Allocate every slot up front, firing and expiring projectiles never touches the allocator
+	Positions.SetNumUninitialized(MaxProjectiles);
+	Velocities.SetNumUninitialized(MaxProjectiles);
+	Ages.SetNumUninitialized(MaxProjectiles);
+	ImpactRadii.SetNumUninitialized(MaxProjectiles);
+	Instigators.SetNum(MaxProjectiles);
+	ImpactEffectIndices.SetNumUninitialized(MaxProjectiles);
+	Weapons.SetNum(MaxProjectiles);
+	ShotIds.SetNumUninitialized(MaxProjectiles);
+	TraceHits.SetNum(MaxProjectiles);
+	TraceHitFlags.SetNumZeroed(MaxProjectiles);
+
+	// Slot 0 means no effect
+	ImpactEffects.Add(nullptr);
+}
+
+void UBlastableProjectileSubsystem::Deinitialize()
+{
+	NumActive = 0;
+	ImpactEffects.Empty();
+
+	Super::Deinitialize();
+}
+
+bool UBlastableProjectileSubsystem::FireProjectile(FVector Origin, FVector Velocity, float ImpactRadius, AActor* Instigator, UNiagaraSystem* ImpactEffect, FName Weapon, int32 ShotId)
+{
+	// The client that predicted the shot must hear about it, even if it never flies
+	if (NumActive >= BlastableScalability::GetMaxTrackedHits())
+	{
+		if (GetWorld() != nullptr && GetWorld()->GetNetMode() != NM_Client)
+			OnProjectileResolved.Broadcast(Instigator, uint16(ShotId), nullptr, Origin);
+		return false;
+	}
+
+	// Weapons use a handful of effects, a linear search is fine
+	int32 EffectIndex = ImpactEffects.Find(ImpactEffect);
+	if (EffectIndex == INDEX_NONE)
+	{
+		if (ImpactEffects.Num() > MAX_uint8)
+			EffectIndex = 0;
+		else
+			EffectIndex = ImpactEffects.Add(ImpactEffect);
+	}
+
+	const int32 Slot = NumActive++;
+	Positions[Slot] = Origin;
+	Velocities[Slot] = Velocity;
+	Ages[Slot] = 0.f;
+	ImpactRadii[Slot] = ImpactRadius;
+	Instigators[Slot] = Instigator;
+	ImpactEffectIndices[Slot] = static_cast<uint8>(EffectIndex);
+	Weapons[Slot] = Weapon;
+	ShotIds[Slot] = uint16(ShotId);
+	return true;
+}
+
+void UBlastableProjectileSubsystem::Tick(float DeltaTime)
+{
+	UWorld* World = GetWorld();
+	if (World == nullptr || NumActive == 0)
+		return;
+
+	const FVector Gravity(0.f, 0.f, World->GetGravityZ());
+	auto const MakeQueryParams = [this](int32 i)
+	{
+		FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(BlastableProjectile), true);
+		QueryParams.bReturnFaceIndex = true;
+		QueryParams.AddIgnoredActor(Instigators[i].Get());
+		return QueryParams;
+	};
+
+	// Sweep all projectiles in parallel. Scene queries are read only, which is all this does: damage
+	// is written by the game thread, so whether a hit landed on a hole is only asked after the sweep.
+	ParallelFor(NumActive, [this, World, DeltaTime, &Gravity, &MakeQueryParams](int32 i)
+	{
+		const FVector Start = Positions[i];
+		const FVector End = Start + Velocities[i] * DeltaTime + 0.5f * Gravity * DeltaTime * DeltaTime;
+		TraceHitFlags[i] = World->LineTraceSingleByChannel(TraceHits[i], Start, End, ECC_Enemy, MakeQueryParams(i));
+	});
+
+	// Few projectiles land on holes, the ones that do carry on from the game thread
+	for (int32 i = 0; i < NumActive; i++)
+	{
+		auto const HitBlastable = TraceHitFlags[i] ? BlastableTrace::GetHitBlastable(TraceHits[i]) : nullptr;
+		if (HitBlastable == nullptr || !HitBlastable->IsHoleAt(TraceHits[i]))
+			continue;
+
+		const FVector Start = Positions[i];
+		const FVector End = Start + Velocities[i] * DeltaTime + 0.5f * Gravity * DeltaTime * DeltaTime;
+		FCollisionQueryParams QueryParams = MakeQueryParams(i);
+		QueryParams.AddIgnoredComponent(TraceHits[i].GetComponent());
+		TraceHitFlags[i] = BlastableTrace::LineTraceThroughHoles(World, TraceHits[i], Start, End, QueryParams);
+	}
+
+	auto const BlastableSubsystem = World->GetSubsystem<UBlastableSubsystem>();
+
+	// Armor damage is server authoritative, projectiles simulated on clients only predict it
+	const bool bCanBlastArmor = World->GetNetMode() != NM_Client;
+
+	// Walk backwards so that recycled slots are always filled with projectiles we already processed
+	for (int32 i = NumActive - 1; i >= 0; i--)
+	{
+		if (TraceHitFlags[i])
+		{
+			const FHitResult& Hit = TraceHits[i];
+			auto const Blastable = BlastableTrace::GetHitBlastable(Hit);
+			if (Blastable != nullptr)
+			{
+				if (!bCanBlastArmor)
+					Blastable->PredictBlast(Hit, ImpactRadii[i], ShotIds[i]);
+				else if (BlastableSubsystem != nullptr)
+					BlastableSubsystem->SubmitBlast(Blastable, Hit, ImpactRadii[i], Weapons[i]);
+			}
+			else if (auto const Instanced = Cast<UBlastableInstancedComponent>(Hit.GetComponent()))
+				Instanced->Blast(Hit, ImpactRadii[i]);
+
+			if (bCanBlastArmor)
+				OnProjectileResolved.Broadcast(Instigators[i].Get(), ShotIds[i], Blastable, Hit.Location);
+
+			auto const Effect = ImpactEffects[ImpactEffectIndices[i]];
+			if (Effect != nullptr && BlastableSubsystem != nullptr && Hit.Actor.IsValid() && Hit.Actor->FindComponentByClass<UBlastableComponent>() != nullptr)
+				BlastableSubsystem->SpawnImpactEffect(Effect, Hit.Location, Hit.ImpactNormal.Rotation());
+
+			RemoveProjectile(i);
+			continue;
+		}
+
+		Ages[i] += DeltaTime;
+		if (Ages[i] > ProjectileLifeSpan)
+		{
+			if (bCanBlastArmor)
+				OnProjectileResolved.Broadcast(Instigators[i].Get(), ShotIds[i], nullptr, Positions[i]);
+			RemoveProjectile(i);
+			continue;
+		}
+
+		Positions[i] += Velocities[i] * DeltaTime + 0.5f * Gravity * DeltaTime * DeltaTime;
+		Velocities[i] += Gravity * DeltaTime;
+	}
+
+	// Make impacts visible this frame, no matter if the blast queue already ticked
+	if (BlastableSubsystem != nullptr)
+		BlastableSubsystem->FlushBlasts();
+}
+
+void UBlastableProjectileSubsystem::RemoveProjectile(int32 Index)
+{
+	const int32 Last = --NumActive;
+	if (Index == Last)
+		return;
+
+	Positions[Index] = Positions[Last];
+	Velocities[Index] = Velocities[Last];
+	Ages[Index] = Ages[Last];
+	ImpactRadii[Index] = ImpactRadii[Last];
+	Instigators[Index] = Instigators[Last];
+	ImpactEffectIndices[Index] = ImpactEffectIndices[Last];
+	Weapons[Index] = Weapons[Last];
+	ShotIds[Index] = ShotIds[Last];
+}
+
+TStatId UBlastableProjectileSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UBlastableProjectileSubsystem, STATGROUP_Tickables);
+}
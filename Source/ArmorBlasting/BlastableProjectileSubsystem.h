@@ -0,0 +1,93 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "BlastableProjectileSubsystem.generated.h"
+
+class UNiagaraSystem;
+class UBlastableComponent;
+
+/** Instigator, shot id, blastable whose armor was hit or null, and impact location of a projectile the server resolved */
+DECLARE_MULTICAST_DELEGATE_FourParams(FOnBlastableProjectileResolved, AActor*, uint16, UBlastableComponent*, const FVector&);
+
+/**
+ * Simulates every bullet-like projectile of a world as plain data.
+ *
+ * Projectiles live in preallocated contiguous arrays instead of being one actor each, so firing
+ * and expiring them never spawns or destroys anything. Every tick all projectiles are swept in
+ * parallel, and the ones that hit armor are routed into `UBlastableComponent` through the
+ * thread safe blast queue of `UBlastableSubsystem`.
+ */
+UCLASS()
+class ARMORBLASTING_API UBlastableProjectileSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	/// <summary>
+	/// Fire a new projectile
+	/// </summary>
+	/// <param name="Origin"> Where the projectile starts in world space </param>
+	/// <param name="Velocity"> Initial velocity in cm/s </param>
+	/// <param name="ImpactRadius"> Size of the hole the projectile makes when it hits armor </param>
+	/// <param name="Instigator"> Actor that fired the projectile, it will be ignored by its traces </param>
+	/// <param name="ImpactEffect"> Effect to spawn where the projectile hits armor, can be null </param>
+	/// <param name="Weapon"> Weapon that fired the projectile, recorded by blast telemetry </param>
+	/// <param name="ShotId"> Id of the shot, predictions on clients and resolutions on the server carry it </param>
+	/// <returns> False if there are too many projectiles in flight already </returns>
+	UFUNCTION(BlueprintCallable, Category = "ArmorBlasting")
+	bool FireProjectile(FVector Origin, FVector Velocity, float ImpactRadius, AActor* Instigator, UNiagaraSystem* ImpactEffect, FName Weapon = NAME_None, int32 ShotId = 0);
+
+	/** Called on the server when a projectile hits something or expires, so its instigator can tell the client that predicted it */
+	FOnBlastableProjectileResolved OnProjectileResolved;
+
+	/** Amount of projectiles currently in flight */
+	int32 GetNumActiveProjectiles() const { return NumActive; }
+
+	// FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override { return NumActive > 0; }
+	virtual ETickableTickType GetTickableTickType() const override { return ETickableTickType::Conditional; }
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	// End of FTickableGameObject interface
+
+	/** Maximum amount of projectiles in flight at the same time */
+	static constexpr int32 MaxProjectiles = 2048;
+
+	/** How long in seconds a projectile lives if it doesn't hit anything */
+	static constexpr float ProjectileLifeSpan = 3.f;
+
+protected:
+	/// <summary>
+	/// Recycle the slot of a projectile by moving the last active projectile into it
+	/// </summary>
+	void RemoveProjectile(int32 Index);
+
+	// Projectile state, one entry per slot. Only the first `NumActive` slots are in use.
+	TArray<FVector> Positions;
+	TArray<FVector> Velocities;
+	TArray<float> Ages;
+	TArray<float> ImpactRadii;
+	TArray<TWeakObjectPtr<AActor>> Instigators;
+	TArray<uint8> ImpactEffectIndices;
+	TArray<FName> Weapons;
+	TArray<uint16> ShotIds;
+
+	/** Effects spawned on impact, indexed by `ImpactEffectIndices` */
+	UPROPERTY(Transient)
+	TArray<UNiagaraSystem*> ImpactEffects;
+
+	/** Scratch results of the swept traces, reused every tick */
+	TArray<FHitResult> TraceHits;
+	TArray<uint8> TraceHitFlags;
+
+	/** Amount of slots in use */
+	int32 NumActive = 0;
+};
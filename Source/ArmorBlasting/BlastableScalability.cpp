@@ -0,0 +1,153 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BlastableScalability.h"
+#include "BlastableSubsystem.h"
+#include "BlastableProjectileSubsystem.h"
+#include "ArmorBlastingCharacter.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/ConfigCacheIni.h"
+#include "Engine/Engine.h"
+
+namespace
+{
+	TAutoConsoleVariable<int32> CVarQuality(
+		TEXT("sg.ArmorBlastingQuality"),
+		3,
+		TEXT("Scalability level of armor blasting, applies the ArmorBlastingQuality@<Level> section of the scalability ini.\n")
+		TEXT(" 0:low, 1:medium, 2:high, 3:epic, 4:cinematic"),
+		ECVF_ScalabilityGroup);
+
+	TAutoConsoleVariable<float> CVarDamageResolutionScale(
+		TEXT("ab.DamageResolutionScale"),
+		1.f,
+		TEXT("Scale of the damage render targets relative to the size set on every blastable, rounded to a power of two."),
+		ECVF_Scalability);
+
+	TAutoConsoleVariable<float> CVarFadeInterval(
+		TEXT("ab.DamageFadeInterval"),
+		0.1f,
+		TEXT("Seconds between two fading steps of the fading damage. Fading damage vanishes in the same time, in fewer and bigger steps."),
+		ECVF_Scalability);
+
+	TAutoConsoleVariable<int32> CVarMaxBlastsPerFrame(
+		TEXT("ab.MaxBlastsPerFrame"),
+		0,
+		TEXT("Blasts applied per frame, the rest wait for the next frame. 0 means no limit."),
+		ECVF_Scalability);
+
+	TAutoConsoleVariable<int32> CVarMaxTrackedHits(
+		TEXT("ab.MaxTrackedHits"),
+		2048,
+		TEXT("Projectiles tracked at once until they hit something, new ones are not fired past this amount."),
+		ECVF_Scalability);
+
+	TAutoConsoleVariable<int32> CVarImpactEffectPoolSize(
+		TEXT("ab.ImpactEffectPoolSize"),
+		32,
+		TEXT("Impact effects alive at once, the oldest one is reused when the pool is full."),
+		ECVF_Scalability);
+
+	// Clients pick the pellets and radii the server stamps with, so these are cheats outside development builds
+	TAutoConsoleVariable<int32> CVarShotgunPellets(
+		TEXT("ab.ShotgunPellets"),
+		15,
+		TEXT("Pellets of a shotgun shot, every one is a trace and possibly a stamp. Capped to the traces a client can send in one shot."),
+		ECVF_Cheat);
+
+	TAutoConsoleVariable<float> CVarShotgunMinImpactRadius(
+		TEXT("ab.ShotgunMinImpactRadius"),
+		2.f,
+		TEXT("Impact radius of shotgun pellets hitting the center of the spread. Capped to the radius the server accepts from clients."),
+		ECVF_Cheat);
+
+	TAutoConsoleVariable<float> CVarShotgunMaxImpactRadius(
+		TEXT("ab.ShotgunMaxImpactRadius"),
+		6.f,
+		TEXT("Impact radius of shotgun pellets hitting the edge of the spread. Capped to the radius the server accepts from clients."),
+		ECVF_Cheat);
+
+	/** Level applied last, so the ini is only read when the level changes */
+	int32 AppliedQuality = INDEX_NONE;
+
+	/** Settings pushed to blastables last, so unrelated console variables don't make every blastable check its targets */
+	struct FAppliedSettings
+	{
+		float DamageResolutionScale = 0.f;
+		float FadeInterval = 0.f;
+		int32 ImpactEffectPoolSize = 0;
+
+		bool operator==(const FAppliedSettings& Other) const
+		{
+			return DamageResolutionScale == Other.DamageResolutionScale && FadeInterval == Other.FadeInterval && ImpactEffectPoolSize == Other.ImpactEffectPoolSize;
+		}
+	};
+	FAppliedSettings AppliedSettings;
+
+	/** Called on the game thread at the end of every frame some console variable changed */
+	void OnConsoleVariablesChanged()
+	{
+		const int32 Quality = FMath::Clamp(CVarQuality.GetValueOnGameThread(), 0, 4);
+		if (Quality != AppliedQuality)
+		{
+			AppliedQuality = Quality;
+			ApplyCVarSettingsFromIni(*FString::Printf(TEXT("ArmorBlastingQuality@%d"), Quality), *GScalabilityIni, ECVF_SetByScalability);
+		}
+
+		const FAppliedSettings Settings = { CVarDamageResolutionScale.GetValueOnGameThread(), CVarFadeInterval.GetValueOnGameThread(), CVarImpactEffectPoolSize.GetValueOnGameThread() };
+		if (Settings == AppliedSettings || GEngine == nullptr)
+			return;
+
+		AppliedSettings = Settings;
+		for (auto const& Context : GEngine->GetWorldContexts())
+		{
+			auto const World = Context.World();
+			auto const Subsystem = World != nullptr ? World->GetSubsystem<UBlastableSubsystem>() : nullptr;
+			if (Subsystem != nullptr)
+				Subsystem->ApplyScalability();
+		}
+	}
+
+	FAutoConsoleVariableSink CVarSink(FConsoleCommandDelegate::CreateStatic(&OnConsoleVariablesChanged));
+}
+
+int32 BlastableScalability::GetDamageResolution(int32 AuthoredSize)
+{
+	const float Scale = FMath::Max(CVarDamageResolutionScale.GetValueOnGameThread(), 0.f);
+	return FMath::Clamp(int32(FMath::RoundUpToPowerOfTwo(FMath::Max(FMath::RoundToInt(AuthoredSize * Scale), 1))), 32, 4096);
+}
+
+float BlastableScalability::GetFadeInterval()
+{
+	return FMath::Max(CVarFadeInterval.GetValueOnGameThread(), 0.01f);
+}
+
+int32 BlastableScalability::GetMaxBlastsPerFrame()
+{
+	return FMath::Max(CVarMaxBlastsPerFrame.GetValueOnGameThread(), 0);
+}
+
+int32 BlastableScalability::GetMaxTrackedHits()
+{
+	return FMath::Clamp(CVarMaxTrackedHits.GetValueOnGameThread(), 1, UBlastableProjectileSubsystem::MaxProjectiles);
+}
+
+int32 BlastableScalability::GetImpactEffectPoolSize()
+{
+	return FMath::Max(CVarImpactEffectPoolSize.GetValueOnGameThread(), 0);
+}
+
+int32 BlastableScalability::GetShotgunPellets()
+{
+	return FMath::Clamp(CVarShotgunPellets.GetValueOnGameThread(), 1, AArmorBlastingCharacter::MaxTracesPerShot);
+}
+
+float BlastableScalability::GetShotgunMinImpactRadius()
+{
+	// Anything past what the server accepts would get the client kicked on its first shot
+	return FMath::Clamp(CVarShotgunMinImpactRadius.GetValueOnGameThread(), 0.f, AArmorBlastingCharacter::MaxClientImpactRadius);
+}
+
+float BlastableScalability::GetShotgunMaxImpactRadius()
+{
+	return FMath::Clamp(CVarShotgunMaxImpactRadius.GetValueOnGameThread(), GetShotgunMinImpactRadius(), AArmorBlastingCharacter::MaxClientImpactRadius);
+}
@@ -0,0 +1,45 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Quality and cost settings of armor blasting, backed by console variables so a single cooked build
+ * scales from low end to high end machines.
+ *
+ * `sg.ArmorBlastingQuality` picks a level from 0 (low) to 4 (cinematic) and applies the matching
+ * `ArmorBlastingQuality@<Level>` section of the scalability ini, like engine scalability groups do.
+ * Every setting can also be changed on its own. Changes are applied live to blastables already in
+ * the world, without recreating any actor.
+ */
+namespace BlastableScalability
+{
+	/// <summary>
+	/// Width and height of the damage render targets of a blastable
+	/// </summary>
+	/// <param name="AuthoredSize"> Size set on the component, tuned for the texel density of its armor </param>
+	/// <returns> `AuthoredSize` scaled by `ab.DamageResolutionScale`, rounded to a power of two </returns>
+	ARMORBLASTING_API int32 GetDamageResolution(int32 AuthoredSize);
+
+	/** Seconds between two fading steps of the fading damage */
+	ARMORBLASTING_API float GetFadeInterval();
+
+	/** Blasts applied per frame, the rest wait for the next frame. 0 means no limit. */
+	ARMORBLASTING_API int32 GetMaxBlastsPerFrame();
+
+	/** Projectiles tracked at once until they hit something, at most `UBlastableProjectileSubsystem::MaxProjectiles` */
+	ARMORBLASTING_API int32 GetMaxTrackedHits();
+
+	/** Impact effects alive at once, older ones are reused when the pool is full */
+	ARMORBLASTING_API int32 GetImpactEffectPoolSize();
+
+	/** Pellets of a shotgun shot, every one is a trace and possibly a stamp. At most the traces a client can send in one shot. */
+	ARMORBLASTING_API int32 GetShotgunPellets();
+
+	/** Impact radius of pellets hitting the center of the spread, at most the radius the server accepts from clients */
+	ARMORBLASTING_API float GetShotgunMinImpactRadius();
+
+	/** Impact radius of pellets hitting the edge of the spread, never below the one at the center */
+	ARMORBLASTING_API float GetShotgunMaxImpactRadius();
+}
@@ -0,0 +1,138 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BlastableSetupCache.h"
+#include "BlastablePositionMap.h"
+#include "ArmorBlasting.h"
+#include "Components/StaticMeshComponent.h"
+#include "GameFramework/Actor.h"
+#include "UObject/UObjectHash.h"
+
+namespace
+{
+	const FName BlastableMeshTag("BlastableMesh");
+
+	/** Divide a scale by another, axes of `Divisor` that are zero are left alone */
+	FVector DivideScale(const FVector& Scale, const FVector& Divisor)
+	{
+		return FVector(
+			Divisor.X != 0.f ? Scale.X / Divisor.X : Scale.X,
+			Divisor.Y != 0.f ? Scale.Y / Divisor.Y : Scale.Y,
+			Divisor.Z != 0.f ? Scale.Z / Divisor.Z : Scale.Z);
+	}
+}
+
+FBlastablePieceLayout FBlastableClassSetup::GetInstanceLayout(int32 Piece, const AActor* Owner) const
+{
+	FBlastablePieceLayout Layout = Layouts[Piece];
+	if (Owner != nullptr)
+		Layout.Rescale(DivideScale(Owner->GetActorScale3D(), ActorScale));
+	return Layout;
+}
+
+FBlastableClassSetupCache& FBlastableClassSetupCache::Get()
+{
+	static FBlastableClassSetupCache Instance;
+	return Instance;
+}
+
+const FBlastableClassSetup* FBlastableClassSetupCache::Bind(AActor* Owner, int32 LayoutResolution, TArray<UStaticMeshComponent*>& OutMeshes)
+{
+	OutMeshes.Reset();
+	if (Owner == nullptr)
+		return nullptr;
+
+	const UClass* Class = Owner->GetClass();
+	auto Setup = Setups.Find(Class);
+	if (Setup != nullptr && Setup->LayoutResolution == LayoutResolution && ResolveMeshes(Owner, *Setup, OutMeshes))
+		return Setup;
+
+	// Drop setups of classes that were garbage collected, like blueprint classes replaced by a recompile
+	for (auto It = Setups.CreateIterator(); It; ++It)
+	{
+		if (!It.Key().IsValid())
+			It.RemoveCurrent();
+	}
+
+	// First instance of this class, or its content changed: search the pieces the slow way
+	auto& NewSetup = Setups.FindOrAdd(Class);
+	BuildSetup(Owner, LayoutResolution, NewSetup, OutMeshes);
+	return &NewSetup;
+}
+
+UTexture2D* FBlastableClassSetupCache::GetPositionMap(const FBlastableClassSetup& Setup, const TArray<UStaticMeshComponent*>& Pieces, int32 Resolution)
+{
+	if (Setup.PositionMap == nullptr || Setup.PositionMapResolution != Resolution)
+	{
+		Setup.PositionMap = BlastablePositionMap::Bake(Pieces, Resolution, nullptr);
+		Setup.PositionMapResolution = Resolution;
+	}
+
+	return Setup.PositionMap;
+}
+
+void FBlastableClassSetupCache::AddReferencedObjects(FReferenceCollector& Collector)
+{
+	for (auto& Entry : Setups)
+	{
+		if (Entry.Value.PositionMap != nullptr)
+			Collector.AddReferencedObject(Entry.Value.PositionMap);
+	}
+}
+
+void FBlastableClassSetupCache::Invalidate(const UClass* Class)
+{
+	Setups.Remove(Class);
+}
+
+bool FBlastableClassSetupCache::ResolveMeshes(AActor* Owner, const FBlastableClassSetup& Setup, TArray<UStaticMeshComponent*>& OutMeshes)
+{
+	OutMeshes.Reset(Setup.MeshNames.Num());
+	for (int i = 0; i < Setup.MeshNames.Num(); i++)
+	{
+		// Components are named subobjects of their actor, so this is a hash lookup instead of a component search
+		auto const Mesh = FindObjectFast<UStaticMeshComponent>(Owner, Setup.MeshNames[i]);
+		if (Mesh == nullptr || !Mesh->ComponentHasTag(BlastableMeshTag) || Mesh->GetStaticMesh() != Setup.StaticMeshes[i].Get())
+			return false;
+
+		// Only content is checked, the scale the actor was spawned at is applied when layouts are read
+		const FVector RelativeScale = DivideScale(Mesh->GetComponentScale(), Owner->GetActorScale3D());
+		if (!RelativeScale.Equals(Setup.RelativeScales[i]) || Mesh->GetNumMaterials() != Setup.MaterialSectionCounts[i])
+			return false;
+
+		OutMeshes.Add(Mesh);
+	}
+
+	return true;
+}
+
+void FBlastableClassSetupCache::BuildSetup(AActor* Owner, int32 LayoutResolution, FBlastableClassSetup& OutSetup, TArray<UStaticMeshComponent*>& OutMeshes)
+{
+	auto const Components = Owner->GetComponentsByTag(UStaticMeshComponent::StaticClass(), BlastableMeshTag);
+
+	OutMeshes.Reset(Components.Num());
+	OutSetup = FBlastableClassSetup();
+	OutSetup.LayoutResolution = LayoutResolution;
+	OutSetup.ActorScale = Owner->GetActorScale3D();
+
+	// Note that blastable meshes are intended to use complex collisions, and for that reason
+	// we only block traces in ECC_Enemy, to prevent the physics engine from computing physics
+	// using complex geometry.
+	OutSetup.CollisionResponses.SetAllChannels(ECollisionResponse::ECR_Ignore);
+	OutSetup.CollisionResponses.SetResponse(ECC_Enemy, ECollisionResponse::ECR_Block);
+
+	for (auto const Component : Components)
+	{
+		auto const Mesh = Cast<UStaticMeshComponent>(Component);
+		if (Mesh == nullptr)
+			continue;
+
+		OutMeshes.Add(Mesh);
+		OutSetup.MeshNames.Add(Mesh->GetFName());
+		OutSetup.StaticMeshes.Add(Mesh->GetStaticMesh());
+		OutSetup.RelativeScales.Add(DivideScale(Mesh->GetComponentScale(), OutSetup.ActorScale));
+		OutSetup.MaterialSectionCounts.Add(Mesh->GetNumMaterials());
+
+		auto& Layout = OutSetup.Layouts.AddDefaulted_GetRef();
+		FBlastablePieceLayout::Build(Mesh, LayoutResolution, Layout);
+	}
+}
@@ -0,0 +1,111 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/EngineTypes.h"
+#include "UObject/GCObject.h"
+#include "BlastableUVLayout.h"
+
+class AActor;
+class UStaticMesh;
+class UStaticMeshComponent;
+class UTexture2D;
+
+/**
+ * Blastable setup shared by every instance of an actor class: which components are armor pieces,
+ * how their materials are laid out and which collision they use. Built from the first instance
+ * of the class that begins play.
+ */
+struct ARMORBLASTING_API FBlastableClassSetup
+{
+	/** Names of the tagged mesh components, in the order `GetComponentsByTag` returned them */
+	TArray<FName> MeshNames;
+
+	/** Mesh asset of every piece when the setup was built, used to detect content changes */
+	TArray<TWeakObjectPtr<UStaticMesh>> StaticMeshes;
+
+	/** Scale of every piece relative to the actor, so instances spawned at any scale share the setup */
+	TArray<FVector> RelativeScales;
+
+	/** Scale of the actor `Layouts` were measured on */
+	FVector ActorScale = FVector::OneVector;
+
+	/** Amount of material sections of every piece */
+	TArray<int32> MaterialSectionCounts;
+
+	/** Collision responses every piece should end up with */
+	FCollisionResponseContainer CollisionResponses;
+
+	/** Surface and UV footprint of every piece, measured at `ActorScale` */
+	TArray<FBlastablePieceLayout> Layouts;
+
+	/// <summary>
+	/// Get the layout of a piece for an instance of the class, at the scale of that instance
+	/// </summary>
+	/// <param name="Piece"> Index of the piece </param>
+	/// <param name="Owner"> Instance the setup was bound to </param>
+	FBlastablePieceLayout GetInstanceLayout(int32 Piece, const AActor* Owner) const;
+
+	/** Mask resolution `Layouts` were built with */
+	int32 LayoutResolution = 0;
+
+	/** Reference pose position map of the pieces, only baked once some instance stamps against it */
+	mutable UTexture2D* PositionMap = nullptr;
+	mutable int32 PositionMapResolution = 0;
+};
+
+/**
+ * Cache of blastable setups keyed by actor class.
+ *
+ * Blueprint recompiles create a new class, so stale setups are never picked up for new instances.
+ * Instances still check that their pieces match the cached ones, and rebuild the setup if they
+ * don't, which covers components added or replaced per instance.
+ */
+class ARMORBLASTING_API FBlastableClassSetupCache : public FGCObject
+{
+public:
+	static FBlastableClassSetupCache& Get();
+
+	/// <summary>
+	/// Resolve the blastable pieces of an actor, building the setup of its class if needed
+	/// </summary>
+	/// <param name="Owner"> Actor owning the blastable meshes </param>
+	/// <param name="LayoutResolution"> Resolution of the piece coverage masks </param>
+	/// <param name="OutMeshes"> Blastable meshes of `Owner`, in the same order as the setup arrays </param>
+	/// <returns> Setup of the actor class, or null if `Owner` is null </returns>
+	const FBlastableClassSetup* Bind(AActor* Owner, int32 LayoutResolution, TArray<UStaticMeshComponent*>& OutMeshes);
+
+	/// <summary>
+	/// Get the reference pose position map of a setup, baking it from `Pieces` the first time
+	/// </summary>
+	/// <param name="Setup"> Setup obtained with `Bind` </param>
+	/// <param name="Pieces"> Meshes resolved by `Bind` </param>
+	/// <param name="Resolution"> Width and height of the map </param>
+	UTexture2D* GetPositionMap(const FBlastableClassSetup& Setup, const TArray<UStaticMeshComponent*>& Pieces, int32 Resolution);
+
+	// FGCObject interface
+	virtual void AddReferencedObjects(FReferenceCollector& Collector) override;
+	virtual FString GetReferencerName() const override { return TEXT("FBlastableClassSetupCache"); }
+	// End of FGCObject interface
+
+	/** Forget the setup of a class */
+	void Invalidate(const UClass* Class);
+
+	/** Forget every setup */
+	void Empty() { Setups.Empty(); }
+
+private:
+	/// <summary>
+	/// Resolve the cached pieces by name on `Owner`
+	/// </summary>
+	/// <returns> False if any piece is missing or no longer matches the setup </returns>
+	static bool ResolveMeshes(AActor* Owner, const FBlastableClassSetup& Setup, TArray<UStaticMeshComponent*>& OutMeshes);
+
+	/// <summary>
+	/// Build a setup by searching the tagged meshes of `Owner`
+	/// </summary>
+	static void BuildSetup(AActor* Owner, int32 LayoutResolution, FBlastableClassSetup& OutSetup, TArray<UStaticMeshComponent*>& OutMeshes);
+
+	TMap<TWeakObjectPtr<const UClass>, FBlastableClassSetup> Setups;
+};
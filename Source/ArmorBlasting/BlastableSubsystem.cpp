@@ -0,0 +1,400 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BlastableSubsystem.h"
+#include "BlastableComponent.h"
+#include "Components/StaticMeshComponent.h"
+#include "Algo/Sort.h"
+#include "Async/ParallelFor.h"
+#include "BlastableCore.h"
+#include "Misc/App.h"
+#include "SceneViewExtension.h"
+#include "BlastableScalability.h"
+#include "NiagaraFunctionLibrary.h"
+#include "NiagaraComponent.h"
+#include "BlastableTelemetry.h"
+
+void UBlastableSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+	NetEventBudget = MaxNetEventsPerSecond;
+
+	// Only game worlds blast anything, and only machines that render draw damage on the GPU. The
+	// stamp shaders are only compiled for SM5, other feature levels stamp through materials.
+	auto const World = GetWorld();
+	if (FApp::CanEverRender() && GMaxRHIFeatureLevel >= ERHIFeatureLevel::SM5 && World != nullptr && World->IsGameWorld())
+		DamageRenderer = FSceneViewExtensions::NewExtension<FBlastableDamageRenderer>();
+
+	// Opt in telemetry for play sessions started from the command line, recording until the game quits
+	static bool bTelemetryChecked = false;
+	if (!bTelemetryChecked && World != nullptr && World->IsGameWorld())
+	{
+		bTelemetryChecked = true;
+		if (FParse::Param(FCommandLine::Get(), TEXT("BlastTelemetry")))
+			FBlastableTelemetry::Get().StartRecording();
+	}
+	bInitialized = true;
+}
+
+void UBlastableSubsystem::Deinitialize()
+{
+	// Nothing left to blast, just drop whatever is pending
+	PendingBlasts.Empty();
+	DamageRenderer.Reset();
+	DeferredBlasts.Empty();
+	CpuDamageDirty.Empty();
+	ImpactEffectPool.Empty();
+	SpatialCells.Empty();
+	BlastableCells.Empty();
+	bInitialized = false;
+
+	Super::Deinitialize();
+}
+
+void UBlastableSubsystem::SubmitBlast(FBlastRequest&& Request)
+{
+	PendingBlasts.Enqueue(MoveTemp(Request));
+}
+
+void UBlastableSubsystem::SubmitBlast(UBlastableComponent* Target, const FVector& Location, float Radius)
+{
+	FBlastRequest Request;
+	Request.Target = Target;
+	Request.Location = Location;
+	Request.Radius = Radius;
+	SubmitBlast(MoveTemp(Request));
+}
+
+void UBlastableSubsystem::SubmitBlast(UBlastableComponent* Target, const FHitResult& Hit, float Radius, FName Weapon)
+{
+	FBlastRequest Request;
+	Request.Target = Target;
+	Request.Hit = Hit;
+	Request.Location = Hit.Location;
+	Request.Radius = Radius;
+	Request.bHasHit = true;
+	Request.Weapon = Weapon;
+	SubmitBlast(MoveTemp(Request));
+}
+
+void UBlastableSubsystem::SubmitBlasts(TArray<FBlastRequest>&& Requests)
+{
+	for (FBlastRequest& Request : Requests)
+		PendingBlasts.Enqueue(MoveTemp(Request));
+	Requests.Reset();
+}
+
+void UBlastableSubsystem::FlushBlasts()
+{
+	check(IsInGameThread());
+
+	// Flushes can happen many times a frame, they all share the same budget
+	if (BudgetFrame != GFrameCounter)
+	{
+		BudgetFrame = GFrameCounter;
+		BlastsThisFrame = 0;
+	}
+
+	// Blasts deferred by earlier frames go first, so blasts are still applied in the order they came
+	FlushScratch.Reset();
+	FlushScratch.Append(MoveTemp(DeferredBlasts));
+	DeferredBlasts.Reset();
+	FBlastRequest Request;
+	while (PendingBlasts.Dequeue(Request))
+		FlushScratch.Add(MoveTemp(Request));
+
+	const int32 MaxBlastsPerFrame = BlastableScalability::GetMaxBlastsPerFrame();
+	if (MaxBlastsPerFrame > 0)
+	{
+		const int32 Budget = FMath::Max(MaxBlastsPerFrame - BlastsThisFrame, 0);
+		if (FlushScratch.Num() > Budget)
+		{
+			DeferredBlasts.Append(FlushScratch.GetData() + Budget, FlushScratch.Num() - Budget);
+			FlushScratch.SetNum(Budget, false);
+		}
+	}
+	BlastsThisFrame += FlushScratch.Num();
+
+	if (FlushScratch.Num() == 0)
+	{
+		FlushCpuDamage();
+		return;
+	}
+
+	// Group blasts by target so that every blastable handles all of its blasts this frame in one go
+	Algo::StableSortBy(FlushScratch, [](const FBlastRequest& Blast) { return Blast.Target.Get(); });
+
+	int32 RunStart = 0;
+	while (RunStart < FlushScratch.Num())
+	{
+		UBlastableComponent* Target = FlushScratch[RunStart].Target.Get();
+		int32 RunEnd = RunStart + 1;
+		while (RunEnd < FlushScratch.Num() && FlushScratch[RunEnd].Target.Get() == Target)
+			RunEnd++;
+
+		// Target might have been destroyed since the blast was submitted
+		if (Target != nullptr && Target->HasBegunPlay())
+			Target->BlastBatch(MakeArrayView(FlushScratch.GetData() + RunStart, RunEnd - RunStart));
+
+		RunStart = RunEnd;
+	}
+
+	FlushScratch.Reset();
+	FlushCpuDamage();
+}
+
+void UBlastableSubsystem::SpawnImpactEffect(UNiagaraSystem* Effect, const FVector& Location, const FRotator& Rotation)
+{
+	if (Effect == nullptr)
+		return;
+
+	// Impact effects are tiny, they are authored at a huge scale
+	const FVector Scale = 0.001f * FVector::OneVector;
+
+	const int32 PoolSize = BlastableScalability::GetImpactEffectPoolSize();
+	if (PoolSize == 0)
+		return;
+
+	if (ImpactEffectPool.Num() < PoolSize)
+	{
+		auto const Component = UNiagaraFunctionLibrary::SpawnSystemAtLocation(GetWorld(), Effect, Location, Rotation, Scale, false);
+		if (Component != nullptr)
+			ImpactEffectPool.Add(Component);
+		return;
+	}
+
+	// Pool is full, restart the oldest effect at the new impact
+	NextImpactEffect %= ImpactEffectPool.Num();
+	auto& Component = ImpactEffectPool[NextImpactEffect++];
+	if (Component == nullptr || Component->IsPendingKill())
+	{
+		Component = UNiagaraFunctionLibrary::SpawnSystemAtLocation(GetWorld(), Effect, Location, Rotation, Scale, false);
+		return;
+	}
+
+	Component->SetAsset(Effect);
+	Component->SetWorldLocationAndRotation(Location, Rotation);
+	Component->SetWorldScale3D(Scale);
+	Component->ResetSystem();
+}
+
+void UBlastableSubsystem::WarmUpImpactEffect(UNiagaraSystem* Effect)
+{
+	if (Effect == nullptr || ImpactEffectPool.Num() >= BlastableScalability::GetImpactEffectPoolSize())
+		return;
+
+	// Activating initializes the system, deactivating right away lets it stop before anything spawns
+	auto const Component = UNiagaraFunctionLibrary::SpawnSystemAtLocation(GetWorld(), Effect, FVector::ZeroVector, FRotator::ZeroRotator, 0.001f * FVector::OneVector, false);
+	if (Component == nullptr)
+		return;
+
+	Component->Deactivate();
+	ImpactEffectPool.Add(Component);
+}
+
+void UBlastableSubsystem::ApplyScalability()
+{
+	for (auto const& Blastable : BlastableCells)
+		Blastable.Key->ApplyScalability();
+
+	// Shrink the pool right away, effects past its new size just stop
+	const int32 PoolSize = BlastableScalability::GetImpactEffectPoolSize();
+	for (int32 i = PoolSize; i < ImpactEffectPool.Num(); i++)
+	{
+		if (ImpactEffectPool[i] != nullptr)
+			ImpactEffectPool[i]->DestroyComponent();
+	}
+	if (ImpactEffectPool.Num() > PoolSize)
+		ImpactEffectPool.SetNum(PoolSize);
+}
+
+void UBlastableSubsystem::MarkCpuDamageDirty(UBlastableComponent* Blastable)
+{
+	CpuDamageDirty.AddUnique(Blastable);
+}
+
+FBlastableDamageTilePool& UBlastableSubsystem::GetDamageTilePool()
+{
+	if (!DamageTilePool.IsInitialized())
+		DamageTilePool.Init(DamageTileCapacity);
+
+	return DamageTilePool;
+}
+
+void UBlastableSubsystem::FlushCpuDamage()
+{
+	if (CpuDamageDirty.Num() == 0)
+		return;
+
+	// Blastables never share damage maps, so every one of them can be splatted on its own task
+	ParallelFor(CpuDamageDirty.Num(), [this](int32 i)
+	{
+		if (auto const Blastable = CpuDamageDirty[i].Get())
+			Blastable->SplatCpuStamps();
+	});
+
+	for (auto const& Blastable : CpuDamageDirty)
+	{
+		if (Blastable.IsValid())
+			Blastable->UploadCpuDamage();
+	}
+
+	CpuDamageDirty.Reset();
+}
+
+int32 UBlastableSubsystem::RadialBlast(FVector Origin, float Radius, float MinImpactRadius, float MaxImpactRadius)
+{
+	TArray<UBlastableComponent*> Blastables;
+	QueryBlastables(Origin, Radius, Blastables);
+
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(BlastableRadialBlast), true);
+	QueryParams.bReturnFaceIndex = true;
+
+	TArray<FBlastRequest> Requests;
+	for (auto const Blastable : Blastables)
+	{
+		for (auto const Piece : Blastable->GetBlastableMeshes())
+		{
+			if (Piece == nullptr)
+				continue;
+
+			// Cheap rejection using the piece bounds before doing any trace
+			const FBox PieceBox = Piece->Bounds.GetBox();
+			const float DistanceSquared = PieceBox.ComputeSquaredDistanceToPoint(Origin);
+			if (DistanceSquared > Radius * Radius)
+				continue;
+
+			// Trace towards the piece to find the side of its surface facing the explosion. This only 
+			// tests this piece, so it's way cheaper than a trace against the world.
+			FHitResult Hit;
+			if (!Piece->LineTraceComponent(Hit, Origin, Piece->Bounds.Origin, QueryParams))
+				continue;
+
+			// Linear falloff from the center of the explosion to its border
+			const float Falloff = 1.f - FMath::Clamp(Hit.Distance / Radius, 0.f, 1.f);
+
+			FBlastRequest& Request = Requests.AddDefaulted_GetRef();
+			Request.Target = Blastable;
+			Request.Hit = Hit;
+			Request.Location = Hit.Location;
+			Request.Radius = FMath::Lerp(MinImpactRadius, MaxImpactRadius, Falloff);
+			Request.bHasHit = true;
+		}
+	}
+
+	const int32 NumBlasted = Requests.Num();
+	SubmitBlasts(MoveTemp(Requests));
+	return NumBlasted;
+}
+
+void UBlastableSubsystem::QueryBlastables(const FVector& Origin, float Radius, TArray<UBlastableComponent*>& OutBlastables) const
+{
+	// Blastables are indexed by their location, but their armor can reach as far as `MaxBoundsRadius` from it
+	const float QueryRadius = Radius + MaxBoundsRadius;
+	const FIntVector MinCell = GetCell(Origin - FVector(QueryRadius));
+	const FIntVector MaxCell = GetCell(Origin + FVector(QueryRadius));
+
+	for (int32 X = MinCell.X; X <= MaxCell.X; X++)
+	{
+		for (int32 Y = MinCell.Y; Y <= MaxCell.Y; Y++)
+		{
+			for (int32 Z = MinCell.Z; Z <= MaxCell.Z; Z++)
+			{
+				auto const Cell = SpatialCells.Find(FIntVector(X, Y, Z));
+				if (Cell == nullptr)
+					continue;
+
+				for (auto const Blastable : *Cell)
+				{
+					if (FVector::DistSquared(Blastable->GetComponentLocation(), Origin) <= FMath::Square(QueryRadius))
+						OutBlastables.Add(Blastable);
+				}
+			}
+		}
+	}
+}
+
+void UBlastableSubsystem::RegisterBlastable(UBlastableComponent* Blastable, float BoundsRadius)
+{
+	if (Blastable == nullptr || BlastableCells.Contains(Blastable))
+		return;
+
+	const FIntVector Cell = GetCell(Blastable->GetComponentLocation());
+	SpatialCells.FindOrAdd(Cell).Add(Blastable);
+	BlastableCells.Add(Blastable, Cell);
+	MaxBoundsRadius = FMath::Max(MaxBoundsRadius, BoundsRadius);
+}
+
+void UBlastableSubsystem::UnregisterBlastable(UBlastableComponent* Blastable)
+{
+	FIntVector Cell;
+	if (!BlastableCells.RemoveAndCopyValue(Blastable, Cell))
+		return;
+
+	auto const Blastables = SpatialCells.Find(Cell);
+	if (Blastables == nullptr)
+		return;
+
+	Blastables->RemoveSingleSwap(Blastable);
+	if (Blastables->Num() == 0)
+		SpatialCells.Remove(Cell);
+}
+
+void UBlastableSubsystem::UpdateBlastable(UBlastableComponent* Blastable)
+{
+	auto const OldCell = BlastableCells.Find(Blastable);
+	if (OldCell == nullptr)
+		return;
+
+	// Most movement happens inside a cell, so this is usually just a lookup
+	const FIntVector NewCell = GetCell(Blastable->GetComponentLocation());
+	if (NewCell == *OldCell)
+		return;
+
+	auto const OldBlastables = SpatialCells.Find(*OldCell);
+	if (OldBlastables != nullptr)
+	{
+		OldBlastables->RemoveSingleSwap(Blastable);
+		if (OldBlastables->Num() == 0)
+			SpatialCells.Remove(*OldCell);
+	}
+
+	SpatialCells.FindOrAdd(NewCell).Add(Blastable);
+	*OldCell = NewCell;
+}
+
+FIntVector UBlastableSubsystem::GetCell(const FVector& Location) const
+{
+	return FIntVector(
+		FMath::FloorToInt(Location.X / SpatialCellSize),
+		FMath::FloorToInt(Location.Y / SpatialCellSize),
+		FMath::FloorToInt(Location.Z / SpatialCellSize)
+	);
+}
+
+void UBlastableSubsystem::ResolvePredictions(uint16 FirstShotId, int32 NumShots, TArrayView<const FBlastableShotHit> Hits)
+{
+	for (auto const& Blastable : BlastableCells)
+		Blastable.Key->ResolvePredictions(FirstShotId, NumShots, Hits);
+}
+
+bool UBlastableSubsystem::ConsumeNetEventBudget()
+{
+	if (NetEventBudget < 1.f)
+		return false;
+
+	NetEventBudget -= 1.f;
+	return true;
+}
+
+void UBlastableSubsystem::Tick(float DeltaTime)
+{
+	FlushBlasts();
+
+	// Let the budget build up for at most one second, so a quiet moment doesn't allow a burst later
+	NetEventBudget = FMath::Min(NetEventBudget + MaxNetEventsPerSecond * DeltaTime, MaxNetEventsPerSecond);
+}
+
+TStatId UBlastableSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UBlastableSubsystem, STATGROUP_Tickables);
+}
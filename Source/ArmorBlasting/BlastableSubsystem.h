@@ -0,0 +1,217 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "Containers/Queue.h"
+#include "BlastableTypes.h"
+#include "BlastableDamageTilePool.h"
+#include "BlastableDamageRenderer.h"
+#include "BlastableSubsystem.generated.h"
+
+class UBlastableComponent;
+struct FBlastableShotHit;
+class UNiagaraSystem;
+class UNiagaraComponent;
+
+/**
+ * Per world entry point for blasts coming from any thread.
+ *
+ * `UBlastableComponent::Blast` mutates components and issues scene captures, so it must run on the
+ * game thread. Async traces, physics callbacks and task graph jobs submit their hits here instead,
+ * into a lock free multi producer single consumer queue that is drained once per frame.
+ */
+UCLASS()
+class ARMORBLASTING_API UBlastableSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	/// <summary>
+	/// Queue a blast. Safe to call from any thread, the blast is applied during the next game thread tick.
+	/// </summary>
+	/// <param name="Request"> Blast to apply </param>
+	void SubmitBlast(FBlastRequest&& Request);
+
+	/// <summary>
+	/// Queue a blast at a world location. Safe to call from any thread.
+	/// </summary>
+	void SubmitBlast(UBlastableComponent* Target, const FVector& Location, float Radius);
+
+	/// <summary>
+	/// Queue a blast where a trace hit the armor. Safe to call from any thread.
+	/// </summary>
+	void SubmitBlast(UBlastableComponent* Target, const FHitResult& Hit, float Radius, FName Weapon = NAME_None);
+
+	/// <summary>
+	/// Queue many blasts at once, possibly for different targets. Safe to call from any thread.
+	/// </summary>
+	void SubmitBlasts(TArray<FBlastRequest>&& Requests);
+
+	/// <summary>
+	/// Blast every armor piece within a sphere, like an explosion would. Pieces closer to the origin 
+	/// get bigger holes. All resulting blasts are submitted as a single batch. Game thread only.
+	/// </summary>
+	/// <param name="Origin"> Center of the explosion in world space </param>
+	/// <param name="Radius"> Radius of the explosion </param>
+	/// <param name="MinImpactRadius"> Size of the holes at the border of the explosion </param>
+	/// <param name="MaxImpactRadius"> Size of the holes at the center of the explosion </param>
+	/// <returns> Amount of armor pieces blasted </returns>
+	UFUNCTION(BlueprintCallable, Category = "ArmorBlasting")
+	int32 RadialBlast(FVector Origin, float Radius, float MinImpactRadius = 4.f, float MaxImpactRadius = 20.f);
+
+	/// <summary>
+	/// Collect blastables whose armor might intersect a sphere, using the spatial index. Game thread only.
+	/// </summary>
+	/// <param name="Origin"> Center of the sphere in world space </param>
+	/// <param name="Radius"> Radius of the sphere </param>
+	/// <param name="OutBlastables"> Blastables near the sphere, appended to the array </param>
+	void QueryBlastables(const FVector& Origin, float Radius, TArray<UBlastableComponent*>& OutBlastables) const;
+
+	/// <summary>
+	/// Add a blastable to the spatial index. Called by blastables when they begin play.
+	/// </summary>
+	/// <param name="Blastable"> Blastable to track </param>
+	/// <param name="BoundsRadius"> Distance from the blastable location to the farthest point of its armor </param>
+	void RegisterBlastable(UBlastableComponent* Blastable, float BoundsRadius);
+
+	/** Remove a blastable from the spatial index */
+	void UnregisterBlastable(UBlastableComponent* Blastable);
+
+	/** Move a blastable to its current cell in the spatial index. Called by blastables when they move. */
+	void UpdateBlastable(UBlastableComponent* Blastable);
+
+	/// <summary>
+	/// Apply queued blasts. Called automatically once per frame, but can be called earlier
+	/// from the game thread when blasts must be visible in the current frame. Blasts past
+	/// `ab.MaxBlastsPerFrame` for this frame stay queued for the next one.
+	/// </summary>
+	void FlushBlasts();
+
+	/// <summary>
+	/// Show an impact effect, reusing the oldest one alive when `ab.ImpactEffectPoolSize` effects already are. Game thread only.
+	/// </summary>
+	/// <param name="Effect"> Effect to show, nothing happens if null </param>
+	/// <param name="Location"> Location of the impact in world space </param>
+	/// <param name="Rotation"> Rotation of the effect, usually facing along the impact normal </param>
+	void SpawnImpactEffect(UNiagaraSystem* Effect, const FVector& Location, const FRotator& Rotation);
+
+	/// <summary>
+	/// Run an impact effect once, so its system instance and GPU resources are set up while loading
+	/// rather than on the first impact. The component joins the impact effect pool. Game thread only.
+	/// </summary>
+	/// <param name="Effect"> Effect to warm up, nothing happens if null </param>
+	void WarmUpImpactEffect(UNiagaraSystem* Effect);
+
+	/// <summary>
+	/// Apply the current scalability settings to every registered blastable and to the impact effect pool. 
+	/// Called when the settings change. Game thread only.
+	/// </summary>
+	void ApplyScalability();
+
+	/// <summary>
+	/// Let every blastable roll back its predictions of shots the server resolved somewhere else. Game thread only.
+	/// </summary>
+	/// <param name="FirstShotId"> Id of the first shot the server resolved </param>
+	/// <param name="NumShots"> Amount of consecutive shot ids resolved </param>
+	/// <param name="Hits"> Armor the resolved shots hit on the server </param>
+	void ResolvePredictions(uint16 FirstShotId, int32 NumShots, TArrayView<const FBlastableShotHit> Hits);
+
+	/// <summary>
+	/// Take one event from the budget of blast events replicated every second. The budget is shared
+	/// by every blastable in the world, so the event stream clients receive doesn't grow with the
+	/// fire rate or the amount of enemies.
+	/// </summary>
+	/// <returns> False if the budget is spent, and the event should not be replicated </returns>
+	bool ConsumeNetEventBudget();
+
+	/// <summary>
+	/// Let the subsystem splat the CPU damage stamps of a blastable with the next flush. Game thread only.
+	/// </summary>
+	void MarkCpuDamageDirty(UBlastableComponent* Blastable);
+
+	/// <summary>
+	/// Get the tiles blastables using the CPU backend keep their damage in, set up on first use. Game thread only.
+	/// </summary>
+	FBlastableDamageTilePool& GetDamageTilePool();
+
+	/** Renderer drawing the damage of every blastable in one render graph per frame, null on machines that don't render */
+	FBlastableDamageRenderer* GetDamageRenderer() const { return DamageRenderer.Get(); }
+
+	// FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override { return bInitialized; }
+	virtual ETickableTickType GetTickableTickType() const override { return ETickableTickType::Conditional; }
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	// End of FTickableGameObject interface
+
+protected:
+	/** Pending blasts, pushed from any thread and popped on the game thread */
+	TQueue<FBlastRequest, EQueueMode::Mpsc> PendingBlasts;
+
+	/** Set between Initialize and Deinitialize */
+	bool bInitialized = false;
+
+	/** Blasts popped from the queue during a flush, kept around to reuse its memory */
+	TArray<FBlastRequest> FlushScratch;
+
+	/** Blasts popped past the budget of a frame, applied before the queue on the next flush */
+	TArray<FBlastRequest> DeferredBlasts;
+
+	/** Blasts applied during `BudgetFrame` */
+	int32 BlastsThisFrame = 0;
+
+	/** Frame `BlastsThisFrame` counts blasts for */
+	uint64 BudgetFrame = 0;
+
+	/** Impact effects spawned through `SpawnImpactEffect`, reused in a ring once the pool is full */
+	UPROPERTY(Transient)
+	TArray<UNiagaraComponent*> ImpactEffectPool;
+
+	/** Slot of the pool the next impact effect goes to */
+	int32 NextImpactEffect = 0;
+
+	/** Get the spatial index cell that contains `Location` */
+	FIntVector GetCell(const FVector& Location) const;
+
+	/** Size in cm of the spatial index cells */
+	float SpatialCellSize = 1000.f;
+
+	/// <summary>
+	/// Splat the pending CPU damage stamps of every blastable in parallel, then upload what they touched
+	/// </summary>
+	void FlushCpuDamage();
+
+	/** Blastables with CPU damage stamps waiting to be splatted */
+	TArray<TWeakObjectPtr<UBlastableComponent>> CpuDamageDirty;
+
+	/** Scene view extension drawing queued stamps and fades right before the scene renders */
+	TSharedPtr<FBlastableDamageRenderer, ESPMode::ThreadSafe> DamageRenderer;
+
+	/** Damage tiles shared by every blastable using the CPU backend */
+	FBlastableDamageTilePool DamageTilePool;
+
+	/** Most damage tiles the pool can hand out at the same time */
+	int32 DamageTileCapacity = 1024;
+
+	/** Blastables in every non empty cell. Blastables unregister when they end play, so raw pointers are safe here. */
+	TMap<FIntVector, TArray<UBlastableComponent*, TInlineAllocator<4>>> SpatialCells;
+
+	/** Cell where every registered blastable currently is */
+	TMap<UBlastableComponent*, FIntVector> BlastableCells;
+
+	/** Blast events replicated every second, across every blastable in the world */
+	float MaxNetEventsPerSecond = 60.f;
+
+	/** Events left in the budget, refilled every tick */
+	float NetEventBudget = 0.f;
+
+	/** Largest bounds radius of all registered blastables, used to grow queries so that they catch armor spilling out of its cell */
+	float MaxBoundsRadius = 0.f;
+};
@@ -0,0 +1,275 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BlastableTelemetry.h"
+#include "HAL/RunnableThread.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/Event.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/DateTime.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+	/** "ABHT" read as a little endian integer */
+	const uint32 FileMagic = 0x54484241;
+	const uint32 FileVersion = 1;
+
+	/** Chunks a file is made of, after its header */
+	enum class EChunk : uint8
+	{
+		/** Table, id and name of a class or weapon */
+		Name,
+
+		/** Amount of hits, then the hits as raw memory */
+		Hits
+	};
+
+	enum ETable : uint8
+	{
+		Table_Class,
+		Table_Weapon
+	};
+
+	/** Hits the ring holds, enough for several seconds of every weapon firing at once */
+	const uint32 RingCapacity = 1 << 16;
+
+	/** Milliseconds between two flushes of the writer thread */
+	const uint32 FlushIntervalMs = 500;
+
+	FAutoConsoleCommand StartCommand(
+		TEXT("ab.Telemetry.Start"),
+		TEXT("Start recording where blasts hit armor. Takes an optional file name, a new file under Saved/BlastTelemetry by default."),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		FBlastableTelemetry::Get().StartRecording(Args.Num() > 0 ? Args[0] : FString());
+	}));
+
+	FAutoConsoleCommand StopCommand(
+		TEXT("ab.Telemetry.Stop"),
+		TEXT("Stop recording where blasts hit armor, and close the file."),
+		FConsoleCommandDelegate::CreateLambda([]()
+	{
+		FBlastableTelemetry::Get().StopRecording();
+	}));
+}
+
+const TCHAR* FBlastableTelemetry::FileExtension = TEXT(".abhits");
+
+FBlastableTelemetry& FBlastableTelemetry::Get()
+{
+	static FBlastableTelemetry Instance;
+	return Instance;
+}
+
+FBlastableTelemetry::FBlastableTelemetry()
+	: bStopping(false)
+{
+}
+
+FString FBlastableTelemetry::GetDefaultDirectory()
+{
+	return FPaths::ProjectSavedDir() / TEXT("BlastTelemetry");
+}
+
+bool FBlastableTelemetry::StartRecording(const FString& InFilename)
+{
+	check(IsInGameThread());
+	if (bRecording)
+		return false;
+
+	Filename = !InFilename.IsEmpty() ? InFilename : GetDefaultDirectory() / FString::Printf(TEXT("Hits-%s%s"), *FDateTime::Now().ToString(), FileExtension);
+	Writer.Reset(IFileManager::Get().CreateFileWriter(*Filename));
+	if (!Writer.IsValid())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Could not create blast telemetry file %s"), *Filename);
+		return false;
+	}
+
+	uint32 Magic = FileMagic;
+	uint32 Version = FileVersion;
+	*Writer << Magic << Version;
+
+	// Make sure the last hits reach the file when the game quits while recording
+	static bool bExitHooked = false;
+	if (!bExitHooked)
+	{
+		FCoreDelegates::OnExit.AddLambda([]() { FBlastableTelemetry::Get().StopRecording(); });
+		bExitHooked = true;
+	}
+
+	if (!Records.IsValid())
+		Records = MakeUnique<TCircularQueue<FBlastableHitRecord>>(RingCapacity);
+
+	ClassIds.Reset();
+	WeaponIds.Reset();
+	Dropped = 0;
+	RecordedSinceWakeUp = 0;
+	StartTime = FPlatformTime::Seconds();
+	bStopping = false;
+	WakeUp = FPlatformProcess::GetSynchEventFromPool();
+	Thread = FRunnableThread::Create(this, TEXT("BlastableTelemetry"), 0, TPri_BelowNormal);
+	bRecording = true;
+
+	UE_LOG(LogTemp, Display, TEXT("Recording blast telemetry to %s"), *Filename);
+	return true;
+}
+
+void FBlastableTelemetry::StopRecording()
+{
+	check(IsInGameThread());
+	if (!bRecording)
+		return;
+
+	bRecording = false;
+	bStopping = true;
+	WakeUp->Trigger();
+	if (Thread != nullptr)
+	{
+		Thread->WaitForCompletion();
+		delete Thread;
+		Thread = nullptr;
+	}
+	FPlatformProcess::ReturnSynchEventToPool(WakeUp);
+	WakeUp = nullptr;
+
+	// The thread is gone, whatever it didn't see goes in from here
+	WritePending();
+	Writer->Close();
+	Writer.Reset();
+
+	if (Dropped > 0)
+		UE_LOG(LogTemp, Warning, TEXT("Blast telemetry dropped %d hits, the writer thread could not keep up"), Dropped);
+	UE_LOG(LogTemp, Display, TEXT("Stopped recording blast telemetry to %s"), *Filename);
+}
+
+void FBlastableTelemetry::RecordHit(FName BlastableClass, int32 Piece, const FVector2D& UV, float UVRadius, FName Weapon)
+{
+	checkSlow(IsInGameThread() && bRecording);
+
+	FBlastableHitRecord Record;
+	Record.Class = InternName(ClassIds, Table_Class, BlastableClass);
+	Record.Weapon = InternName(WeaponIds, Table_Weapon, Weapon);
+	Record.Piece = static_cast<uint16>(FMath::Clamp(Piece, 0, int32(MAX_uint16)));
+	Record.U = UV.X;
+	Record.V = UV.Y;
+	Record.UVRadius = UVRadius;
+	Record.Time = static_cast<float>(FPlatformTime::Seconds() - StartTime);
+
+	if (!Records->Enqueue(Record))
+	{
+		Dropped++;
+		return;
+	}
+
+	// Don't wait for the next flush when hits come in faster than usual
+	if (++RecordedSinceWakeUp >= int32(RingCapacity / 4))
+	{
+		RecordedSinceWakeUp = 0;
+		WakeUp->Trigger();
+	}
+}
+
+uint16 FBlastableTelemetry::InternName(TMap<FName, uint16>& Ids, uint8 Table, FName Name)
+{
+	if (auto const Id = Ids.Find(Name))
+		return *Id;
+
+	// Ids past the table size share the last one, more than 65k classes or weapons is not a real case
+	const uint16 Id = static_cast<uint16>(FMath::Min(Ids.Num(), int32(MAX_uint16)));
+	Ids.Add(Name, Id);
+
+	FNameEntry Entry;
+	Entry.Table = Table;
+	Entry.Id = Id;
+	Entry.Name = Name.ToString();
+	PendingNames.Enqueue(MoveTemp(Entry));
+	return Id;
+}
+
+uint32 FBlastableTelemetry::Run()
+{
+	while (!bStopping)
+	{
+		WakeUp->Wait(FlushIntervalMs);
+		WritePending();
+	}
+
+	return 0;
+}
+
+void FBlastableTelemetry::WritePending()
+{
+	FArchive& Ar = *Writer;
+
+	// Names go first. Hits recorded after this point might use names written by the next flush, so
+	// readers resolve names once the whole file is read.
+	FNameEntry Entry;
+	while (PendingNames.Dequeue(Entry))
+	{
+		uint8 Chunk = static_cast<uint8>(EChunk::Name);
+		Ar << Chunk << Entry.Table << Entry.Id << Entry.Name;
+	}
+
+	WriteScratch.Reset();
+	FBlastableHitRecord Record;
+	while (Records->Dequeue(Record))
+		WriteScratch.Add(Record);
+
+	if (WriteScratch.Num() == 0)
+		return;
+
+	uint8 Chunk = static_cast<uint8>(EChunk::Hits);
+	int32 NumHits = WriteScratch.Num();
+	Ar << Chunk << NumHits;
+	Ar.Serialize(WriteScratch.GetData(), WriteScratch.Num() * sizeof(FBlastableHitRecord));
+	Ar.Flush();
+}
+
+bool FBlastableTelemetryFile::Read(const FString& Filename)
+{
+	TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*Filename));
+	if (!Reader.IsValid())
+		return false;
+
+	FArchive& Ar = *Reader;
+	uint32 Magic = 0;
+	uint32 Version = 0;
+	Ar << Magic << Version;
+	if (Ar.IsError() || Magic != FileMagic || Version > FileVersion)
+		return false;
+
+	while (!Ar.AtEnd() && !Ar.IsError())
+	{
+		uint8 Chunk = 0;
+		Ar << Chunk;
+		if (Chunk == static_cast<uint8>(EChunk::Name))
+		{
+			uint8 Table = 0;
+			uint16 Id = 0;
+			FString Name;
+			Ar << Table << Id << Name;
+			if (!Ar.IsError())
+				(Table == Table_Class ? Classes : Weapons).Add(Id, MoveTemp(Name));
+		}
+		else if (Chunk == static_cast<uint8>(EChunk::Hits))
+		{
+			int32 NumHits = 0;
+			Ar << NumHits;
+
+			// The game might have quit in the middle of a write, keep what is complete
+			const int64 Available = (Ar.TotalSize() - Ar.Tell()) / int64(sizeof(FBlastableHitRecord));
+			NumHits = int32(FMath::Clamp<int64>(NumHits, 0, Available));
+
+			const int32 First = Hits.AddUninitialized(NumHits);
+			Ar.Serialize(Hits.GetData() + First, NumHits * sizeof(FBlastableHitRecord));
+		}
+		else
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Unknown chunk in blast telemetry file %s, ignoring the rest of it"), *Filename);
+			break;
+		}
+	}
+
+	return true;
+}
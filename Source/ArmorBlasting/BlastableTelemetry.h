@@ -0,0 +1,159 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "Containers/CircularQueue.h"
+#include "Containers/Queue.h"
+
+/** A hit on a piece of armor, as written to telemetry files. Fixed size, written as raw memory. */
+struct FBlastableHitRecord
+{
+	/** Blastable class, an id of the class table of the file */
+	uint16 Class = 0;
+
+	/** Weapon that fired the hit, an id of the weapon table of the file */
+	uint16 Weapon = 0;
+
+	/** Piece hit, index of the blastable mesh in the owner */
+	uint16 Piece = 0;
+
+	uint16 Reserved = 0;
+
+	/** Point hit in the shared UV layout of the armor */
+	float U = 0.f;
+	float V = 0.f;
+
+	/** Radius of the blast in UV space, as stamped in the integrity grid */
+	float UVRadius = 0.f;
+
+	/** Seconds since recording started */
+	float Time = 0.f;
+};
+static_assert(sizeof(FBlastableHitRecord) == 24, "Telemetry files store hit records as raw memory");
+
+/** Contents of a telemetry file */
+struct FBlastableTelemetryFile
+{
+	/** Class names by id */
+	TMap<uint16, FString> Classes;
+
+	/** Weapon names by id */
+	TMap<uint16, FString> Weapons;
+
+	/** Hits in the order they were recorded */
+	TArray<FBlastableHitRecord> Hits;
+
+	/// <summary>
+	/// Read a telemetry file
+	/// </summary>
+	/// <returns> False if the file could not be opened or isn't a telemetry file. Truncated files keep the hits read until the cut. </returns>
+	ARMORBLASTING_API bool Read(const FString& Filename);
+};
+
+/**
+ * Opt in recorder of where blasts hit armor, to tune UV density and piece sizes with real play data.
+ *
+ * Recording a hit interns its class and weapon names and pushes a fixed size record into a lock free
+ * single producer single consumer ring, nothing else. A background thread drains the ring twice a
+ * second, or as soon as it is a quarter full, and appends it to a compact binary file. Hits that find
+ * the ring full are dropped and counted, recording never blocks the game thread.
+ *
+ * Start with `ab.Telemetry.Start [File]` or the `-BlastTelemetry` command line switch, stop with
+ * `ab.Telemetry.Stop`. `UBlastableHeatmapCommandlet` turns the files into UV heatmaps per class.
+ */
+class ARMORBLASTING_API FBlastableTelemetry : public FRunnable
+{
+public:
+	static FBlastableTelemetry& Get();
+
+	/** Extension of telemetry files */
+	static const TCHAR* FileExtension;
+
+	/** Folder telemetry files go to when started without a file name */
+	static FString GetDefaultDirectory();
+
+	/// <summary>
+	/// Start writing hits to a file. Game thread only.
+	/// </summary>
+	/// <param name="Filename"> File to write, a new file in the default directory if empty </param>
+	/// <returns> False if already recording, or if the file could not be created </returns>
+	bool StartRecording(const FString& Filename = FString());
+
+	/** Write every hit still in the ring and close the file. Game thread only. */
+	void StopRecording();
+
+	/** Whether hits are being recorded. Checked before gathering anything for a hit. */
+	bool IsRecording() const { return bRecording; }
+
+	/// <summary>
+	/// Record a hit. Game thread only, and only while recording.
+	/// </summary>
+	/// <param name="BlastableClass"> Name of the class owning the blastable </param>
+	/// <param name="Piece"> Index of the piece hit </param>
+	/// <param name="UV"> Point hit in the shared UV layout </param>
+	/// <param name="UVRadius"> Radius of the blast in UV space </param>
+	/// <param name="Weapon"> Weapon that fired the hit, none if unknown </param>
+	void RecordHit(FName BlastableClass, int32 Piece, const FVector2D& UV, float UVRadius, FName Weapon);
+
+	// FRunnable interface
+	virtual uint32 Run() override;
+	// End of FRunnable interface
+
+private:
+	FBlastableTelemetry();
+
+	/** Entry of the class or weapon tables, written before the first chunk of hits using it */
+	struct FNameEntry
+	{
+		uint8 Table = 0;
+		uint16 Id = 0;
+		FString Name;
+	};
+
+	/** Id of a name in one of the tables, queueing it for the file the first time */
+	uint16 InternName(TMap<FName, uint16>& Ids, uint8 Table, FName Name);
+
+	/** Append queued names and hits to the file. Writer thread only, or game thread once it stopped. */
+	void WritePending();
+
+	/** Hits recorded and not written yet. The game thread pushes, the writer thread pops. Created by
+		the first recording, so sessions that never record don't pay for the ring.
+	*/
+	TUniquePtr<TCircularQueue<FBlastableHitRecord>> Records;
+
+	/** Names interned and not written yet */
+	TQueue<FNameEntry, EQueueMode::Spsc> PendingNames;
+
+	/** Ids of the names seen by this recording, game thread only */
+	TMap<FName, uint16> ClassIds;
+	TMap<FName, uint16> WeaponIds;
+
+	/** File being written, owned by the writer thread while it runs */
+	TUniquePtr<FArchive> Writer;
+
+	/** Hits popped from the ring, written in a single call */
+	TArray<FBlastableHitRecord> WriteScratch;
+
+	FRunnableThread* Thread = nullptr;
+
+	/** Wakes the writer thread before its next scheduled flush */
+	FEvent* WakeUp = nullptr;
+
+	/** Set to let the writer thread finish */
+	TAtomic<bool> bStopping;
+
+	bool bRecording = false;
+
+	/** Time recording started, hit times are relative to it */
+	double StartTime = 0.0;
+
+	/** Hits recorded since the writer thread was last woken up */
+	int32 RecordedSinceWakeUp = 0;
+
+	/** Hits lost because the ring was full */
+	int32 Dropped = 0;
+
+	FString Filename;
+};
@@ -0,0 +1,47 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BlastableTrace.h"
+#include "BlastableComponent.h"
+#include "ArmorBlasting.h"
+#include "Engine/World.h"
+#include "Components/PrimitiveComponent.h"
+
+namespace BlastableTrace
+{
+	bool LineTraceThroughHoles(UWorld* World, FHitResult& OutHit, const FVector& Start, const FVector& End, FCollisionQueryParams QueryParams, int32 MaxPassThrough)
+	{
+		if (World == nullptr)
+			return false;
+
+		QueryParams.bReturnFaceIndex = true;
+
+		for (int32 PassThrough = 0; PassThrough <= MaxPassThrough; PassThrough++)
+		{
+			if (!World->LineTraceSingleByChannel(OutHit, Start, End, ECC_Enemy, QueryParams))
+				return false;
+
+			// Anything that is not an armor piece can't have holes
+			auto const Blastable = GetHitBlastable(OutHit);
+			if (Blastable == nullptr || !Blastable->IsHoleAt(OutHit))
+				return true;
+
+			// Shot went through a hole, ignore this piece and try again
+			QueryParams.AddIgnoredComponent(OutHit.GetComponent());
+		}
+
+		// Too many layers, the last hit is a hole too and there is nothing left to blast there
+		return false;
+	}
+
+	UBlastableComponent* GetHitBlastable(const FHitResult& Hit)
+	{
+		auto const Component = Hit.GetComponent();
+
+		// Tag check first, it's way cheaper than searching the owner components
+		if (Component == nullptr || !Component->ComponentHasTag(FName("BlastableMesh")))
+			return nullptr;
+
+		auto const Owner = Component->GetOwner();
+		return Owner != nullptr ? Owner->FindComponentByClass<UBlastableComponent>() : nullptr;
+	}
+}
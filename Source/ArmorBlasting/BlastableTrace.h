@@ -0,0 +1,32 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CollisionQueryParams.h"
+
+class UWorld;
+class UBlastableComponent;
+
+namespace BlastableTrace
+{
+	/// <summary>
+	/// Line trace in the `ECC_Enemy` channel that goes through holes blasted in armor. When a trace
+	/// lands on a blastable piece that is already destroyed at the hit point, the piece is ignored
+	/// and the trace is repeated, so shots can reach whatever is under the armor. Game thread only.
+	/// </summary>
+	/// <param name="World"> World to trace in </param>
+	/// <param name="OutHit"> First hit that did not land on a hole </param>
+	/// <param name="Start"> Trace start in world space </param>
+	/// <param name="End"> Trace end in world space </param>
+	/// <param name="QueryParams"> Query parameters, face indices are always requested since they are needed to map hits to UVs </param>
+	/// <param name="MaxPassThrough"> Maximum amount of pieces a single trace can go through </param>
+	/// <returns> True if something was hit, false if nothing was, or if the trace went through `MaxPassThrough` holes without reaching anything else </returns>
+	ARMORBLASTING_API bool LineTraceThroughHoles(UWorld* World, FHitResult& OutHit, const FVector& Start, const FVector& End, FCollisionQueryParams QueryParams, int32 MaxPassThrough = 4);
+
+	/// <summary>
+	/// Get the blastable component that owns the piece hit by `Hit`
+	/// </summary>
+	/// <returns> Blastable component, or null if the hit component is not tagged as 'BlastableMesh' </returns>
+	ARMORBLASTING_API UBlastableComponent* GetHitBlastable(const FHitResult& Hit);
+}
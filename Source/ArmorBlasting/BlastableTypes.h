@@ -0,0 +1,52 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/EngineTypes.h"
+
+class UBlastableComponent;
+
+/**
+ * Layered erosion of armor, packed in a single damage value per texel.
+ *
+ * Repeated hits take a texel through paint, primer and bare metal before breaching it. Each layer
+ * takes a quarter of the damage range, so the state of every texel is the one value stamps add to
+ * and the damage targets already store, saturating once it is fully breached.
+ */
+namespace BlastableErosion
+{
+	/** Damage every layer takes before the next one shows */
+	constexpr float LayerSize = 0.25f;
+
+	/** Damage at which the metal starts to open */
+	constexpr float BreachStart = 3.f * LayerSize;
+
+	/** How much of a texel is breached, in [0, 1], for its damage in [0, 1] */
+	inline float GetBreach(float Damage) { return FMath::Clamp((Damage - BreachStart) / LayerSize, 0.f, 1.f); }
+
+	/** Exposed layer of a texel: 0 paint, 1 primer, 2 bare metal, 3 breach */
+	inline int32 GetLayer(float Damage) { return FMath::Clamp(FMath::FloorToInt(Damage / LayerSize), 0, 3); }
+}
+
+/** A blast waiting to be applied on the game thread */
+struct FBlastRequest
+{
+	/** Blastable to damage */
+	TWeakObjectPtr<UBlastableComponent> Target;
+
+	/** Trace result against the armor, only meaningful if `bHasHit` is set */
+	FHitResult Hit;
+
+	/** Location in world space where the blastable was hit */
+	FVector Location = FVector::ZeroVector;
+
+	/** Size of area of effect around `Location` */
+	float Radius = 0.f;
+
+	/** Whether `Hit` holds a valid hit against one of the target pieces */
+	bool bHasHit = false;
+
+	/** Weapon that fired the blast, only used by telemetry */
+	FName Weapon;
+};
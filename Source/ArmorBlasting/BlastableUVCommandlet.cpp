@@ -0,0 +1,357 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BlastableUVCommandlet.h"
+#include "BlastableComponent.h"
+#include "BlastableUVLayout.h"
+
+#if WITH_EDITOR
+#include "AssetRegistryModule.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/Blueprint.h"
+#include "Engine/SCS_Node.h"
+#include "Engine/SimpleConstructionScript.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/World.h"
+#include "MeshDescription.h"
+#include "StaticMeshAttributes.h"
+#include "Misc/PackageName.h"
+#endif
+
+UBlastableUVCommandlet::UBlastableUVCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+}
+
+#if WITH_EDITOR
+namespace
+{
+	const FName BlastableMeshTag("BlastableMesh");
+
+	/// <summary>
+	/// Build the layout of a piece from the source geometry of its mesh, which is always available in the editor
+	/// </summary>
+	bool BuildLayoutFromMeshDescription(const UStaticMesh* StaticMesh, const FVector& Scale, int32 Resolution, FBlastablePieceLayout& OutLayout)
+	{
+		const FMeshDescription* MeshDescription = StaticMesh != nullptr ? StaticMesh->GetMeshDescription(0) : nullptr;
+		if (MeshDescription == nullptr)
+			return false;
+
+		auto const VertexPositions = MeshDescription->VertexAttributes().GetAttributesRef<FVector>(MeshAttribute::Vertex::Position);
+		auto const VertexUVs = MeshDescription->VertexInstanceAttributes().GetAttributesRef<FVector2D>(MeshAttribute::VertexInstance::TextureCoordinate);
+		if (VertexUVs.GetNumIndices() == 0)
+			return false;
+
+		TArray<int32> Indices;
+		TArray<FVector> Positions;
+		TArray<FVector2D> UVs;
+		for (const FTriangleID TriangleID : MeshDescription->Triangles().GetElementIDs())
+		{
+			for (const FVertexInstanceID InstanceID : MeshDescription->GetTriangleVertexInstances(TriangleID))
+			{
+				Indices.Add(Positions.Num());
+				Positions.Add(VertexPositions[MeshDescription->GetVertexInstanceVertex(InstanceID)] * Scale);
+				UVs.Add(VertexUVs.Get(InstanceID, 0));
+			}
+		}
+
+		return FBlastablePieceLayout::Build(Indices, Positions, UVs, Resolution, OutLayout);
+	}
+
+	/// <summary>
+	/// Place boxes in the unit square in shelves, tallest first
+	/// </summary>
+	/// <returns> False if they don't fit </returns>
+	bool ShelfPack(const TArray<FVector2D>& Sizes, float Padding, TArray<FVector2D>& OutOffsets)
+	{
+		TArray<int32> Order;
+		for (int i = 0; i < Sizes.Num(); i++)
+			Order.Add(i);
+		Order.Sort([&Sizes](int32 A, int32 B) { return Sizes[A].Y > Sizes[B].Y; });
+
+		OutOffsets.SetNum(Sizes.Num());
+		float X = Padding, Y = Padding, ShelfHeight = 0.f;
+		for (auto const i : Order)
+		{
+			if (X + Sizes[i].X + Padding > 1.f)
+			{
+				Y += ShelfHeight + Padding;
+				X = Padding;
+				ShelfHeight = 0.f;
+			}
+
+			if (X + Sizes[i].X + Padding > 1.f || Y + Sizes[i].Y + Padding > 1.f)
+				return false;
+
+			OutOffsets[i] = FVector2D(X, Y);
+			X += Sizes[i].X + Padding;
+			ShelfHeight = FMath::Max(ShelfHeight, Sizes[i].Y);
+		}
+
+		return true;
+	}
+
+	bool SaveAssetPackage(UObject* Asset)
+	{
+		UPackage* Package = Asset->GetOutermost();
+		const FString Filename = FPackageName::LongPackageNameToFilename(Package->GetName(), FPackageName::GetAssetPackageExtension());
+		return UPackage::SavePackage(Package, nullptr, RF_Standalone, *Filename);
+	}
+
+	/// <summary>
+	/// Find the blastable component template of a blueprint, either added by the blueprint itself or created in C++
+	/// </summary>
+	UBlastableComponent* FindBlastableTemplate(UBlueprint* Blueprint)
+	{
+		if (Blueprint->SimpleConstructionScript != nullptr)
+		{
+			for (auto const Node : Blueprint->SimpleConstructionScript->GetAllNodes())
+			{
+				if (auto const Template = Cast<UBlastableComponent>(Node->ComponentTemplate))
+					return Template;
+			}
+		}
+
+		auto const DefaultActor = Cast<AActor>(Blueprint->GeneratedClass->GetDefaultObject());
+		return DefaultActor != nullptr ? DefaultActor->FindComponentByClass<UBlastableComponent>() : nullptr;
+	}
+}
+#endif
+
+int32 UBlastableUVCommandlet::Main(const FString& Params)
+{
+#if WITH_EDITOR
+	TArray<FString> Tokens;
+	TArray<FString> Switches;
+	TMap<FString, FString> ParamValues;
+	ParseCommandLine(*Params, Tokens, Switches, ParamValues);
+
+	FString Path = TEXT("/Game");
+	if (auto const PathParam = ParamValues.Find(TEXT("Path")))
+		Path = *PathParam;
+
+	if (auto const TexelsParam = ParamValues.Find(TEXT("TexelsPerCm")))
+		TexelsPerCm = FMath::Max(FCString::Atof(**TexelsParam), KINDA_SMALL_NUMBER);
+
+	bRepack = Switches.Contains(TEXT("Repack"));
+	bOverwrite = Switches.Contains(TEXT("Overwrite"));
+	bApply = Switches.Contains(TEXT("Apply"));
+
+	// Find every blueprint under the requested path
+	auto& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>(TEXT("AssetRegistry")).Get();
+	AssetRegistry.SearchAllAssets(true);
+
+	FARFilter Filter;
+	Filter.ClassNames.Add(UBlueprint::StaticClass()->GetFName());
+	Filter.PackagePaths.Add(FName(*Path));
+	Filter.bRecursivePaths = true;
+	Filter.bRecursiveClasses = true;
+
+	TArray<FAssetData> Assets;
+	AssetRegistry.GetAssets(Filter, Assets);
+
+	// Armor pieces are only known once construction scripts run, so actors are spawned in a scratch world
+	UWorld* World = UWorld::CreateWorld(EWorldType::Inactive, false);
+
+	int32 Processed = 0;
+	int32 WithProblems = 0;
+	for (auto const& Asset : Assets)
+	{
+		auto const Blueprint = Cast<UBlueprint>(Asset.GetAsset());
+		if (Blueprint == nullptr || Blueprint->GeneratedClass == nullptr || !Blueprint->GeneratedClass->IsChildOf(AActor::StaticClass()))
+			continue;
+
+		if (FindBlastableTemplate(Blueprint) == nullptr)
+			continue;
+
+		Processed++;
+		if (!ProcessBlueprint(Blueprint, World))
+			WithProblems++;
+	}
+
+	World->DestroyWorld(false);
+
+	UE_LOG(LogTemp, Display, TEXT("BlastableUV: checked %d blastable classes, %d with UV problems"), Processed, WithProblems);
+	return WithProblems > 0 ? 1 : 0;
+#else
+	UE_LOG(LogTemp, Error, TEXT("BlastableUV commandlet can only run in the editor"));
+	return 1;
+#endif
+}
+
+#if WITH_EDITOR
+bool UBlastableUVCommandlet::ProcessBlueprint(UBlueprint* Blueprint, UWorld* World)
+{
+	FActorSpawnParameters SpawnParameters;
+	SpawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	SpawnParameters.ObjectFlags = RF_Transient;
+
+	auto const Actor = World->SpawnActor<AActor>(Blueprint->GeneratedClass, FTransform::Identity, SpawnParameters);
+	if (Actor == nullptr)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("BlastableUV: could not spawn %s"), *Blueprint->GetName());
+		return false;
+	}
+
+	auto const Blastable = Actor->FindComponentByClass<UBlastableComponent>();
+
+	TArray<UStaticMeshComponent*> Pieces;
+	for (auto const Component : Actor->GetComponentsByTag(UStaticMeshComponent::StaticClass(), BlastableMeshTag))
+	{
+		auto const Piece = Cast<UStaticMeshComponent>(Component);
+		if (Piece != nullptr && Piece->GetStaticMesh() != nullptr)
+			Pieces.Add(Piece);
+	}
+
+	auto const MeasureLayouts = [this, &Pieces]()
+	{
+		TArray<FBlastablePieceLayout> Layouts;
+		Layouts.SetNum(Pieces.Num());
+		for (int i = 0; i < Pieces.Num(); i++)
+			BuildLayoutFromMeshDescription(Pieces[i]->GetStaticMesh(), Pieces[i]->GetComponentScale(), MaskResolution, Layouts[i]);
+		return FBlastableArmorLayoutStats::Compute(Layouts);
+	};
+
+	// Two pieces using the same mesh always land on the same UVs, no repacking can fix that
+	TSet<UStaticMesh*> SeenMeshes;
+	for (auto const Piece : Pieces)
+	{
+		bool bAlreadySeen = false;
+		SeenMeshes.Add(Piece->GetStaticMesh(), &bAlreadySeen);
+		if (bAlreadySeen)
+			UE_LOG(LogTemp, Warning, TEXT("BlastableUV: %s: piece %s reuses mesh %s, its damage will show up on every piece using it"), *Blueprint->GetName(), *Piece->GetName(), *Piece->GetStaticMesh()->GetName());
+	}
+
+	auto Stats = MeasureLayouts();
+	if (bRepack && RepackPieces(Pieces))
+		Stats = MeasureLayouts();
+
+	const int32 RecommendedSize = Stats.RecommendRenderTargetSize(TexelsPerCm);
+	UE_LOG(LogTemp, Display, TEXT("BlastableUV: %s: %d pieces, surface %.0f cm2, coverage %.1f%%, overlap between pieces %.1f%%, max self overlap %.1f%%, recommended render target %d (current %d)"),
+		*Blueprint->GetName(), Pieces.Num(), Stats.SurfaceArea, Stats.Coverage * 100.f, Stats.OverlapBetweenPieces * 100.f, Stats.MaxSelfOverlap * 100.f,
+		RecommendedSize, Blastable != nullptr ? Blastable->GetDamageRenderTargetSize() : 0);
+
+	if (bApply && Blastable != nullptr)
+		ApplyRenderTargetSize(Blueprint, Blastable->GetFName(), RecommendedSize);
+
+	Actor->Destroy();
+
+	// A bit of overlap is expected from rasterizing triangle edges into the masks
+	return Stats.OverlapBetweenPieces < 0.01f && Stats.MaxSelfOverlap < 0.05f;
+}
+
+bool UBlastableUVCommandlet::RepackPieces(const TArray<UStaticMeshComponent*>& Pieces)
+{
+	// One box per distinct mesh, measured at the scale of the first piece using it
+	TArray<UStaticMesh*> Meshes;
+	TArray<FBox2D> Bounds;
+	TArray<float> Densities;
+	for (auto const Piece : Pieces)
+	{
+		auto const StaticMesh = Piece->GetStaticMesh();
+		if (Meshes.Contains(StaticMesh))
+			continue;
+
+		FBlastablePieceLayout Layout;
+		if (!BuildLayoutFromMeshDescription(StaticMesh, Piece->GetComponentScale(), MaskResolution, Layout))
+			continue;
+
+		// Boxes are scaled so every mesh ends up with the same UV area per cm^2 of surface
+		Meshes.Add(StaticMesh);
+		Bounds.Add(Layout.UVBounds);
+		Densities.Add(1.f / Layout.UVPerCm);
+	}
+
+	if (Meshes.Num() == 0)
+		return false;
+
+	auto const SizesAtScale = [&Bounds, &Densities](float Scale)
+	{
+		TArray<FVector2D> Sizes;
+		for (int i = 0; i < Bounds.Num(); i++)
+			Sizes.Add(Bounds[i].GetSize() * Densities[i] * Scale);
+		return Sizes;
+	};
+
+	// Find the biggest global scale that still fits every box
+	const float Padding = 4.f / MaskResolution;
+	float MaxExtent = 0.f;
+	for (int i = 0; i < Bounds.Num(); i++)
+		MaxExtent = FMath::Max(MaxExtent, Bounds[i].GetSize().GetMax() * Densities[i]);
+
+	float Low = 0.f;
+	float High = MaxExtent > 0.f ? 1.f / MaxExtent : 0.f;
+	TArray<FVector2D> Offsets;
+	for (int Iteration = 0; Iteration < 24; Iteration++)
+	{
+		const float Mid = 0.5f * (Low + High);
+		if (ShelfPack(SizesAtScale(Mid), Padding, Offsets))
+			Low = Mid;
+		else
+			High = Mid;
+	}
+
+	if (Low <= 0.f || !ShelfPack(SizesAtScale(Low), Padding, Offsets))
+		return false;
+
+	// Meshes are shared assets, leave them alone unless explicitly asked to
+	if (!bOverwrite)
+	{
+		float PackedArea = 0.f;
+		for (auto const& Size : SizesAtScale(Low))
+			PackedArea += Size.X * Size.Y;
+
+		UE_LOG(LogTemp, Display, TEXT("BlastableUV: repacking %d meshes would cover %.1f%% of the UV space, run with -Overwrite to save them"), Meshes.Num(), PackedArea * 100.f);
+		return false;
+	}
+
+	for (int i = 0; i < Meshes.Num(); i++)
+	{
+		auto const StaticMesh = Meshes[i];
+		FMeshDescription* MeshDescription = StaticMesh->GetMeshDescription(0);
+		if (MeshDescription == nullptr)
+			continue;
+
+		const float Scale = Densities[i] * Low;
+		auto VertexUVs = MeshDescription->VertexInstanceAttributes().GetAttributesRef<FVector2D>(MeshAttribute::VertexInstance::TextureCoordinate);
+		for (const FVertexInstanceID InstanceID : MeshDescription->VertexInstances().GetElementIDs())
+			VertexUVs.Set(InstanceID, 0, Offsets[i] + (VertexUVs.Get(InstanceID, 0) - Bounds[i].Min) * Scale);
+
+		StaticMesh->CommitMeshDescription(0);
+		StaticMesh->Build(true);
+		StaticMesh->MarkPackageDirty();
+
+		if (!SaveAssetPackage(StaticMesh))
+			UE_LOG(LogTemp, Warning, TEXT("BlastableUV: could not save %s"), *StaticMesh->GetName());
+	}
+
+	return true;
+}
+
+bool UBlastableUVCommandlet::ApplyRenderTargetSize(UBlueprint* Blueprint, FName ComponentName, int32 Size)
+{
+	auto const Template = FindBlastableTemplate(Blueprint);
+	if (Template == nullptr)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("BlastableUV: %s: could not find template for %s"), *Blueprint->GetName(), *ComponentName.ToString());
+		return false;
+	}
+
+	if (Template->GetDamageRenderTargetSize() == Size)
+		return true;
+
+	Template->Modify();
+	Template->SetDamageRenderTargetSize(Size);
+	Blueprint->MarkPackageDirty();
+
+	if (!SaveAssetPackage(Blueprint))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("BlastableUV: could not save %s"), *Blueprint->GetName());
+		return false;
+	}
+
+	return true;
+}
+#endif
@@ -0,0 +1,67 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "BlastableUVCommandlet.generated.h"
+
+class UBlueprint;
+class UStaticMeshComponent;
+
+/**
+ * Checks the UV layout of every blastable armor set in the project.
+ *
+ * The unwrap pass writes damage in the shared UV layout of all armor pieces, so pieces must not
+ * overlap, and empty UV space is wasted damage texels. For every blueprint with a blastable
+ * component this reports surface area, coverage and overlap, and recommends a damage render
+ * target size for the requested texel density.
+ *
+ * Usage: UE4Editor-Cmd ArmorBlasting.uproject -run=BlastableUV [-Path=/Game] [-TexelsPerCm=2] [-Repack [-Overwrite]] [-Apply]
+ *   -Repack:    pack the UVs of every piece again, with the same texel density for all of them. Only
+ *               reports the packing unless -Overwrite is given too.
+ *   -Overwrite: write repacked UVs into the static mesh assets and save them. Meshes are shared by
+ *               every class and level using them, so this changes their UVs everywhere.
+ *   -Apply:     store the recommended size in the blastable component of every class and save it
+ */
+UCLASS()
+class ARMORBLASTING_API UBlastableUVCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UBlastableUVCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+#if WITH_EDITOR
+protected:
+	/// <summary>
+	/// Report the armor set of a single blueprint, and repack it or store its recommended size if asked to
+	/// </summary>
+	/// <returns> False if the armor set has problems that make damage show up in the wrong places </returns>
+	bool ProcessBlueprint(UBlueprint* Blueprint, UWorld* World);
+
+	/// <summary>
+	/// Pack the UV bounds of every distinct mesh into the unit square, sized by their surface area.
+	/// Meshes are only modified and saved with `-Overwrite`, otherwise the packing is just reported.
+	/// </summary>
+	/// <returns> True if the meshes were repacked </returns>
+	bool RepackPieces(const TArray<UStaticMeshComponent*>& Pieces);
+
+	/// <summary>
+	/// Store the recommended damage render target size in the blastable component template of a blueprint
+	/// </summary>
+	bool ApplyRenderTargetSize(UBlueprint* Blueprint, FName ComponentName, int32 Size);
+
+	/** Desired damage texels per centimeter of armor surface */
+	float TexelsPerCm = 2.f;
+
+	/** Resolution of the masks used to measure coverage and overlap */
+	int32 MaskResolution = 256;
+
+	bool bRepack = false;
+	bool bOverwrite = false;
+	bool bApply = false;
+#endif
+};
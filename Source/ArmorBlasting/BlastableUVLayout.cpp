@@ -0,0 +1,179 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BlastableUVLayout.h"
+#include "Components/PrimitiveComponent.h"
+#include "PhysicsEngine/BodySetup.h"
+
+namespace
+{
+	/** Twice the signed area of the triangle (A, B, C) */
+	float SignedArea2(const FVector2D& A, const FVector2D& B, const FVector2D& C)
+	{
+		return (B.X - A.X) * (C.Y - A.Y) - (C.X - A.X) * (B.Y - A.Y);
+	}
+
+	/** Mark every cell whose center lies inside the triangle, or the cell under its centroid if it is too small */
+	void RasterizeTriangle(const FVector2D& A, const FVector2D& B, const FVector2D& C, int32 Resolution, TBitArray<>& Mask)
+	{
+		const float Area = SignedArea2(A, B, C);
+		if (FMath::IsNearlyZero(Area))
+			return;
+
+		const int32 MinX = FMath::Clamp(FMath::FloorToInt(FMath::Min3(A.X, B.X, C.X) * Resolution), 0, Resolution - 1);
+		const int32 MaxX = FMath::Clamp(FMath::FloorToInt(FMath::Max3(A.X, B.X, C.X) * Resolution), 0, Resolution - 1);
+		const int32 MinY = FMath::Clamp(FMath::FloorToInt(FMath::Min3(A.Y, B.Y, C.Y) * Resolution), 0, Resolution - 1);
+		const int32 MaxY = FMath::Clamp(FMath::FloorToInt(FMath::Max3(A.Y, B.Y, C.Y) * Resolution), 0, Resolution - 1);
+
+		bool bMarkedAny = false;
+		for (int32 Y = MinY; Y <= MaxY; Y++)
+		{
+			for (int32 X = MinX; X <= MaxX; X++)
+			{
+				const FVector2D Center((X + 0.5f) / Resolution, (Y + 0.5f) / Resolution);
+				const float W0 = SignedArea2(B, C, Center) / Area;
+				const float W1 = SignedArea2(C, A, Center) / Area;
+				const float W2 = 1.f - W0 - W1;
+				if (W0 >= 0.f && W1 >= 0.f && W2 >= 0.f)
+				{
+					Mask[Y * Resolution + X] = true;
+					bMarkedAny = true;
+				}
+			}
+		}
+
+		if (!bMarkedAny)
+		{
+			const FVector2D Centroid = (A + B + C) / 3.f;
+			const int32 X = FMath::Clamp(FMath::FloorToInt(Centroid.X * Resolution), 0, Resolution - 1);
+			const int32 Y = FMath::Clamp(FMath::FloorToInt(Centroid.Y * Resolution), 0, Resolution - 1);
+			Mask[Y * Resolution + X] = true;
+		}
+	}
+}
+
+bool FBlastablePieceLayout::Build(const UPrimitiveComponent* Component, int32 InMaskResolution, FBlastablePieceLayout& OutLayout)
+{
+	if (Component == nullptr)
+		return false;
+
+	const UBodySetup* BodySetup = const_cast<UPrimitiveComponent*>(Component)->GetBodySetup();
+	if (BodySetup == nullptr || BodySetup->UVInfo.VertUVs.Num() == 0)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Could not build UV layout for %s: no UV info in its body setup"), *Component->GetName());
+		return false;
+	}
+
+	const FBodySetupUVInfo& UVInfo = BodySetup->UVInfo;
+
+	// Collision data is stored unscaled, bring it to world scale to get the actual surface
+	const FVector Scale = Component->GetComponentScale();
+	TArray<FVector> Positions;
+	Positions.Reserve(UVInfo.VertPositions.Num());
+	for (const FVector& Position : UVInfo.VertPositions)
+		Positions.Add(Position * Scale);
+
+	return Build(UVInfo.IndexBuffer, Positions, UVInfo.VertUVs[0], InMaskResolution, OutLayout);
+}
+
+bool FBlastablePieceLayout::Build(const TArray<int32>& Indices, const TArray<FVector>& Positions, const TArray<FVector2D>& UVs, int32 InMaskResolution, FBlastablePieceLayout& OutLayout)
+{
+	OutLayout = FBlastablePieceLayout();
+	OutLayout.MaskResolution = FMath::Max(InMaskResolution, 1);
+	OutLayout.Mask.Init(false, OutLayout.MaskResolution * OutLayout.MaskResolution);
+
+	for (int32 i = 0; i + 2 < Indices.Num(); i += 3)
+	{
+		const int32 I0 = Indices[i], I1 = Indices[i + 1], I2 = Indices[i + 2];
+		if (!Positions.IsValidIndex(I0) || !Positions.IsValidIndex(I1) || !Positions.IsValidIndex(I2) ||
+			!UVs.IsValidIndex(I0) || !UVs.IsValidIndex(I1) || !UVs.IsValidIndex(I2))
+			continue;
+
+		OutLayout.SurfaceArea += 0.5f * FVector::CrossProduct(Positions[I1] - Positions[I0], Positions[I2] - Positions[I0]).Size();
+		OutLayout.UVArea += 0.5f * FMath::Abs(SignedArea2(UVs[I0], UVs[I1], UVs[I2]));
+
+		OutLayout.UVBounds += UVs[I0];
+		OutLayout.UVBounds += UVs[I1];
+		OutLayout.UVBounds += UVs[I2];
+
+		RasterizeTriangle(UVs[I0], UVs[I1], UVs[I2], OutLayout.MaskResolution, OutLayout.Mask);
+	}
+
+	if (OutLayout.SurfaceArea > 0.f)
+		OutLayout.UVPerCm = FMath::Sqrt(OutLayout.UVArea / OutLayout.SurfaceArea);
+
+	OutLayout.MaskCellCount = 0;
+	for (TConstSetBitIterator<> It(OutLayout.Mask); It; ++It)
+		OutLayout.MaskCellCount++;
+
+	return OutLayout.IsValid();
+}
+
+void FBlastablePieceLayout::Rescale(const FVector& Ratio)
+{
+	if (Ratio.Equals(FVector::OneVector))
+		return;
+
+	SurfaceArea *= FMath::Pow(FMath::Abs(Ratio.X * Ratio.Y * Ratio.Z), 2.f / 3.f);
+	UVPerCm = SurfaceArea > 0.f ? FMath::Sqrt(UVArea / SurfaceArea) : 0.f;
+}
+
+FBlastableArmorLayoutStats FBlastableArmorLayoutStats::Compute(const TArray<FBlastablePieceLayout>& Layouts)
+{
+	FBlastableArmorLayoutStats Stats;
+
+	int32 Resolution = 0;
+	for (auto const& Layout : Layouts)
+	{
+		if (Layout.IsValid())
+			Resolution = FMath::Max(Resolution, Layout.MaskResolution);
+	}
+
+	if (Resolution == 0)
+		return Stats;
+
+	TBitArray<> Covered(false, Resolution * Resolution);
+	TBitArray<> Overlapped(false, Resolution * Resolution);
+	for (auto const& Layout : Layouts)
+	{
+		if (!Layout.IsValid() || Layout.MaskResolution != Resolution)
+			continue;
+
+		Stats.SurfaceArea += Layout.SurfaceArea;
+
+		// Cells marked by the rasterizer cover the UV area once, any UV area left over is folded over itself
+		const float MaskArea = float(Layout.MaskCellCount) / (Resolution * Resolution);
+		if (Layout.UVArea > 0.f)
+			Stats.MaxSelfOverlap = FMath::Max(Stats.MaxSelfOverlap, FMath::Max(0.f, 1.f - MaskArea / Layout.UVArea));
+
+		for (TConstSetBitIterator<> It(Layout.Mask); It; ++It)
+		{
+			const int32 Cell = It.GetIndex();
+			if (Covered[Cell])
+				Overlapped[Cell] = true;
+			Covered[Cell] = true;
+		}
+	}
+
+	int32 CoveredCells = 0;
+	for (TConstSetBitIterator<> It(Covered); It; ++It)
+		CoveredCells++;
+
+	int32 OverlappedCells = 0;
+	for (TConstSetBitIterator<> It(Overlapped); It; ++It)
+		OverlappedCells++;
+
+	Stats.Coverage = float(CoveredCells) / (Resolution * Resolution);
+	Stats.OverlapBetweenPieces = CoveredCells > 0 ? float(OverlappedCells) / CoveredCells : 0.f;
+	return Stats;
+}
+
+int32 FBlastableArmorLayoutStats::RecommendRenderTargetSize(float TexelsPerCm, int32 MinSize, int32 MaxSize) const
+{
+	if (SurfaceArea <= 0.f || Coverage <= 0.f)
+		return MaxSize;
+
+	// Only `Coverage` of the target lands on armor, so the whole target has to be that much bigger
+	const float Size = FMath::Sqrt(SurfaceArea / Coverage) * TexelsPerCm;
+	const int32 PowerOfTwo = int32(FMath::RoundUpToPowerOfTwo(FMath::Max(1, FMath::CeilToInt(Size))));
+	return FMath::Clamp(PowerOfTwo, MinSize, MaxSize);
+}
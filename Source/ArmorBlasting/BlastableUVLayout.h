@@ -0,0 +1,94 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UPrimitiveComponent;
+class UBodySetup;
+
+/**
+ * Surface and texture space description of a single blastable mesh piece.
+ * Used to convert world space impact radii into UV space and to know which part of the
+ * shared armor UV layout belongs to each piece.
+ */
+struct ARMORBLASTING_API FBlastablePieceLayout
+{
+	/** Surface of the piece in cm^2, taking the component scale into account */
+	float SurfaceArea = 0.f;
+
+	/** Area covered by the piece in UV space, where the whole layout has area 1 */
+	float UVArea = 0.f;
+
+	/** How many UV units a centimeter on the surface takes on average */
+	float UVPerCm = 0.f;
+
+	/** Bounds of the piece in UV space */
+	FBox2D UVBounds = FBox2D(ForceInit);
+
+	/** Cells of a `MaskResolution`^2 grid over the UV layout covered by this piece */
+	TBitArray<> Mask;
+
+	/** Width and height of `Mask` */
+	int32 MaskResolution = 0;
+
+	/** Amount of set bits in `Mask` */
+	int32 MaskCellCount = 0;
+
+	/** Whether the layout was built from valid mesh data */
+	bool IsValid() const { return MaskCellCount > 0 && UVPerCm > 0.f; }
+
+	/// <summary>
+	/// Build the layout of a piece from the UV data stored in its collision body.
+	/// Requires 'Support UV From Hit Results' in the physics settings.
+	/// </summary>
+	/// <param name="Component"> Blastable piece </param>
+	/// <param name="InMaskResolution"> Resolution of the coverage mask </param>
+	/// <param name="OutLayout"> Resulting layout </param>
+	/// <returns> True if the piece had UV data to build the layout from </returns>
+	static bool Build(const UPrimitiveComponent* Component, int32 InMaskResolution, FBlastablePieceLayout& OutLayout);
+
+	/// <summary>
+	/// Same as `Build`, but from raw triangles. Positions are expected in world scale.
+	/// </summary>
+	static bool Build(const TArray<int32>& Indices, const TArray<FVector>& Positions, const TArray<FVector2D>& UVs, int32 InMaskResolution, FBlastablePieceLayout& OutLayout);
+
+	/// <summary>
+	/// Bring a layout measured at one scale to another. UV data doesn't change, only the surface
+	/// and the UV density. Non uniform ratios scale the surface by their geometric mean.
+	/// </summary>
+	/// <param name="Ratio"> New scale divided by the scale the layout was measured at </param>
+	void Rescale(const FVector& Ratio);
+};
+
+/**
+ * How well a whole armor set uses the shared UV layout
+ */
+struct ARMORBLASTING_API FBlastableArmorLayoutStats
+{
+	/** Surface of every piece together in cm^2 */
+	float SurfaceArea = 0.f;
+
+	/** Fraction of the UV layout covered by at least one piece */
+	float Coverage = 0.f;
+
+	/** Fraction of the covered UV layout claimed by more than one piece */
+	float OverlapBetweenPieces = 0.f;
+
+	/** Highest fraction of a piece's own UVs folded over itself, like mirrored UVs */
+	float MaxSelfOverlap = 0.f;
+
+	/// <summary>
+	/// Gather stats from the layouts of every piece of an armor set. All layouts should use the same mask resolution.
+	/// </summary>
+	static FBlastableArmorLayoutStats Compute(const TArray<FBlastablePieceLayout>& Layouts);
+
+	/// <summary>
+	/// Smallest power of two damage render target size that keeps the given texel density on the
+	/// armor surface, taking into account how much of the layout the pieces actually use
+	/// </summary>
+	/// <param name="TexelsPerCm"> Desired damage texels per centimeter of armor surface </param>
+	/// <param name="MinSize"> Smallest size to recommend </param>
+	/// <param name="MaxSize"> Biggest size to recommend </param>
+	int32 RecommendRenderTargetSize(float TexelsPerCm, int32 MinSize = 64, int32 MaxSize = 2048) const;
+};
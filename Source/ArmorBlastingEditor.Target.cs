@@ -9,6 +9,6 @@ public class ArmorBlastingEditorTarget : TargetRules
 	{
 		Type = TargetType.Editor;
 		DefaultBuildSettings = BuildSettingsVersion.V2;
-		ExtraModuleNames.Add("ArmorBlasting");
+		ExtraModuleNames.AddRange(new string[] { "ArmorBlasting", "ArmorBlastingShaders" });
 	}
 }
@@ -0,0 +1,11 @@
+using UnrealBuildTool;
+
+public class ArmorBlastingShaders : ModuleRules
+{
+	public ArmorBlastingShaders(ReadOnlyTargetRules Target) : base(Target)
+	{
+		PCHUsage = PCHUsageMode.UseExplicitOrSharedPCHs;
+
+		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "RenderCore", "RHI" });
+	}
+}
@@ -0,0 +1,14 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ArmorBlastingShaders.h"
+#include "Misc/Paths.h"
+#include "Modules/ModuleManager.h"
+#include "ShaderCore.h"
+
+void FArmorBlastingShadersModule::StartupModule()
+{
+	// Shaders are referenced as /ArmorBlasting/<File>.usf
+	AddShaderSourceDirectoryMapping(TEXT("/ArmorBlasting"), FPaths::Combine(FPaths::ProjectDir(), TEXT("Shaders")));
+}
+
+IMPLEMENT_MODULE(FArmorBlastingShadersModule, ArmorBlastingShaders);
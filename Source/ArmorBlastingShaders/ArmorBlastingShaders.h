@@ -0,0 +1,16 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Modules/ModuleInterface.h"
+
+/**
+ * Global shaders used to draw damage. They live in their own module because global shaders must be
+ * registered before the engine compiles its global shader map, long before game modules load.
+ */
+class FArmorBlastingShadersModule : public IModuleInterface
+{
+public:
+	virtual void StartupModule() override;
+};
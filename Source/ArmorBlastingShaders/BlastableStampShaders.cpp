@@ -0,0 +1,9 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BlastableStampShaders.h"
+
+IMPLEMENT_GLOBAL_SHADER(FBlastableStampVS, "/ArmorBlasting/BlastableStamp.usf", "StampVS", SF_Vertex);
+IMPLEMENT_GLOBAL_SHADER(FBlastableStampPS, "/ArmorBlasting/BlastableStamp.usf", "StampPS", SF_Pixel);
+IMPLEMENT_GLOBAL_SHADER(FBlastableFadeVS, "/ArmorBlasting/BlastableStamp.usf", "FadeVS", SF_Vertex);
+IMPLEMENT_GLOBAL_SHADER(FBlastableFadePS, "/ArmorBlasting/BlastableStamp.usf", "FadePS", SF_Pixel);
+IMPLEMENT_GLOBAL_SHADER(FBlastableDownsamplePS, "/ArmorBlasting/BlastableStamp.usf", "DownsamplePS", SF_Pixel);
@@ -0,0 +1,103 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GlobalShader.h"
+#include "ShaderParameterStruct.h"
+#include "RenderGraphResources.h"
+
+/**
+ * Draws stamps against the position map of a blastable, one instance per stamp.
+ *
+ * Every stamp takes three float4 in the stamp buffer: the UV rectangle it covers (min, size), its
+ * center and radius in the space of its piece, and the piece index plus one in x with the intensity
+ * of the stamp in y. Vertices are
+ * generated from SV_VertexID as a four vertex triangle strip, so no vertex buffer is bound.
+ */
+class ARMORBLASTINGSHADERS_API FBlastableStampVS : public FGlobalShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FBlastableStampVS);
+	SHADER_USE_PARAMETER_STRUCT(FBlastableStampVS, FGlobalShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_SRV(StructuredBuffer<float4>, Stamps)
+		SHADER_PARAMETER(uint32, FirstStamp)
+	END_SHADER_PARAMETER_STRUCT()
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+};
+
+/** Adds the coverage of a stamp to every texel of its piece inside its radius */
+class ARMORBLASTINGSHADERS_API FBlastableStampPS : public FGlobalShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FBlastableStampPS);
+	SHADER_USE_PARAMETER_STRUCT(FBlastableStampPS, FGlobalShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_TEXTURE(Texture2D, PositionMap)
+		SHADER_PARAMETER_SAMPLER(SamplerState, PositionMapSampler)
+	END_SHADER_PARAMETER_STRUCT()
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+};
+
+/** Covers the whole viewport with a single triangle strip */
+class ARMORBLASTINGSHADERS_API FBlastableFadeVS : public FGlobalShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FBlastableFadeVS);
+	SHADER_USE_PARAMETER_STRUCT(FBlastableFadeVS, FGlobalShader);
+
+	using FParameters = FEmptyShaderParameters;
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+};
+
+/** Outputs the amount to fade, meant to be drawn with a reverse subtract blend */
+class ARMORBLASTINGSHADERS_API FBlastableFadePS : public FGlobalShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FBlastableFadePS);
+	SHADER_USE_PARAMETER_STRUCT(FBlastableFadePS, FGlobalShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER(float, FadeAmount)
+	END_SHADER_PARAMETER_STRUCT()
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+};
+
+/** Averages four texels of a mip into one of the next, drawn over a viewport restricted to what changed */
+class ARMORBLASTINGSHADERS_API FBlastableDownsamplePS : public FGlobalShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FBlastableDownsamplePS);
+	SHADER_USE_PARAMETER_STRUCT(FBlastableDownsamplePS, FGlobalShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_RDG_TEXTURE_SRV(Texture2D, SourceMip)
+		SHADER_PARAMETER_SAMPLER(SamplerState, SourceMipSampler)
+		SHADER_PARAMETER(FVector2D, InvDestSize)
+		RENDER_TARGET_BINDING_SLOTS()
+	END_SHADER_PARAMETER_STRUCT()
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+};